@@ -0,0 +1,411 @@
+#pragma once
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "Metrics.h"
+#include "Net.h"
+
+// -------------------------
+// Scheduler configuration
+// -------------------------
+struct PriorityClass {
+    std::string name;
+    std::vector<std::string> routes;   // path prefixes, e.g. "/api/chat"
+    std::vector<std::string> clients;  // client IP addresses
+    std::string header;                // optional header that must equal headerValue
+    std::string headerValue;
+};
+
+struct SchedulerConfig {
+    bool enabled = false;
+    int concurrency = 2;                              // per model, unless overridden
+    std::map<std::string, int> modelConcurrency;
+    std::string priorityHeader = "X-Priority";        // names a class directly
+    double agingSeconds = 30.0;                       // waiting this long halves a job's effective size
+    double quantumTokens = 1024.0;                    // fair-share credit per user per round
+    double maxCostTokens = 131072.0;                  // cap on a request's estimated (and settled) cost
+    std::map<std::string, double> userWeights;        // relative shares; unlisted users weigh 1
+    std::vector<PriorityClass> classes = {            // highest priority first
+        { "interactive", { "/api/chat", "/api/generate", "/v1/chat/completions", "/v1/completions" }, {}, "", "" },
+        { "background", {}, {}, "", "" }
+    };
+};
+
+// The name Ollama resolves a model name to: trimmed, lower case, and with
+// ":latest" when it has no tag (a colon before the last '/' is a registry
+// port), so "Llama3.2", "llama3.2 " and "llama3.2:latest" are one model.
+inline std::string CanonicalModelName(std::string_view name) {
+    const auto space = [](char c) { return c == ' ' || c == '\t' || c == '\r' || c == '\n'; };
+    while (!name.empty() && space(name.front()))
+        name.remove_prefix(1);
+    while (!name.empty() && space(name.back()))
+        name.remove_suffix(1);
+    std::string canonical(name);
+    for (char& c : canonical)
+        c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    const size_t slash = canonical.rfind('/');
+    const size_t colon = canonical.rfind(':');
+    if (!canonical.empty() && (colon == std::string::npos || (slash != std::string::npos && colon < slash)))
+        canonical += ":latest";
+    return canonical;
+}
+
+// Describes one request to the scheduler. `model` is a CanonicalModelName;
+// `cost` is the estimated number of tokens (prompt + completion) the request
+// will consume.
+struct AdmissionTicket {
+    std::string model;
+    std::string user;
+    size_t classIndex = 0;
+    double cost = 0.0;
+};
+
+// -------------------------
+// Admission Scheduler
+// -------------------------
+// Limits how many requests per model run against Ollama at once. Waiting
+// requests are admitted strictly by priority class. Within a class, users
+// share the model by deficit round robin over tokens, so a user with a deep
+// backlog cannot crowd out the others; each user's own requests go shortest
+// job first by estimated cost. Aging lets a large job overtake smaller ones
+// eventually so it cannot starve.
+class AdmissionScheduler {
+public:
+    explicit AdmissionScheduler(SchedulerConfig config) : config_(std::move(config)) {
+        if (config_.classes.empty())
+            config_.classes.push_back({ "default", {}, {}, "", "" });
+        std::map<std::string, int> modelConcurrency;
+        for (const auto& [model, limit] : config_.modelConcurrency)
+            modelConcurrency[CanonicalModelName(model)] = limit;
+        config_.modelConcurrency = std::move(modelConcurrency);
+        MetricsRegistry& metrics = MetricsRegistry::Instance();
+        for (const auto& priorityClass : config_.classes) {
+            const std::string labels = "class=\"" + LabelValue(priorityClass.name) + "\"";
+            waitSeconds_.push_back(&metrics.GetCounter("owui_proxy_queue_wait_seconds_total",
+                "Total time admitted requests spent waiting in the queue.", labels));
+            wait_.push_back(&metrics.GetHistogram("owui_proxy_queue_wait_seconds",
+                "Time admitted requests spent waiting in the queue; 0 for those admitted at once.", labels));
+            admitted_.push_back(&metrics.GetCounter("owui_proxy_queue_admitted_total",
+                "Requests admitted by the scheduler.", labels));
+            abandoned_.push_back(&metrics.GetCounter("owui_proxy_queue_abandoned_total",
+                "Requests whose client went away while queued.", labels));
+        }
+    }
+
+    // Picks the priority class: an explicit priority header wins, then a
+    // class's own header rule, then client address, then route; anything
+    // unmatched falls into the lowest class.
+    size_t Classify(std::string_view path, const HttpHeaders& headers, std::string_view client) const {
+        const std::string_view* named = FindHeader(headers, config_.priorityHeader);
+        for (size_t i = 0; named && i < config_.classes.size(); ++i) {
+            if (EqualsIgnoreCase(*named, config_.classes[i].name))
+                return i;
+        }
+        for (size_t i = 0; i < config_.classes.size(); ++i) {
+            const PriorityClass& candidate = config_.classes[i];
+            if (candidate.header.empty())
+                continue;
+            const std::string_view* value = FindHeader(headers, candidate.header);
+            if (value && (candidate.headerValue.empty() || *value == candidate.headerValue))
+                return i;
+        }
+        for (size_t i = 0; i < config_.classes.size(); ++i) {
+            for (const auto& address : config_.classes[i].clients) {
+                if (address == client)
+                    return i;
+            }
+        }
+        for (size_t i = 0; i < config_.classes.size(); ++i) {
+            for (const auto& route : config_.classes[i].routes) {
+                if (path.compare(0, route.size(), route) == 0)
+                    return i;
+            }
+        }
+        return config_.classes.size() - 1;
+    }
+
+    const std::string& ClassName(size_t classIndex) const { return config_.classes[classIndex].name; }
+
+    // Blocks until the request may run. `abandoned` is polled while waiting;
+    // if it returns true the request leaves the queue and Acquire returns false.
+    template <typename AbandonCheck>
+    bool Acquire(const AdmissionTicket& ticket, AbandonCheck&& abandoned) {
+        const size_t classIndex = ticket.classIndex;
+        const auto enqueued = std::chrono::steady_clock::now();
+        std::unique_lock<std::mutex> lock(mutex_);
+        ModelQueue& queue = QueueFor(ticket.model);
+
+        if (queue.running < queue.limit && queue.waiting.empty()) {
+            ++queue.running;
+            admitted_[classIndex]->Add();
+            wait_[classIndex]->Record(0.0);
+            return true;
+        }
+
+        Waiter waiter{ classIndex, ticket.user, Clamp(ticket.cost), nextSequence_++, enqueued };
+        queue.waiting.push_back(&waiter);
+        queue.depth[classIndex]->Add(1);
+        FairQueue& fair = queue.fair[classIndex];
+        if (fair.users[ticket.user].waiting++ == 0)
+            fair.active.push_back(ticket.user);
+
+        while (!waiter.granted) {
+            waiter.wakeup.wait_for(lock, std::chrono::milliseconds(100));
+            if (waiter.granted)
+                break;
+            // The check may be a syscall; other requests need the lock meanwhile.
+            lock.unlock();
+            const bool gone = abandoned();
+            lock.lock();
+            if (gone && !waiter.granted) {
+                queue.waiting.erase(std::find(queue.waiting.begin(), queue.waiting.end(), &waiter));
+                queue.depth[classIndex]->Add(-1);
+                LeaveFairQueue(fair, ticket.user);
+                abandoned_[classIndex]->Add();
+                DropIfIdle(ticket.model);
+                return false;
+            }
+        }
+        const std::chrono::duration<double> waited = std::chrono::steady_clock::now() - enqueued;
+        waitSeconds_[classIndex]->Add(waited.count());
+        wait_[classIndex]->Record(waited.count());
+        admitted_[classIndex]->Add();
+        return true;
+    }
+
+    // `consumedTokens` is what the request actually used. If the user is
+    // still backlogged, the difference from the estimate is settled against
+    // their deficit so that shares track real tokens, not guesses.
+    void Release(const AdmissionTicket& ticket, double consumedTokens) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ModelQueue& queue = QueueFor(ticket.model);
+        --queue.running;
+        FairQueue& fair = queue.fair[ticket.classIndex];
+        const auto share = fair.users.find(ticket.user);
+        if (share != fair.users.end())
+            share->second.deficit += Clamp(ticket.cost) - Clamp(consumedTokens);
+        Dispatch(queue);
+        DropIfIdle(ticket.model);
+    }
+
+    // Takes one more slot on `model` for a hedged duplicate of a request that
+    // already holds one. Only a free slot with nobody waiting is taken, so a
+    // duplicate never delays queued work. Give it back with ReleaseExtra.
+    bool TryAcquireExtra(const std::string& model) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ModelQueue& queue = QueueFor(model);
+        if (queue.running >= queue.limit || !queue.waiting.empty())
+            return false;
+        ++queue.running;
+        return true;
+    }
+
+    void ReleaseExtra(const std::string& model) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ModelQueue& queue = QueueFor(model);
+        --queue.running;
+        Dispatch(queue);
+        DropIfIdle(model);
+    }
+
+private:
+    // As many models as the proxy's per-model stats get depth gauges of their
+    // own; the rest share model="other".
+    static constexpr size_t kMaxModelSeries = 32;
+
+    struct Waiter {
+        size_t classIndex;
+        std::string user;
+        double cost;
+        uint64_t sequence;
+        std::chrono::steady_clock::time_point enqueued;
+        bool granted = false;
+        std::condition_variable wakeup;
+    };
+
+    struct UserShare {
+        double deficit = 0.0; // tokens the user may still be admitted for this round
+        bool inTurn = false;  // quantum already granted for the current visit
+        int waiting = 0;
+    };
+
+    // Deficit round robin state for one priority class; `active` holds the
+    // users with waiting requests in visiting order.
+    struct FairQueue {
+        std::deque<std::string> active;
+        std::map<std::string, UserShare> users;
+    };
+
+    struct ModelQueue {
+        int running = 0;
+        int limit = 1;
+        std::vector<Waiter*> waiting;
+        std::vector<FairQueue> fair; // per class
+        std::vector<Gauge*> depth;   // per class
+    };
+
+    // Queues live while the model has requests running or waiting; an idle
+    // queue holds no state (users leave the fair queue with their last
+    // request), so it is dropped rather than kept for every name ever seen.
+    ModelQueue& QueueFor(const std::string& model) {
+        std::unique_ptr<ModelQueue>& queue = queues_[model];
+        if (!queue) {
+            queue = std::make_unique<ModelQueue>();
+            const auto limit = config_.modelConcurrency.find(model);
+            queue->limit = (std::max)(1, limit != config_.modelConcurrency.end() ? limit->second : config_.concurrency);
+            queue->fair.resize(config_.classes.size());
+            const bool labelled = labelledModels_.count(model) > 0 || labelledModels_.size() < kMaxModelSeries;
+            if (labelled)
+                labelledModels_.insert(model);
+            MetricsRegistry& metrics = MetricsRegistry::Instance();
+            for (const auto& priorityClass : config_.classes) {
+                queue->depth.push_back(&metrics.GetGauge("owui_proxy_queue_depth",
+                    "Requests waiting for admission.",
+                    "model=\"" + LabelValue(labelled ? model : "other") + "\",class=\"" +
+                    LabelValue(priorityClass.name) + "\""));
+            }
+        }
+        return *queue;
+    }
+
+    void DropIfIdle(const std::string& model) {
+        const auto found = queues_.find(model);
+        if (found != queues_.end() && found->second->running == 0 && found->second->waiting.empty())
+            queues_.erase(found);
+    }
+
+    // Admits waiters while the model has free slots: the best waiting class
+    // first, then the user whose turn it is, then that user's smallest aged
+    // cost, then arrival order.
+    void Dispatch(ModelQueue& queue) {
+        const auto now = std::chrono::steady_clock::now();
+        while (queue.running < queue.limit && !queue.waiting.empty()) {
+            size_t classIndex = queue.waiting.front()->classIndex;
+            for (const Waiter* waiter : queue.waiting)
+                classIndex = (std::min)(classIndex, waiter->classIndex);
+
+            // Each active user's next request within the class.
+            std::map<std::string_view, std::vector<Waiter*>::iterator> heads;
+            for (auto it = queue.waiting.begin(); it != queue.waiting.end(); ++it) {
+                if ((*it)->classIndex != classIndex)
+                    continue;
+                auto head = heads.try_emplace((*it)->user, it).first;
+                if (Before(**it, **head->second, now))
+                    head->second = it;
+            }
+
+            FairQueue& fair = queue.fair[classIndex];
+            const auto chosenAt = NextFairTurn(fair, heads);
+            Waiter* chosen = *chosenAt;
+            queue.waiting.erase(chosenAt);
+            queue.depth[classIndex]->Add(-1);
+            LeaveFairQueue(fair, chosen->user);
+            ++queue.running;
+            chosen->granted = true;
+            chosen->wakeup.notify_one();
+        }
+    }
+
+    // Deficit round robin: the user at the front of the ring is granted its
+    // quantum (scaled by weight) once per visit and keeps the turn while its
+    // deficit covers its next request; otherwise the turn passes on.
+    //
+    // The visits are not stepped through one at a time (a costly request
+    // from a low-weight user would take that many trips round the ring,
+    // under the lock). Visit t, counted from the front's current one, goes
+    // to the user at position t % n. For every user the visit at which its
+    // deficit first covers its next request follows directly; the earliest
+    // wins, and each user is credited the quanta of the visits before it.
+    std::vector<Waiter*>::iterator NextFairTurn(FairQueue& fair,
+        const std::map<std::string_view, std::vector<Waiter*>::iterator>& heads)
+    {
+        const uint64_t users = fair.active.size();
+        uint64_t winningVisit = UINT64_MAX;
+        size_t winner = 0;
+        for (size_t i = 0; i < users; ++i) {
+            const std::string& user = fair.active[i];
+            const UserShare& share = fair.users.at(user);
+            const double missing = (*heads.at(user))->cost - share.deficit;
+            // Quanta still needed; bounded, since costs are clamped and weights are at least 0.01.
+            const double grants = (std::min)(1e12, std::ceil(missing / Quantum(user)));
+            uint64_t visit;
+            if (i == 0 && share.inTurn) // this visit's quantum is already in
+                visit = grants <= 0.0 ? 0 : static_cast<uint64_t>(grants) * users;
+            else
+                visit = i + (static_cast<uint64_t>((std::max)(1.0, grants)) - 1) * users;
+            if (visit < winningVisit) {
+                winningVisit = visit;
+                winner = i;
+            }
+        }
+        for (size_t i = 0; i < users; ++i) {
+            UserShare& share = fair.users.at(fair.active[i]);
+            // Visits before the winning one; the winner's own visit included.
+            const uint64_t until = winningVisit + (i == winner ? 1 : 0);
+            uint64_t visits = until > i ? (until - i + users - 1) / users : 0;
+            if (i == 0 && share.inTurn && visits > 0)
+                --visits;
+            share.deficit += static_cast<double>(visits) * Quantum(fair.active[i]);
+            if (until > i)
+                share.inTurn = false;
+        }
+        std::rotate(fair.active.begin(), fair.active.begin() + static_cast<ptrdiff_t>(winner), fair.active.end());
+        UserShare& share = fair.users.at(fair.active.front());
+        const auto head = heads.at(fair.active.front());
+        share.inTurn = true;
+        share.deficit -= (*head)->cost;
+        return head;
+    }
+
+    double Quantum(const std::string& user) const { return config_.quantumTokens * Weight(user); }
+
+    double Clamp(double cost) const { return (std::min)(cost, config_.maxCostTokens); }
+
+    // A user without waiting requests drops out of the ring and, as in
+    // classic DRR, forfeits any unused deficit.
+    static void LeaveFairQueue(FairQueue& fair, const std::string& user) {
+        const auto share = fair.users.find(user);
+        if (share == fair.users.end() || --share->second.waiting > 0)
+            return;
+        fair.users.erase(share);
+        fair.active.erase(std::find(fair.active.begin(), fair.active.end(), user));
+    }
+
+    double Weight(const std::string& user) const {
+        const auto weight = config_.userWeights.find(user);
+        return weight != config_.userWeights.end() ? (std::max)(weight->second, 0.01) : 1.0;
+    }
+
+    bool Before(const Waiter& a, const Waiter& b, std::chrono::steady_clock::time_point now) const {
+        const double costA = AgedCost(a, now);
+        const double costB = AgedCost(b, now);
+        return costA < costB || (costA == costB && a.sequence < b.sequence);
+    }
+
+    double AgedCost(const Waiter& waiter, std::chrono::steady_clock::time_point now) const {
+        const std::chrono::duration<double> waited = now - waiter.enqueued;
+        return waiter.cost / (1.0 + waited.count() / config_.agingSeconds);
+    }
+
+    SchedulerConfig config_;
+    std::mutex mutex_;
+    std::map<std::string, std::unique_ptr<ModelQueue>> queues_;
+    std::set<std::string> labelledModels_; // models with depth gauges of their own
+    uint64_t nextSequence_ = 0;
+    std::vector<Counter*> waitSeconds_;
+    std::vector<Histogram*> wait_;
+    std::vector<Counter*> admitted_;
+    std::vector<Counter*> abandoned_;
+};
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "BufferPool.h"
+
+// -------------------------
+// Arena
+// -------------------------
+// Bump allocator for the transient state of one request: parsed headers,
+// the request body and the heads built for the upstream and the client.
+// Allocation is a pointer increment; nothing is freed individually, and
+// Reset() drops everything at once when the request is done. The first block
+// is a pooled I/O buffer kept across resets, so a connection serving small
+// requests allocates nothing after the first; overflow blocks (and blocks
+// sized for one large body) are returned on reset.
+class Arena {
+public:
+    Arena() = default;
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+    ~Arena() { Reset(); ReleaseFirst(); }
+
+    void* Allocate(size_t size, size_t alignment = alignof(std::max_align_t)) {
+        size_t offset = (offset_ + alignment - 1) & ~(alignment - 1);
+        if (blocks_.empty() || offset + size > blocks_.back().size) {
+            AddBlock(size + alignment);
+            offset = (offset_ + alignment - 1) & ~(alignment - 1);
+        }
+        void* result = blocks_.back().data + offset;
+        offset_ = offset + size;
+        used_ += size;
+        return result;
+    }
+
+    // Copies `text` into the arena; the view stays valid until Reset().
+    std::string_view Copy(std::string_view text) {
+        if (text.empty())
+            return {};
+        char* copy = static_cast<char*>(Allocate(text.size(), 1));
+        std::memcpy(copy, text.data(), text.size());
+        return { copy, text.size() };
+    }
+
+    // Frees everything allocated since the last reset.
+    void Reset() {
+        while (blocks_.size() > 1) {
+            Release(blocks_.back());
+            blocks_.pop_back();
+        }
+        if (!blocks_.empty() && !blocks_.front().pooled)
+            ReleaseFirst();
+        offset_ = 0;
+        used_ = 0;
+    }
+
+    size_t BytesUsed() const { return used_; }
+
+private:
+    struct Block {
+        char* data;
+        size_t size;
+        bool pooled;
+    };
+
+    void AddBlock(size_t minimum) {
+        Block block;
+        if (minimum <= BufferPool::kBufferSize) {
+            block = { BufferPool::Instance().Acquire().release(), BufferPool::kBufferSize, true };
+        }
+        else {
+            block = { new char[minimum], minimum, false };
+        }
+        blocks_.push_back(block);
+        offset_ = 0;
+    }
+
+    static void Release(const Block& block) {
+        if (block.pooled)
+            BufferPool::Instance().Release(std::unique_ptr<char[]>(block.data));
+        else
+            delete[] block.data;
+    }
+
+    void ReleaseFirst() {
+        if (!blocks_.empty())
+            Release(blocks_.front());
+        blocks_.clear();
+    }
+
+    std::vector<Block> blocks_;
+    size_t offset_ = 0;
+    size_t used_ = 0;
+};
+
+// Standard allocator over an Arena, for containers that live no longer than
+// the request. Deallocation is a no-op.
+template <typename T>
+class ArenaAllocator {
+public:
+    using value_type = T;
+
+    explicit ArenaAllocator(Arena& arena) : arena_(&arena) {}
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) : arena_(other.arena_) {}
+
+    T* allocate(size_t count) { return static_cast<T*>(arena_->Allocate(count * sizeof(T), alignof(T))); }
+    void deallocate(T*, size_t) {}
+
+    template <typename U>
+    bool operator==(const ArenaAllocator<U>& other) const { return arena_ == other.arena_; }
+    template <typename U>
+    bool operator!=(const ArenaAllocator<U>& other) const { return arena_ != other.arena_; }
+
+private:
+    template <typename U>
+    friend class ArenaAllocator;
+    Arena* arena_;
+};
+
+using ArenaString = std::basic_string<char, std::char_traits<char>, ArenaAllocator<char>>;
+
+template <typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
@@ -0,0 +1,244 @@
+#pragma once
+
+#include <winsock2.h>
+#include <windows.h>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "Gzip.h"
+#include "Metrics.h"
+#include "Net.h"
+
+// -------------------------
+// Asset cache configuration
+// -------------------------
+struct AssetCacheConfig {
+    bool enabled = true;
+    size_t maxBytes = 64 * 1024 * 1024;     // all variants of all assets
+    size_t maxAssetBytes = 8 * 1024 * 1024; // larger responses are not cached
+    // Paths whose names carry a content hash, so a cached copy never goes stale.
+    std::vector<std::string> prefixes = { "/_app/immutable/" };
+};
+
+// One asset in every encoding the cache holds. Variants that would be no
+// smaller than the identity body are left empty.
+struct CachedAsset {
+    std::string contentType;
+    std::string etag; // quoted; variants append -gz / -br inside the quotes
+    std::string identity;
+    std::string gzip;
+    std::string brotli;
+
+    size_t Bytes() const { return contentType.size() + etag.size() + identity.size() + gzip.size() + brotli.size(); }
+};
+
+// -------------------------
+// Asset cache
+// -------------------------
+// Size-bounded LRU of Open WebUI's hashed static assets (the SvelteKit JS,
+// CSS and font bundles), each held as identity, gzip and, when the container
+// offers it, brotli. Hits are answered from memory with a strong ETag and a
+// year-long immutable Cache-Control; a matching If-None-Match gets a 304.
+class AssetCache {
+public:
+    explicit AssetCache(AssetCacheConfig config) : config_(std::move(config)) {
+        MetricsRegistry& metrics = MetricsRegistry::Instance();
+        const char* requestsHelp = "Static asset requests by cache outcome.";
+        hits_ = &metrics.GetCounter("owui_proxy_asset_cache_requests_total", requestsHelp, "result=\"hit\"");
+        misses_ = &metrics.GetCounter("owui_proxy_asset_cache_requests_total", requestsHelp, "result=\"miss\"");
+        notModified_ = &metrics.GetCounter("owui_proxy_asset_cache_not_modified_total",
+            "Asset requests answered with 304 Not Modified.");
+        bytesGauge_ = &metrics.GetGauge("owui_proxy_asset_cache_bytes", "Bytes held by the static asset cache.");
+        entriesGauge_ = &metrics.GetGauge("owui_proxy_asset_cache_entries", "Assets held by the static asset cache.");
+    }
+
+    AssetCache(const AssetCache&) = delete;
+    AssetCache& operator=(const AssetCache&) = delete;
+
+    size_t MaxAssetBytes() const { return config_.maxAssetBytes; }
+
+    // Whether the request is for a cacheable path. Range requests go to the
+    // container.
+    bool Eligible(const HttpRequest& request) const {
+        if ((request.method != "GET" && request.method != "HEAD") || FindHeader(request.headers, "Range"))
+            return false;
+        for (const auto& prefix : config_.prefixes) {
+            if (request.target.compare(0, prefix.size(), prefix) == 0)
+                return true;
+        }
+        return false;
+    }
+
+    // Whether a container response for an eligible request may be stored.
+    // The request is sent with Accept-Encoding: identity, so anything encoded
+    // or personalised is left alone.
+    static bool Cacheable(const HttpResponseHead& response) {
+        if (response.status != 200 || FindHeader(response.headers, "Set-Cookie") ||
+            FindHeader(response.headers, "Content-Encoding"))
+            return false;
+        const std::string_view* cacheControl = FindHeader(response.headers, "Cache-Control");
+        if (cacheControl && (ContainsTokenIgnoreCase(*cacheControl, "no-store") ||
+            ContainsTokenIgnoreCase(*cacheControl, "private")))
+            return false;
+        const std::string_view* vary = FindHeader(response.headers, "Vary");
+        return !vary || vary->empty() || EqualsIgnoreCase(*vary, "Accept-Encoding");
+    }
+
+    std::shared_ptr<const CachedAsset> Find(std::string_view target) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        const auto found = index_.find(std::string(target));
+        if (found == index_.end()) {
+            misses_->Add();
+            return nullptr;
+        }
+        hits_->Add();
+        entries_.splice(entries_.begin(), entries_, found->second);
+        return found->second->second;
+    }
+
+    void Insert(std::string target, std::shared_ptr<const CachedAsset> asset) {
+        const size_t bytes = asset->Bytes() + target.size();
+        if (bytes > config_.maxBytes)
+            return;
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (const auto existing = index_.find(target); existing != index_.end()) {
+            bytes_ -= existing->second->second->Bytes() + existing->first.size();
+            entries_.erase(existing->second);
+            index_.erase(existing);
+        }
+        while (!entries_.empty() && bytes_ + bytes > config_.maxBytes) {
+            bytes_ -= entries_.back().second->Bytes() + entries_.back().first.size();
+            index_.erase(entries_.back().first);
+            entries_.pop_back();
+        }
+        entries_.emplace_front(target, std::move(asset));
+        index_.emplace(std::move(target), entries_.begin());
+        bytes_ += bytes;
+        bytesGauge_->Set(static_cast<double>(bytes_));
+        entriesGauge_->Set(static_cast<double>(entries_.size()));
+    }
+
+    // Builds the cache entry for an identity body: the ETag and a gzip
+    // variant are computed here; `brotli` is the container's own br encoding
+    // of the same body, if it gave one.
+    static std::shared_ptr<CachedAsset> MakeAsset(std::string_view contentType, std::string identity, std::string brotli) {
+        auto asset = std::make_shared<CachedAsset>();
+        asset->contentType = std::string(contentType);
+        char etag[32];
+        snprintf(etag, sizeof(etag), "\"%08x%08zx\"", Gzip::Crc32(identity), identity.size());
+        asset->etag = etag;
+        std::string gzip = Gzip::Compress(identity);
+        if (gzip.size() < identity.size())
+            asset->gzip = std::move(gzip);
+        if (brotli.size() < identity.size())
+            asset->brotli = std::move(brotli);
+        asset->identity = std::move(identity);
+        return asset;
+    }
+
+    // Answers `request` from `asset`, picking the smallest encoding the client
+    // accepts. Returns false if the client could not be written to.
+    bool Serve(Socket& client, const HttpRequest& request, const CachedAsset& asset, bool keepAlive) {
+        const std::string_view* acceptEncoding = FindHeader(request.headers, "Accept-Encoding");
+        const std::string* body = &asset.identity;
+        std::string_view encoding;
+        std::string_view suffix;
+        if (acceptEncoding && !asset.brotli.empty() && AcceptsEncoding(*acceptEncoding, "br")) {
+            body = &asset.brotli;
+            encoding = "br";
+            suffix = "-br";
+        }
+        else if (acceptEncoding && !asset.gzip.empty() && AcceptsEncoding(*acceptEncoding, "gzip")) {
+            body = &asset.gzip;
+            encoding = "gzip";
+            suffix = "-gz";
+        }
+        const std::string_view baseTag = std::string_view(asset.etag).substr(0, asset.etag.size() - 1);
+
+        const std::string_view* ifNoneMatch = FindHeader(request.headers, "If-None-Match");
+        const bool notModified = ifNoneMatch && MatchesETag(*ifNoneMatch, baseTag);
+        if (notModified)
+            notModified_->Add();
+
+        std::string head;
+        head.reserve(512);
+        if (notModified) {
+            head.append("HTTP/1.1 304 Not Modified\r\n");
+        }
+        else {
+            head.append("HTTP/1.1 200 OK\r\n");
+            AppendHeader(head, "Content-Type", asset.contentType);
+            AppendHeader(head, "Content-Length", std::to_string(body->size()));
+            if (!encoding.empty())
+                AppendHeader(head, "Content-Encoding", encoding);
+        }
+        head.append("ETag: ").append(baseTag).append(suffix).append("\"\r\n");
+        head.append("Cache-Control: public, max-age=31536000, immutable\r\nVary: Accept-Encoding\r\n");
+        head.append(keepAlive ? "Connection: keep-alive\r\n\r\n" : "Connection: close\r\n\r\n");
+
+        WSABUF pieces[2] = {
+            { static_cast<ULONG>(head.size()), head.data() },
+            { static_cast<ULONG>(body->size()), const_cast<char*>(body->data()) }
+        };
+        const bool withBody = !notModified && request.method != "HEAD" && !body->empty();
+        return client.SendAll(pieces, withBody ? 2 : 1);
+    }
+
+private:
+    // Accept-Encoding lists codings with optional weights; q=0 refuses one.
+    static bool AcceptsEncoding(std::string_view header, std::string_view coding) {
+        size_t start = 0;
+        while (start < header.size()) {
+            size_t end = header.find(',', start);
+            if (end == std::string_view::npos)
+                end = header.size();
+            std::string_view item = header.substr(start, end - start);
+            start = end + 1;
+            const size_t semicolon = item.find(';');
+            std::string_view name = item.substr(0, semicolon);
+            while (!name.empty() && name.front() == ' ') name.remove_prefix(1);
+            while (!name.empty() && name.back() == ' ') name.remove_suffix(1);
+            if (!EqualsIgnoreCase(name, coding))
+                continue;
+            const size_t q = semicolon == std::string_view::npos ? std::string_view::npos : item.find("q=", semicolon);
+            return q == std::string_view::npos || std::atof(std::string(item.substr(q + 2)).c_str()) > 0.0;
+        }
+        return false;
+    }
+
+    // Weak comparison against every variant of the asset, which all share the
+    // base tag: a client that switches encodings still revalidates.
+    static bool MatchesETag(std::string_view ifNoneMatch, std::string_view baseTag) {
+        if (ifNoneMatch.find('*') != std::string_view::npos)
+            return true;
+        size_t position = 0;
+        while ((position = ifNoneMatch.find(baseTag, position)) != std::string_view::npos) {
+            const size_t end = position + baseTag.size();
+            if (end < ifNoneMatch.size() && (ifNoneMatch[end] == '"' || ifNoneMatch[end] == '-'))
+                return true;
+            position = end;
+        }
+        return false;
+    }
+
+    using Entry = std::pair<std::string, std::shared_ptr<const CachedAsset>>;
+
+    AssetCacheConfig config_;
+    std::mutex mutex_;
+    std::list<Entry> entries_; // most recently used first
+    std::unordered_map<std::string, std::list<Entry>::iterator> index_;
+    size_t bytes_ = 0;
+    Counter* hits_ = nullptr;
+    Counter* misses_ = nullptr;
+    Counter* notModified_ = nullptr;
+    Gauge* bytesGauge_ = nullptr;
+    Gauge* entriesGauge_ = nullptr;
+};
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <winsock2.h>
+#include <windows.h>
+#include <psapi.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+// -------------------------
+// Benchmark harness
+// -------------------------
+// Shared by the `bench` subcommands. A case is warmed up, then repeated in
+// growing batches until its time budget is spent; results print as a table
+// of time per operation, throughput and speed relative to a baseline case.
+namespace Bench {
+
+// Keeps a computed value alive so the optimizer cannot drop the work.
+inline void DoNotOptimize(uint64_t value) {
+    static volatile uint64_t sink;
+    sink = value;
+}
+
+struct Result {
+    std::wstring name;
+    uint64_t operations = 0;
+    double seconds = 0.0;
+    uint64_t bytesPerOperation = 0;
+
+    double NanosecondsPerOperation() const {
+        return operations ? seconds * 1e9 / static_cast<double>(operations) : 0.0;
+    }
+    double MegabytesPerSecond() const {
+        return seconds > 0.0 ? static_cast<double>(bytesPerOperation * operations) / seconds / 1e6 : 0.0;
+    }
+};
+
+template <typename Operation>
+Result Measure(std::wstring name, uint64_t bytesPerOperation, Operation&& operation, double budgetSeconds = 0.5) {
+    for (int i = 0; i < 3; ++i)
+        operation();
+
+    Result result;
+    result.name = std::move(name);
+    result.bytesPerOperation = bytesPerOperation;
+    uint64_t batch = 1;
+    const auto start = std::chrono::steady_clock::now();
+    while (result.seconds < budgetSeconds) {
+        for (uint64_t i = 0; i < batch; ++i)
+            operation();
+        result.operations += batch;
+        result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        batch = (std::min)(batch * 2, uint64_t{ 1 } << 20);
+    }
+    return result;
+}
+
+// CPU time (user and kernel) the calling thread has used so far.
+inline double ThreadCpuSeconds() {
+    FILETIME creation, exit, kernel, user;
+    if (!GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user))
+        return 0.0;
+    const auto seconds = [](const FILETIME& time) {
+        return static_cast<double>((static_cast<uint64_t>(time.dwHighDateTime) << 32) | time.dwLowDateTime) / 1e7;
+    };
+    return seconds(kernel) + seconds(user);
+}
+
+// Heap allocations are counted (by the operator new in the main source file)
+// only while a benchmark has counting switched on.
+inline std::atomic<bool>& AllocationCountingEnabled() {
+    static std::atomic<bool> enabled{ false };
+    return enabled;
+}
+
+inline std::atomic<uint64_t>& AllocationCount() {
+    static std::atomic<uint64_t> count{ 0 };
+    return count;
+}
+
+inline void CountAllocation() {
+    if (AllocationCountingEnabled().load(std::memory_order_relaxed))
+        AllocationCount().fetch_add(1, std::memory_order_relaxed);
+}
+
+// Counts allocations made while the object is alive, on any thread.
+class AllocationScope {
+public:
+    AllocationScope() : start_(AllocationCount().load()) { AllocationCountingEnabled() = true; }
+    ~AllocationScope() { AllocationCountingEnabled() = false; }
+    uint64_t Allocations() const { return AllocationCount().load() - start_; }
+
+private:
+    uint64_t start_;
+};
+
+inline double PeakWorkingSetMegabytes() {
+    PROCESS_MEMORY_COUNTERS counters{};
+    counters.cb = sizeof(counters);
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return 0.0;
+    return static_cast<double>(counters.PeakWorkingSetSize) / (1024.0 * 1024.0);
+}
+
+inline void PrintTitle(const std::wstring& title) {
+    std::wcout << L"\n" << title << L"\n"
+        << std::left << std::setw(36) << L"case" << std::right << std::setw(14) << L"ns/op"
+        << std::setw(12) << L"MB/s" << std::setw(10) << L"speedup" << L"\n";
+}
+
+// `baseline` (if given) is the case the speedup column is relative to.
+inline void Print(const Result& result, const Result* baseline = nullptr) {
+    std::wcout << std::left << std::setw(36) << result.name << std::right << std::fixed
+        << std::setw(14) << std::setprecision(1) << result.NanosecondsPerOperation()
+        << std::setw(12) << std::setprecision(1) << result.MegabytesPerSecond();
+    if (baseline && result.NanosecondsPerOperation() > 0.0)
+        std::wcout << std::setw(9) << std::setprecision(2)
+            << baseline->NanosecondsPerOperation() / result.NanosecondsPerOperation() << L"x";
+    std::wcout << L"\n";
+}
+
+} // namespace Bench
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+// -------------------------
+// I/O buffer pool
+// -------------------------
+// Relays read into fixed-size buffers recycled through a process-wide pool,
+// so streaming a body allocates nothing per read and large buffers stay off
+// the thread stacks. Idle buffers beyond a small cap are freed.
+class BufferPool {
+public:
+    static constexpr size_t kBufferSize = 64 * 1024;
+
+    static BufferPool& Instance() {
+        static BufferPool pool;
+        return pool;
+    }
+
+    std::unique_ptr<char[]> Acquire() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!idle_.empty()) {
+                std::unique_ptr<char[]> buffer = std::move(idle_.back());
+                idle_.pop_back();
+                return buffer;
+            }
+        }
+        return std::make_unique<char[]>(kBufferSize);
+    }
+
+    void Release(std::unique_ptr<char[]> buffer) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (idle_.size() < kMaxIdle)
+            idle_.push_back(std::move(buffer));
+    }
+
+private:
+    static constexpr size_t kMaxIdle = 64;
+    std::mutex mutex_;
+    std::vector<std::unique_ptr<char[]>> idle_;
+};
+
+// A buffer borrowed from the pool for the lifetime of this object.
+class PooledBuffer {
+public:
+    PooledBuffer() : buffer_(BufferPool::Instance().Acquire()) {}
+    ~PooledBuffer() { BufferPool::Instance().Release(std::move(buffer_)); }
+
+    PooledBuffer(const PooledBuffer&) = delete;
+    PooledBuffer& operator=(const PooledBuffer&) = delete;
+
+    char* Data() { return buffer_.get(); }
+    static constexpr int Size() { return static_cast<int>(BufferPool::kBufferSize); }
+
+private:
+    std::unique_ptr<char[]> buffer_;
+};
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <winsock2.h>
+#include <windows.h>
+#include <string>
+#include "Logger.h"
+
+// -------------------------
+// Logging Helper
+// -------------------------
+// Hands the line to the asynchronous logger; see Logger.h. A macro so the
+// level is tested before `message` is evaluated: with a constant level below
+// OWUI_LOG_MIN_LEVEL the compiler drops the whole statement, string
+// building included.
+#define Log(level, message) \
+    do { \
+        if (static_cast<int>(level) >= OWUI_LOG_MIN_LEVEL) \
+            AsyncLogger::Instance().Write((level), (message)); \
+    } while (0)
+
+// -------------------------
+// Unicode conversion helpers
+// -------------------------
+inline std::wstring UTF8ToWString(const std::string& str) {
+    if (str.empty())
+        return std::wstring();
+    const int size_needed = MultiByteToWideChar(CP_UTF8, 0, str.data(),
+        static_cast<int>(str.size()), nullptr, 0);
+    std::wstring wstr(size_needed, 0);
+    MultiByteToWideChar(CP_UTF8, 0, str.data(),
+        static_cast<int>(str.size()), &wstr[0], size_needed);
+    return wstr;
+}
+
+inline std::string WStringToUTF8(const std::wstring& wstr) {
+    if (wstr.empty())
+        return std::string();
+    const int size_needed = WideCharToMultiByte(CP_UTF8, 0, wstr.data(),
+        static_cast<int>(wstr.size()), nullptr, 0, nullptr, nullptr);
+    std::string str(size_needed, 0);
+    WideCharToMultiByte(CP_UTF8, 0, wstr.data(),
+        static_cast<int>(wstr.size()), &str[0], size_needed, nullptr, nullptr);
+    return str;
+}
@@ -0,0 +1,234 @@
+#pragma once
+
+#include <winsock2.h>
+#include <windows.h>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <nlohmann/json.hpp>
+#include "Common.h"
+
+// -------------------------
+// Control channel configuration
+// -------------------------
+struct ControlConfig {
+    bool enabled = true;
+    std::wstring pipeName = L"\\\\.\\pipe\\open-webui-automation";
+};
+
+// -------------------------
+// Control server
+// -------------------------
+// A named pipe speaking newline-delimited JSON. Each request line is an
+// object with a "command" and its arguments; each gets one reply line, the
+// handler's object with "ok" set (true unless the handler set it), or
+// {"ok": false, "error": "..."}. Remote clients are rejected, and the pipe is
+// created as the first instance, so a second copy of the tool cannot take it
+// over. Every client gets its own thread, so a slow command (a restart) does
+// not hold up a status query.
+class ControlServer {
+public:
+    using Handler = std::function<nlohmann::json(const nlohmann::json& request)>;
+
+    ControlServer(ControlConfig config, Handler handler)
+        : config_(std::move(config)), handler_(std::move(handler)) {}
+    ~ControlServer() { Stop(); }
+
+    ControlServer(const ControlServer&) = delete;
+    ControlServer& operator=(const ControlServer&) = delete;
+
+    // False if the pipe could not be created (for one, if another instance
+    // already serves it).
+    bool Start() {
+        HANDLE first = CreateInstance(true);
+        if (first == INVALID_HANDLE_VALUE) {
+            Log(LogLevel::Error, L"Control pipe could not be created: " + config_.pipeName +
+                L" (error " + std::to_wstring(GetLastError()) + L")");
+            return false;
+        }
+        stopping_ = false;
+        acceptor_ = std::thread([this, first] { Accept(first); });
+        Log(LogLevel::Info, L"Control pipe at " + config_.pipeName);
+        return true;
+    }
+
+    void Stop() {
+        if (!acceptor_.joinable())
+            return;
+        stopping_ = true;
+        // Wake the pending ConnectNamedPipe with a connection of our own.
+        HANDLE wake = CreateFileW(config_.pipeName.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, OPEN_EXISTING, 0, nullptr);
+        if (wake != INVALID_HANDLE_VALUE)
+            CloseHandle(wake);
+        acceptor_.join();
+        std::list<Client> clients;
+        {
+            std::lock_guard<std::mutex> lock(clientsMutex_);
+            clients.swap(clients_);
+        }
+        // The pipe is synchronous, so a client thread blocked in ReadFile (an
+        // idle client) or WriteFile (one not reading its replies) only wakes
+        // if that call is cancelled; DisconnectNamedPipe would wait behind it.
+        // A cancel only hits a call in progress, so it is repeated until the
+        // thread, which checks stopping_ between calls, has finished. A thread
+        // running a command is left to finish it.
+        for (Client& client : clients) {
+            while (!client.done) {
+                if (client.inPipeCall)
+                    CancelSynchronousIo(client.thread.native_handle());
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+            client.thread.join();
+            CloseHandle(client.pipe);
+        }
+    }
+
+private:
+    struct Client {
+        HANDLE pipe;
+        std::thread thread;
+        std::atomic<bool> inPipeCall{ false }; // in ReadFile or WriteFile
+        std::atomic<bool> done{ false };
+    };
+
+    HANDLE CreateInstance(bool first) const {
+        return CreateNamedPipeW(config_.pipeName.c_str(),
+            PIPE_ACCESS_DUPLEX | (first ? FILE_FLAG_FIRST_PIPE_INSTANCE : 0),
+            PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS,
+            PIPE_UNLIMITED_INSTANCES, 64 * 1024, 64 * 1024, 0, nullptr);
+    }
+
+    void Accept(HANDLE pipe) {
+        for (;;) {
+            const bool connected = ConnectNamedPipe(pipe, nullptr) || GetLastError() == ERROR_PIPE_CONNECTED;
+            if (stopping_) {
+                CloseHandle(pipe);
+                return;
+            }
+            if (connected) {
+                std::lock_guard<std::mutex> lock(clientsMutex_);
+                Reap();
+                Client& client = clients_.emplace_back();
+                client.pipe = pipe;
+                client.thread = std::thread([this, &client] {
+                    Serve(client);
+                    client.done = true;
+                });
+            }
+            else {
+                CloseHandle(pipe);
+            }
+            while ((pipe = CreateInstance(false)) == INVALID_HANDLE_VALUE) {
+                if (stopping_)
+                    return;
+                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            }
+        }
+    }
+
+    // Joins the threads of clients that have gone. Called under clientsMutex_.
+    void Reap() {
+        for (auto it = clients_.begin(); it != clients_.end();) {
+            if (!it->done) {
+                ++it;
+                continue;
+            }
+            it->thread.join();
+            CloseHandle(it->pipe);
+            it = clients_.erase(it);
+        }
+    }
+
+    void Serve(Client& client) {
+        const HANDLE pipe = client.pipe;
+        std::string buffer;
+        char chunk[4096];
+        while (!stopping_) {
+            DWORD read = 0;
+            client.inPipeCall = true;
+            const bool received = ReadFile(pipe, chunk, sizeof(chunk), &read, nullptr) && read > 0;
+            client.inPipeCall = false;
+            if (!received || stopping_)
+                break;
+            buffer.append(chunk, read);
+            size_t newline;
+            while ((newline = buffer.find('\n')) != std::string::npos) {
+                std::string line = buffer.substr(0, newline);
+                buffer.erase(0, newline + 1);
+                if (!line.empty() && line.back() == '\r')
+                    line.pop_back();
+                if (line.empty())
+                    continue;
+                const std::string reply = Dispatch(line).dump(-1, ' ', false, nlohmann::json::error_handler_t::replace) + "\n";
+                DWORD written = 0;
+                client.inPipeCall = true;
+                const bool sent = WriteFile(pipe, reply.data(), static_cast<DWORD>(reply.size()), &written, nullptr);
+                client.inPipeCall = false;
+                if (!sent || stopping_)
+                    return;
+            }
+            if (buffer.size() > 1024 * 1024)
+                break; // not a line-oriented client
+        }
+        if (stopping_)
+            return; // Stop() closes the pipe
+        client.inPipeCall = true;
+        FlushFileBuffers(pipe);
+        client.inPipeCall = false;
+        DisconnectNamedPipe(pipe);
+    }
+
+    nlohmann::json Dispatch(const std::string& line) {
+        const nlohmann::json request = nlohmann::json::parse(line, nullptr, false);
+        if (!request.is_object() || !request.contains("command") || !request["command"].is_string())
+            return { { "ok", false }, { "error", R"(expected a JSON object with a "command")" } };
+        try {
+            nlohmann::json reply = handler_(request);
+            if (!reply.is_object())
+                reply = { { "result", std::move(reply) } };
+            if (!reply.contains("ok"))
+                reply["ok"] = true;
+            return reply;
+        }
+        catch (const std::exception& e) {
+            return { { "ok", false }, { "error", e.what() } };
+        }
+    }
+
+    ControlConfig config_;
+    Handler handler_;
+    std::atomic<bool> stopping_{ false };
+    std::thread acceptor_;
+    std::mutex clientsMutex_;
+    std::list<Client> clients_;
+};
+
+// -------------------------
+// Control client
+// -------------------------
+// Sends one request line and returns the reply. Null if no instance is
+// listening on `pipeName`, or none became free within `waitMs`.
+inline nlohmann::json SendControlRequest(const std::wstring& pipeName, const nlohmann::json& request, DWORD waitMs = 2000) {
+    HANDLE pipe = CreateFileW(pipeName.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, OPEN_EXISTING, 0, nullptr);
+    if (pipe == INVALID_HANDLE_VALUE && GetLastError() == ERROR_PIPE_BUSY && WaitNamedPipeW(pipeName.c_str(), waitMs))
+        pipe = CreateFileW(pipeName.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, OPEN_EXISTING, 0, nullptr);
+    if (pipe == INVALID_HANDLE_VALUE)
+        return nullptr;
+    const std::string line = request.dump() + "\n";
+    DWORD written = 0;
+    std::string reply;
+    if (WriteFile(pipe, line.data(), static_cast<DWORD>(line.size()), &written, nullptr)) {
+        char chunk[4096];
+        DWORD read = 0;
+        while (reply.find('\n') == std::string::npos && ReadFile(pipe, chunk, sizeof(chunk), &read, nullptr) && read > 0)
+            reply.append(chunk, read);
+    }
+    CloseHandle(pipe);
+    nlohmann::json parsed = nlohmann::json::parse(reply.substr(0, reply.find('\n')), nullptr, false);
+    return parsed.is_discarded() ? nlohmann::json() : parsed;
+}
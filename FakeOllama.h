@@ -0,0 +1,186 @@
+#pragma once
+
+#include <winsock2.h>
+#include <windows.h>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include "Arena.h"
+#include "JsonScan.h"
+#include "Net.h"
+#include "TcpServer.h"
+
+// -------------------------
+// Fake Ollama server
+// -------------------------
+// Speaks enough of the Ollama API for the load generator and the proxy to
+// run offline: /api/generate and /api/chat stream NDJSON tokens at a fixed
+// rate after a prompt evaluation delay proportional to the prompt, /api/embed
+// returns a small vector, /api/tags and /api/version answer statically. At
+// most `parallel` generations run at once; the rest wait, like
+// OLLAMA_NUM_PARALLEL.
+struct FakeOllamaConfig {
+    std::string listenAddress = "127.0.0.1";
+    uint16_t listenPort = 0;            // 0 picks a free port
+    double tokensPerSecond = 50.0;      // per generation
+    double promptTokensPerSecond = 2000.0;
+    int parallel = 4;
+    int defaultNumPredict = 128;
+};
+
+class FakeOllama {
+public:
+    explicit FakeOllama(FakeOllamaConfig config) : config_(std::move(config)) {}
+    ~FakeOllama() { Stop(); }
+
+    FakeOllama(const FakeOllama&) = delete;
+    FakeOllama& operator=(const FakeOllama&) = delete;
+
+    bool Start() {
+        return server_.Start(config_.listenAddress, config_.listenPort,
+            [this](Socket& client, const std::string&) { ServeConnection(client); }, 1);
+    }
+
+    void Stop() { server_.Stop(); }
+
+    // "127.0.0.1:<port>", for pointing clients at it.
+    std::string Endpoint() const { return config_.listenAddress + ":" + std::to_string(server_.Port()); }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    void ServeConnection(Socket& client) {
+        std::string buffer;
+        Arena arena;
+        for (;;) {
+            arena.Reset();
+            HttpRequest request(arena);
+            if (!ReadHttpRequest(client, buffer, arena, request))
+                return;
+            const std::string_view path = request.target.substr(0, request.target.find('?'));
+            bool ok;
+            if (path == "/api/generate" || path == "/api/chat")
+                ok = Generate(client, request, path == "/api/chat");
+            else if (path == "/api/embed" || path == "/api/embeddings")
+                ok = Embed(client, request);
+            else if (path == "/api/tags")
+                ok = SendSimpleResponse(client, 200, "OK", "application/json",
+                    R"({"models":[{"name":"fake:latest","model":"fake:latest","size":0}]})");
+            else if (path == "/api/version")
+                ok = SendSimpleResponse(client, 200, "OK", "application/json", R"({"version":"0.0.0-fake"})");
+            else
+                ok = SendSimpleResponse(client, 404, "Not Found", "text/plain", "404 page not found");
+            if (!ok)
+                return;
+        }
+    }
+
+    // Holds one of the `parallel` generation slots.
+    class Slot {
+    public:
+        explicit Slot(FakeOllama& owner) : owner_(owner) {
+            std::unique_lock<std::mutex> lock(owner_.slotMutex_);
+            owner_.slotFree_.wait(lock, [&] { return owner_.busy_ < (std::max)(1, owner_.config_.parallel); });
+            ++owner_.busy_;
+        }
+        ~Slot() {
+            {
+                std::lock_guard<std::mutex> lock(owner_.slotMutex_);
+                --owner_.busy_;
+            }
+            owner_.slotFree_.notify_one();
+        }
+        Slot(const Slot&) = delete;
+        Slot& operator=(const Slot&) = delete;
+
+    private:
+        FakeOllama& owner_;
+    };
+
+    bool Generate(Socket& client, const HttpRequest& request, bool chat) {
+        const std::string model(JsonScan::Unquote(JsonScan::FindField(request.body, "model")));
+        int64_t numPredict = config_.defaultNumPredict;
+        JsonScan::ToInt(JsonScan::FindField(JsonScan::FindField(request.body, "options"), "num_predict"), numPredict);
+        numPredict = (std::max)(int64_t{ 1 }, numPredict);
+        const bool stream = JsonScan::FindField(request.body, "stream") != "false";
+        const int64_t promptTokens = (std::max)(int64_t{ 1 }, static_cast<int64_t>(request.body.size() / 4));
+
+        Slot slot(*this);
+        const auto start = Clock::now();
+        const auto promptDone = start + Seconds(static_cast<double>(promptTokens) / config_.promptTokensPerSecond);
+        const auto tokenGap = Seconds(1.0 / config_.tokensPerSecond);
+        std::this_thread::sleep_until(promptDone);
+
+        if (stream) {
+            static constexpr char head[] =
+                "HTTP/1.1 200 OK\r\nContent-Type: application/x-ndjson\r\nTransfer-Encoding: chunked\r\n\r\n";
+            if (!client.SendAll(head, sizeof(head) - 1))
+                return false;
+        }
+        std::string line;
+        for (int64_t i = 0; stream && i < numPredict; ++i) {
+            // Deadlines from the start so sleep granularity does not accumulate.
+            std::this_thread::sleep_until(promptDone + tokenGap * static_cast<double>(i + 1));
+            line = "{\"model\":\"" + model + "\",\"created_at\":\"2024-01-01T00:00:00Z\",";
+            line += chat ? "\"message\":{\"role\":\"assistant\",\"content\":\"tok" + std::to_string(i) + " \"}" :
+                "\"response\":\"tok" + std::to_string(i) + " \"";
+            line += ",\"done\":false}\n";
+            if (!SendChunk(client, line.data(), line.size()))
+                return false;
+        }
+        if (!stream)
+            std::this_thread::sleep_until(promptDone + tokenGap * static_cast<double>(numPredict));
+
+        const auto end = Clock::now();
+        char totals[512];
+        snprintf(totals, sizeof(totals),
+            "\"done\":true,\"done_reason\":\"stop\",\"total_duration\":%lld,\"load_duration\":0,"
+            "\"prompt_eval_count\":%lld,\"prompt_eval_duration\":%lld,\"eval_count\":%lld,\"eval_duration\":%lld}\n",
+            static_cast<long long>(Nanoseconds(end - start)), static_cast<long long>(promptTokens),
+            static_cast<long long>(Nanoseconds(promptDone - start)), static_cast<long long>(numPredict),
+            static_cast<long long>(Nanoseconds(end - promptDone)));
+        line = "{\"model\":\"" + model + "\",\"created_at\":\"2024-01-01T00:00:00Z\",";
+        if (!stream) {
+            std::string text;
+            for (int64_t i = 0; i < numPredict; ++i)
+                text += "tok" + std::to_string(i) + " ";
+            line += chat ? "\"message\":{\"role\":\"assistant\",\"content\":\"" + text + "\"}," :
+                "\"response\":\"" + text + "\",";
+            line += totals;
+            return SendSimpleResponse(client, 200, "OK", "application/json", line);
+        }
+        line += chat ? "\"message\":{\"role\":\"assistant\",\"content\":\"\"}," : "\"response\":\"\",";
+        line += totals;
+        return SendChunk(client, line.data(), line.size()) && SendLastChunk(client);
+    }
+
+    bool Embed(Socket& client, const HttpRequest& request) {
+        const std::string model(JsonScan::Unquote(JsonScan::FindField(request.body, "model")));
+        const int64_t tokens = (std::max)(int64_t{ 1 }, static_cast<int64_t>(request.body.size() / 4));
+        {
+            Slot slot(*this);
+            std::this_thread::sleep_for(Seconds(static_cast<double>(tokens) / config_.promptTokensPerSecond));
+        }
+        return SendSimpleResponse(client, 200, "OK", "application/json",
+            "{\"model\":\"" + model + "\",\"embeddings\":[[0.010,-0.020,0.030,0.040]],\"prompt_eval_count\":" +
+            std::to_string(tokens) + "}");
+    }
+
+    static Clock::duration Seconds(double seconds) {
+        return std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds));
+    }
+    static int64_t Nanoseconds(Clock::duration duration) {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+    }
+
+    FakeOllamaConfig config_;
+    TcpServer server_;
+    std::mutex slotMutex_;
+    std::condition_variable slotFree_;
+    int busy_ = 0;
+};
@@ -0,0 +1,195 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// -------------------------
+// Gzip
+// -------------------------
+// Small gzip encoder for precompressing cached assets: greedy LZ77 over a
+// 32 KB window with hash chains, written as one DEFLATE block with the fixed
+// Huffman codes. It gives up a few percent against zlib's dynamic codes but
+// needs no library, and it runs once per asset.
+namespace Gzip {
+
+inline uint32_t Crc32(std::string_view data, uint32_t crc = 0) {
+    static const std::array<uint32_t, 256> table = [] {
+        std::array<uint32_t, 256> t{};
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; ++k)
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            t[i] = c;
+        }
+        return t;
+    }();
+    crc = ~crc;
+    for (const char ch : data)
+        crc = table[(crc ^ static_cast<uint8_t>(ch)) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+namespace Detail {
+
+// DEFLATE packs bits starting from the least significant; Huffman codes are
+// defined most significant bit first and so are written reversed.
+class BitWriter {
+public:
+    explicit BitWriter(std::string& out) : out_(out) {}
+
+    void Bits(uint32_t value, int count) {
+        bits_ |= static_cast<uint64_t>(value) << used_;
+        used_ += count;
+        while (used_ >= 8) {
+            out_.push_back(static_cast<char>(bits_ & 0xFF));
+            bits_ >>= 8;
+            used_ -= 8;
+        }
+    }
+
+    void Code(uint32_t code, int length) {
+        uint32_t reversed = 0;
+        for (int i = 0; i < length; ++i)
+            reversed |= ((code >> i) & 1u) << (length - 1 - i);
+        Bits(reversed, length);
+    }
+
+    void Flush() {
+        if (used_ > 0)
+            out_.push_back(static_cast<char>(bits_ & 0xFF));
+        bits_ = 0;
+        used_ = 0;
+    }
+
+private:
+    std::string& out_;
+    uint64_t bits_ = 0;
+    int used_ = 0;
+};
+
+inline void Literal(BitWriter& writer, uint32_t symbol) {
+    if (symbol < 144)
+        writer.Code(0x30 + symbol, 8);
+    else if (symbol < 256)
+        writer.Code(0x190 + symbol - 144, 9);
+    else if (symbol < 280)
+        writer.Code(symbol - 256, 7);
+    else
+        writer.Code(0xC0 + symbol - 280, 8);
+}
+
+inline void Match(BitWriter& writer, uint32_t length, uint32_t distance) {
+    static constexpr uint16_t kLengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+        35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+    static constexpr uint8_t kLengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+        3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+    static constexpr uint16_t kDistanceBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+        257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+    static constexpr uint8_t kDistanceExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+        7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+    int l = 28;
+    while (kLengthBase[l] > length)
+        --l;
+    Literal(writer, 257 + static_cast<uint32_t>(l));
+    writer.Bits(length - kLengthBase[l], kLengthExtra[l]);
+    int d = 29;
+    while (kDistanceBase[d] > distance)
+        --d;
+    writer.Code(static_cast<uint32_t>(d), 5);
+    writer.Bits(distance - kDistanceBase[d], kDistanceExtra[d]);
+}
+
+} // namespace Detail
+
+// Returns `data` as a complete gzip member (RFC 1952).
+inline std::string Compress(std::string_view data) {
+    constexpr size_t kWindow = 32768;
+    constexpr size_t kMinMatch = 3;
+    constexpr size_t kMaxMatch = 258;
+    constexpr int kMaxChain = 48;
+    constexpr int kHashBits = 15;
+
+    std::string out;
+    out.reserve(data.size() / 3 + 64);
+    static constexpr unsigned char kHeader[10] = { 0x1F, 0x8B, 8, 0, 0, 0, 0, 0, 0, 0xFF };
+    out.append(reinterpret_cast<const char*>(kHeader), sizeof(kHeader));
+
+    Detail::BitWriter writer(out);
+    writer.Bits(1, 1); // final block
+    writer.Bits(1, 2); // fixed Huffman codes
+
+    const auto* bytes = reinterpret_cast<const uint8_t*>(data.data());
+    const size_t size = data.size();
+    std::vector<int32_t> head(size_t{ 1 } << kHashBits, -1);
+    std::vector<int32_t> previous(kWindow, -1);
+    auto hash = [&](size_t i) {
+        const uint32_t v = bytes[i] | (bytes[i + 1] << 8) | (bytes[i + 2] << 16);
+        return (v * 2654435761u) >> (32 - kHashBits);
+    };
+    auto insert = [&](size_t i) {
+        if (i + kMinMatch > size)
+            return;
+        const uint32_t h = hash(i);
+        previous[i & (kWindow - 1)] = head[h];
+        head[h] = static_cast<int32_t>(i);
+    };
+
+    size_t i = 0;
+    while (i < size) {
+        size_t bestLength = 0;
+        size_t bestDistance = 0;
+        if (i + kMinMatch <= size) {
+            const size_t limit = (std::min)(kMaxMatch, size - i);
+            int32_t candidate = head[hash(i)];
+            for (int chain = 0; candidate >= 0 && chain < kMaxChain; ++chain) {
+                const size_t distance = i - static_cast<size_t>(candidate);
+                if (distance > kWindow - 1)
+                    break;
+                if (bytes[candidate + bestLength] == bytes[i + bestLength]) {
+                    size_t length = 0;
+                    while (length < limit && bytes[candidate + length] == bytes[i + length])
+                        ++length;
+                    if (length > bestLength) {
+                        bestLength = length;
+                        bestDistance = distance;
+                        if (length == limit)
+                            break;
+                    }
+                }
+                const int32_t next = previous[static_cast<size_t>(candidate) & (kWindow - 1)];
+                if (next >= candidate)
+                    break;
+                candidate = next;
+            }
+        }
+        if (bestLength >= kMinMatch) {
+            Detail::Match(writer, static_cast<uint32_t>(bestLength), static_cast<uint32_t>(bestDistance));
+            for (size_t k = 0; k < bestLength; ++k)
+                insert(i + k);
+            i += bestLength;
+        }
+        else {
+            Detail::Literal(writer, bytes[i]);
+            insert(i);
+            ++i;
+        }
+    }
+    Detail::Literal(writer, 256); // end of block
+    writer.Flush();
+
+    const uint32_t crc = Crc32(data);
+    const uint32_t length = static_cast<uint32_t>(size);
+    for (int shift = 0; shift < 32; shift += 8)
+        out.push_back(static_cast<char>((crc >> shift) & 0xFF));
+    for (int shift = 0; shift < 32; shift += 8)
+        out.push_back(static_cast<char>((length >> shift) & 0xFF));
+    return out;
+}
+
+} // namespace Gzip
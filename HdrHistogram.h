@@ -0,0 +1,289 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// -------------------------
+// HDR histogram
+// -------------------------
+// Fixed-memory histogram with log-linear buckets, in the spirit of
+// HdrHistogram: values below 2^kSubBucketBits are counted exactly, and every
+// power of two above that is split into 2^(kSubBucketBits - 1) linear
+// sub-buckets, so any recorded value is reported within 1/64 (< 1.6%) of
+// its true value. Recording is two relaxed atomic adds (the bucket and the
+// sum), safe from any number of threads; the total is summed from the buckets
+// when read, and readers see a consistent-enough view for quantiles.
+//
+// Histograms with any trackable range merge bucket for bucket, and Encode()
+// packs one into a few hundred bytes to a few kilobytes, depending on how many
+// powers of two it spans (zero runs collapsed, varint counts), that
+// Decode() reads back, so distributions can be shipped and combined without
+// losing the tail.
+class HdrHistogram {
+public:
+    static constexpr int kSubBucketBits = 7;
+    static constexpr uint64_t kSubBucketCount = uint64_t{ 1 } << kSubBucketBits;
+    static constexpr uint64_t kSubBucketHalf = kSubBucketCount / 2;
+
+    // Values above `highestTrackableValue` are clamped to it.
+    explicit HdrHistogram(uint64_t highestTrackableValue = uint64_t{ 1 } << 36)
+        : highest_((std::max)(highestTrackableValue, kSubBucketCount)),
+          bucketCount_(IndexOf(highest_) + 1),
+          counts_(std::make_unique<std::atomic<uint64_t>[]>(bucketCount_)) {}
+
+    HdrHistogram(const HdrHistogram&) = delete;
+    HdrHistogram& operator=(const HdrHistogram&) = delete;
+
+    void Record(uint64_t value, uint64_t count = 1) {
+        value = (std::min)(value, highest_);
+        counts_[IndexOf(value)].fetch_add(count, std::memory_order_relaxed);
+        sum_.fetch_add(value * count, std::memory_order_relaxed);
+    }
+
+    uint64_t TotalCount() const {
+        uint64_t total = 0;
+        for (size_t index = 0; index < bucketCount_; ++index)
+            total += counts_[index].load(std::memory_order_relaxed);
+        return total;
+    }
+
+    uint64_t Sum() const { return sum_.load(std::memory_order_relaxed); }
+    uint64_t HighestTrackableValue() const { return highest_; }
+
+    // Lowest and highest recorded values, to bucket precision (0 if empty).
+    uint64_t MinValue() const {
+        for (size_t index = 0; index < bucketCount_; ++index) {
+            if (counts_[index].load(std::memory_order_relaxed))
+                return LowestEquivalentValue(index);
+        }
+        return 0;
+    }
+
+    uint64_t MaxValue() const {
+        for (size_t index = bucketCount_; index-- > 0;) {
+            if (counts_[index].load(std::memory_order_relaxed))
+                return (std::min)(HighestEquivalentValue(index), highest_);
+        }
+        return 0;
+    }
+
+    // Adds every count in `other`; values beyond this histogram's range are
+    // clamped to it. Safe while either histogram is being recorded into.
+    void Merge(const HdrHistogram& other) {
+        for (size_t index = 0; index < other.bucketCount_; ++index) {
+            const uint64_t count = other.counts_[index].load(std::memory_order_relaxed);
+            if (count)
+                counts_[(std::min)(index, bucketCount_ - 1)].fetch_add(count, std::memory_order_relaxed);
+        }
+        sum_.fetch_add(other.Sum(), std::memory_order_relaxed);
+    }
+
+    // Removes the counts of `other`, typically an earlier copy of this
+    // histogram, leaving what was recorded since. Counts stop at zero.
+    void Subtract(const HdrHistogram& other) {
+        for (size_t index = 0; index < other.bucketCount_; ++index) {
+            const uint64_t count = other.counts_[index].load(std::memory_order_relaxed);
+            if (!count)
+                continue;
+            std::atomic<uint64_t>& bucket = counts_[(std::min)(index, bucketCount_ - 1)];
+            uint64_t current = bucket.load(std::memory_order_relaxed);
+            while (!bucket.compare_exchange_weak(current, current - (std::min)(current, count), std::memory_order_relaxed)) {}
+        }
+        uint64_t sum = sum_.load(std::memory_order_relaxed);
+        const uint64_t otherSum = other.Sum();
+        while (!sum_.compare_exchange_weak(sum, sum - (std::min)(sum, otherSum), std::memory_order_relaxed)) {}
+    }
+
+    // Not atomic as a whole: values recorded during a reset may survive it.
+    void Reset() {
+        for (size_t index = 0; index < bucketCount_; ++index)
+            counts_[index].store(0, std::memory_order_relaxed);
+        sum_.store(0, std::memory_order_relaxed);
+    }
+
+    // Highest value equivalent to the one at quantile `q` (0..1).
+    uint64_t ValueAtQuantile(double q) const {
+        const uint64_t total = TotalCount();
+        if (total == 0)
+            return 0;
+        const double clamped = (std::min)(1.0, (std::max)(0.0, q));
+        const uint64_t rank = (std::max)(uint64_t{ 1 }, static_cast<uint64_t>(clamped * static_cast<double>(total) + 0.5));
+        uint64_t seen = 0;
+        for (size_t index = 0; index < bucketCount_; ++index) {
+            seen += counts_[index].load(std::memory_order_relaxed);
+            if (seen >= rank)
+                return (std::min)(HighestEquivalentValue(index), highest_);
+        }
+        return highest_;
+    }
+
+    // "HDR1", the sub-bucket bits, then varints: the highest trackable value,
+    // the sum, and the buckets from zero up to the last non-empty one, where
+    // a count is written as count << 1 and a run of empty buckets as
+    // run << 1 | 1.
+    std::string Encode() const {
+        std::string out("HDR1");
+        out.push_back(static_cast<char>(kSubBucketBits));
+        PutVarint(out, highest_);
+        PutVarint(out, Sum());
+        size_t end = bucketCount_;
+        while (end > 0 && counts_[end - 1].load(std::memory_order_relaxed) == 0)
+            --end;
+        uint64_t zeros = 0;
+        for (size_t index = 0; index < end; ++index) {
+            const uint64_t count = counts_[index].load(std::memory_order_relaxed);
+            if (count == 0) {
+                ++zeros;
+                continue;
+            }
+            if (zeros) {
+                PutVarint(out, zeros << 1 | 1);
+                zeros = 0;
+            }
+            PutVarint(out, count << 1);
+        }
+        return out;
+    }
+
+    // Null if `data` is not an Encode() of a histogram with this layout.
+    static std::unique_ptr<HdrHistogram> Decode(std::string_view data) {
+        if (data.size() < 5 || data.substr(0, 4) != "HDR1" || data[4] != static_cast<char>(kSubBucketBits))
+            return nullptr;
+        data.remove_prefix(5);
+        uint64_t highest, sum;
+        if (!GetVarint(data, highest) || !GetVarint(data, sum) || highest > (uint64_t{ 1 } << 62))
+            return nullptr;
+        auto histogram = std::make_unique<HdrHistogram>(highest);
+        size_t index = 0;
+        while (!data.empty()) {
+            uint64_t word;
+            if (!GetVarint(data, word))
+                return nullptr;
+            if (word & 1) {
+                index += static_cast<size_t>((std::min)(word >> 1, uint64_t{ histogram->bucketCount_ }));
+                continue;
+            }
+            if (index >= histogram->bucketCount_)
+                return nullptr;
+            histogram->counts_[index++].store(word >> 1, std::memory_order_relaxed);
+        }
+        histogram->sum_.store(sum, std::memory_order_relaxed);
+        return histogram;
+    }
+
+    // Encode() as base64, for JSON.
+    std::string ToBase64() const {
+        static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+        const std::string bytes = Encode();
+        std::string out;
+        out.reserve((bytes.size() + 2) / 3 * 4);
+        for (size_t i = 0; i < bytes.size(); i += 3) {
+            const size_t left = bytes.size() - i;
+            uint32_t group = static_cast<uint8_t>(bytes[i]) << 16;
+            if (left > 1)
+                group |= static_cast<uint8_t>(bytes[i + 1]) << 8;
+            if (left > 2)
+                group |= static_cast<uint8_t>(bytes[i + 2]);
+            out.push_back(alphabet[group >> 18 & 63]);
+            out.push_back(alphabet[group >> 12 & 63]);
+            out.push_back(left > 1 ? alphabet[group >> 6 & 63] : '=');
+            out.push_back(left > 2 ? alphabet[group & 63] : '=');
+        }
+        return out;
+    }
+
+    static std::unique_ptr<HdrHistogram> FromBase64(std::string_view text) {
+        std::string bytes;
+        uint32_t group = 0;
+        int bits = 0;
+        for (const char c : text) {
+            int value;
+            if (c >= 'A' && c <= 'Z') value = c - 'A';
+            else if (c >= 'a' && c <= 'z') value = c - 'a' + 26;
+            else if (c >= '0' && c <= '9') value = c - '0' + 52;
+            else if (c == '+') value = 62;
+            else if (c == '/') value = 63;
+            else if (c == '=') break;
+            else return nullptr;
+            group = group << 6 | static_cast<uint32_t>(value);
+            bits += 6;
+            if (bits >= 8) {
+                bits -= 8;
+                bytes.push_back(static_cast<char>(group >> bits & 0xFF));
+            }
+        }
+        return Decode(bytes);
+    }
+
+    static size_t IndexOf(uint64_t value) {
+        if (value < kSubBucketCount)
+            return static_cast<size_t>(value);
+        const int exponent = HighestBit(value) - kSubBucketBits + 1;
+        return static_cast<size_t>(static_cast<uint64_t>(exponent) * kSubBucketHalf + (value >> exponent));
+    }
+
+    static uint64_t HighestEquivalentValue(size_t index) {
+        if (index < kSubBucketCount)
+            return index;
+        const uint64_t exponent = index / kSubBucketHalf - 1;
+        const uint64_t mantissa = index - exponent * kSubBucketHalf;
+        return ((mantissa + 1) << exponent) - 1;
+    }
+
+    static uint64_t LowestEquivalentValue(size_t index) {
+        if (index < kSubBucketCount)
+            return index;
+        const uint64_t exponent = index / kSubBucketHalf - 1;
+        const uint64_t mantissa = index - exponent * kSubBucketHalf;
+        return mantissa << exponent;
+    }
+
+private:
+    static void PutVarint(std::string& out, uint64_t value) {
+        while (value >= 0x80) {
+            out.push_back(static_cast<char>(value | 0x80));
+            value >>= 7;
+        }
+        out.push_back(static_cast<char>(value));
+    }
+
+    static bool GetVarint(std::string_view& data, uint64_t& value) {
+        value = 0;
+        for (int shift = 0; shift < 64 && !data.empty(); shift += 7) {
+            const uint8_t byte = static_cast<uint8_t>(data.front());
+            data.remove_prefix(1);
+            value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if (!(byte & 0x80))
+                return true;
+        }
+        return false;
+    }
+
+    static int HighestBit(uint64_t value) {
+#if defined(_MSC_VER) && defined(_M_X64)
+        unsigned long bit;
+        _BitScanReverse64(&bit, value);
+        return static_cast<int>(bit);
+#elif defined(_MSC_VER)
+        unsigned long bit;
+        if (_BitScanReverse(&bit, static_cast<unsigned long>(value >> 32)))
+            return static_cast<int>(bit) + 32;
+        _BitScanReverse(&bit, static_cast<unsigned long>(value));
+        return static_cast<int>(bit);
+#else
+        return 63 - __builtin_clzll(value);
+#endif
+    }
+
+    uint64_t highest_;
+    size_t bucketCount_;
+    std::unique_ptr<std::atomic<uint64_t>[]> counts_;
+    std::atomic<uint64_t> sum_{ 0 };
+};
@@ -0,0 +1,325 @@
+#pragma once
+
+#include <winsock2.h>
+#include <windows.h>
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+// -------------------------
+// Journal configuration
+// -------------------------
+struct JournalConfig {
+    bool enabled = true;
+    std::wstring directory;              // segment files go here
+    uint32_t segmentBytes = 1024 * 1024; // each segment file is this size
+    int maxSegments = 8;                 // older segments are deleted
+};
+
+// What happened; the meaning of an event's two values depends on it.
+enum class JournalEvent : uint16_t {
+    ProcessStart = 1,   // value0 process id (0 if it failed), value1 error code; text: path
+    ProcessExit = 2,    // value0 process id (0 if unknown), value1 exit code or 1 if terminated; text: name
+    Probe = 3,          // value0 HTTP status (0 if no answer), value1 latency in us; text: target
+    ContainerState = 4, // value0 a JournalContainerState; text: detail
+    ShutdownStep = 5,   // value0 step number; text: step
+};
+
+enum class JournalContainerState : int64_t { Starting = 0, Up = 1, Unavailable = 2, Stopped = 3 };
+
+// -------------------------
+// Event journal
+// -------------------------
+// Append-only binary record of typed events for working out, after the fact,
+// why a start hung or what happened before Docker went away. Records go into
+// memory-mapped segment files of fixed size, so a write is a copy into
+// memory and the OS persists the pages even if the process dies. When a
+// segment fills the next one is started and the oldest beyond maxSegments is
+// deleted, bounding the disk used. Timestamps are QueryPerformanceCounter
+// ticks; each segment header anchors them to wall-clock time.
+// `journal dump` decodes the segments to JSON.
+class Journal {
+public:
+    static constexpr char kMagic[8] = { 'O', 'W', 'U', 'I', 'J', 'R', 'N', 'L' };
+    static constexpr uint32_t kVersion = 1;
+    static constexpr size_t kMaxText = 240;
+
+#pragma pack(push, 1)
+    struct SegmentHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t headerBytes;
+        uint64_t sequence;
+        uint64_t ticksPerSecond;
+        uint64_t anchorTicks;    // QPC at creation...
+        uint64_t anchorFileTime; // ...and the UTC FILETIME at the same moment
+        uint32_t processId;
+        uint8_t reserved[20];
+    };
+
+    // Followed by `textBytes` of UTF-8 and padding to 8 bytes. A zero
+    // `bytes` marks the end of a segment's records.
+    struct RecordHeader {
+        uint32_t bytes;
+        uint16_t type;
+        uint16_t textBytes;
+        uint64_t ticks;
+        int64_t value0;
+        int64_t value1;
+    };
+#pragma pack(pop)
+    static_assert(sizeof(SegmentHeader) == 72, "segment header layout");
+    static_assert(sizeof(RecordHeader) == 32, "record header layout");
+
+    static Journal& Instance() {
+        static Journal journal;
+        return journal;
+    }
+
+    Journal(const Journal&) = delete;
+    Journal& operator=(const Journal&) = delete;
+
+    // Starts a new segment in the configured directory after any already
+    // there. Events recorded before this are discarded.
+    bool Open(const JournalConfig& config) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        CloseSegment();
+        if (!config.enabled)
+            return false;
+        config_ = config;
+        config_.segmentBytes = (std::max)(config_.segmentBytes, static_cast<uint32_t>(64 * 1024));
+        config_.maxSegments = (std::max)(1, config_.maxSegments);
+        directory_ = config_.directory;
+        std::error_code error;
+        std::filesystem::create_directories(directory_, error);
+        uint64_t last = 0;
+        for (const auto& [sequence, path] : ListSegments(directory_))
+            last = (std::max)(last, sequence);
+        return OpenSegment(last + 1);
+    }
+
+    void Record(JournalEvent type, int64_t value0, int64_t value1, std::string_view text) {
+        LARGE_INTEGER now;
+        QueryPerformanceCounter(&now);
+        text = text.substr(0, kMaxText);
+        const uint32_t bytes = static_cast<uint32_t>((sizeof(RecordHeader) + text.size() + 7) & ~size_t{ 7 });
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!view_)
+            return;
+        // Keep room for the zero terminator a reader stops at.
+        if (offset_ + bytes + sizeof(uint32_t) > config_.segmentBytes && !OpenSegment(sequence_ + 1))
+            return;
+        RecordHeader header{ bytes, static_cast<uint16_t>(type), static_cast<uint16_t>(text.size()),
+            static_cast<uint64_t>(now.QuadPart), value0, value1 };
+        char* at = view_ + offset_;
+        std::memcpy(at + sizeof(uint32_t), reinterpret_cast<const char*>(&header) + sizeof(uint32_t),
+            sizeof(RecordHeader) - sizeof(uint32_t));
+        std::memcpy(at + sizeof(RecordHeader), text.data(), text.size());
+        // The length goes in last, so a record torn by a crash ends the segment.
+        std::memcpy(at, &header.bytes, sizeof(uint32_t));
+        offset_ += bytes;
+    }
+
+    void Close() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        CloseSegment();
+    }
+
+    // Decodes every segment in `directory`, oldest first, as a JSON array.
+    static nlohmann::json Dump(const std::filesystem::path& directory) {
+        nlohmann::json events = nlohmann::json::array();
+        for (const auto& [sequence, path] : ListSegments(directory)) {
+            std::ifstream file(path, std::ios::binary);
+            const std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+            SegmentHeader segment{};
+            if (data.size() < sizeof(segment))
+                continue;
+            std::memcpy(&segment, data.data(), sizeof(segment));
+            if (std::memcmp(segment.magic, kMagic, sizeof(kMagic)) != 0 || segment.version != kVersion ||
+                segment.ticksPerSecond == 0)
+                continue;
+            size_t offset = segment.headerBytes;
+            while (offset + sizeof(RecordHeader) <= data.size()) {
+                RecordHeader record{};
+                std::memcpy(&record, data.data() + offset, sizeof(record));
+                if (record.bytes < sizeof(RecordHeader) || offset + record.bytes > data.size() ||
+                    sizeof(RecordHeader) + record.textBytes > record.bytes)
+                    break;
+                events.push_back(Decode(segment, record, std::string_view(data.data() + offset + sizeof(RecordHeader),
+                    record.textBytes)));
+                offset += record.bytes;
+            }
+        }
+        return events;
+    }
+
+private:
+    Journal() = default;
+    ~Journal() { Close(); }
+
+    static std::filesystem::path SegmentPath(const std::filesystem::path& directory, uint64_t sequence) {
+        char name[40];
+        snprintf(name, sizeof(name), "journal-%08llu.bin", static_cast<unsigned long long>(sequence));
+        return directory / name;
+    }
+
+    // Segment files in `directory` by sequence number.
+    static std::vector<std::pair<uint64_t, std::filesystem::path>> ListSegments(const std::filesystem::path& directory) {
+        std::vector<std::pair<uint64_t, std::filesystem::path>> segments;
+        std::error_code error;
+        for (const auto& entry : std::filesystem::directory_iterator(directory, error)) {
+            const std::string name = entry.path().filename().string();
+            if (name.size() != 20 || name.compare(0, 8, "journal-") != 0 || name.compare(16, 4, ".bin") != 0)
+                continue;
+            uint64_t sequence = 0;
+            const char* digits = name.data() + 8;
+            const auto parsed = std::from_chars(digits, digits + 8, sequence);
+            if (parsed.ec == std::errc() && parsed.ptr == digits + 8)
+                segments.emplace_back(sequence, entry.path());
+        }
+        std::sort(segments.begin(), segments.end());
+        return segments;
+    }
+
+    bool OpenSegment(uint64_t sequence) {
+        CloseSegment();
+        const std::filesystem::path path = SegmentPath(directory_, sequence);
+        file_ = CreateFileW(path.wstring().c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr,
+            CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file_ == INVALID_HANDLE_VALUE)
+            return false;
+        // The mapping extends the file to its full size, zero-filled.
+        mapping_ = CreateFileMappingW(file_, nullptr, PAGE_READWRITE, 0, config_.segmentBytes, nullptr);
+        if (mapping_)
+            view_ = static_cast<char*>(MapViewOfFile(mapping_, FILE_MAP_WRITE, 0, 0, config_.segmentBytes));
+        if (!view_) {
+            CloseSegment();
+            return false;
+        }
+        sequence_ = sequence;
+
+        SegmentHeader header{};
+        std::memcpy(header.magic, kMagic, sizeof(kMagic));
+        header.version = kVersion;
+        header.headerBytes = sizeof(SegmentHeader);
+        header.sequence = sequence;
+        LARGE_INTEGER frequency;
+        LARGE_INTEGER ticks;
+        FILETIME wall;
+        QueryPerformanceFrequency(&frequency);
+        QueryPerformanceCounter(&ticks);
+        GetSystemTimePreciseAsFileTime(&wall);
+        header.ticksPerSecond = static_cast<uint64_t>(frequency.QuadPart);
+        header.anchorTicks = static_cast<uint64_t>(ticks.QuadPart);
+        header.anchorFileTime = (static_cast<uint64_t>(wall.dwHighDateTime) << 32) | wall.dwLowDateTime;
+        header.processId = GetCurrentProcessId();
+        std::memcpy(view_, &header, sizeof(header));
+        offset_ = (sizeof(SegmentHeader) + 7) & ~size_t{ 7 };
+
+        if (sequence > static_cast<uint64_t>(config_.maxSegments)) {
+            for (const auto& [old, oldPath] : ListSegments(directory_)) {
+                if (old + static_cast<uint64_t>(config_.maxSegments) <= sequence) {
+                    std::error_code error;
+                    std::filesystem::remove(oldPath, error);
+                }
+            }
+        }
+        return true;
+    }
+
+    void CloseSegment() {
+        if (view_) {
+            FlushViewOfFile(view_, 0);
+            UnmapViewOfFile(view_);
+            view_ = nullptr;
+        }
+        if (mapping_) {
+            CloseHandle(mapping_);
+            mapping_ = nullptr;
+        }
+        if (file_ != INVALID_HANDLE_VALUE) {
+            CloseHandle(file_);
+            file_ = INVALID_HANDLE_VALUE;
+        }
+    }
+
+    static nlohmann::json Decode(const SegmentHeader& segment, const RecordHeader& record, std::string_view text) {
+        static const char* const kStates[] = { "starting", "up", "unavailable", "stopped" };
+        // Ticks relative to the anchor, to UTC.
+        const double seconds = (static_cast<double>(record.ticks) - static_cast<double>(segment.anchorTicks)) /
+            static_cast<double>(segment.ticksPerSecond);
+        const int64_t fileTime = static_cast<int64_t>(segment.anchorFileTime) + static_cast<int64_t>(seconds * 1e7);
+        FILETIME wall{ static_cast<DWORD>(fileTime & 0xFFFFFFFF), static_cast<DWORD>(static_cast<uint64_t>(fileTime) >> 32) };
+        SYSTEMTIME utc{};
+        FileTimeToSystemTime(&wall, &utc);
+        char stamp[40];
+        snprintf(stamp, sizeof(stamp), "%04u-%02u-%02uT%02u:%02u:%02u.%03u%03uZ", utc.wYear, utc.wMonth, utc.wDay,
+            utc.wHour, utc.wMinute, utc.wSecond, utc.wMilliseconds, static_cast<unsigned>((fileTime / 10) % 1000));
+
+        nlohmann::json event;
+        event["time"] = stamp;
+        event["monotonicNs"] = static_cast<uint64_t>(static_cast<double>(record.ticks) * 1e9 /
+            static_cast<double>(segment.ticksPerSecond));
+        event["segment"] = segment.sequence;
+        event["pid"] = segment.processId;
+        const std::string textValue(text);
+        switch (static_cast<JournalEvent>(record.type)) {
+        case JournalEvent::ProcessStart:
+            event["event"] = "process_start";
+            event["path"] = textValue;
+            event["processId"] = record.value0;
+            event["ok"] = record.value1 == 0;
+            if (record.value1 != 0)
+                event["error"] = record.value1;
+            break;
+        case JournalEvent::ProcessExit:
+            event["event"] = "process_exit";
+            event["name"] = textValue;
+            if (record.value0 != 0)
+                event["processId"] = record.value0;
+            event["exitCode"] = record.value1;
+            break;
+        case JournalEvent::Probe:
+            event["event"] = "probe";
+            event["target"] = textValue;
+            event["status"] = record.value0;
+            event["latencyMs"] = static_cast<double>(record.value1) / 1000.0;
+            break;
+        case JournalEvent::ContainerState:
+            event["event"] = "container_state";
+            event["state"] = record.value0 >= 0 && record.value0 < 4 ? kStates[record.value0] : "unknown";
+            event["detail"] = textValue;
+            break;
+        case JournalEvent::ShutdownStep:
+            event["event"] = "shutdown_step";
+            event["step"] = record.value0;
+            event["detail"] = textValue;
+            break;
+        default:
+            event["event"] = "unknown";
+            event["type"] = record.type;
+            event["values"] = { record.value0, record.value1 };
+            event["text"] = textValue;
+            break;
+        }
+        return event;
+    }
+
+    std::mutex mutex_;
+    JournalConfig config_;
+    std::filesystem::path directory_;
+    uint64_t sequence_ = 0;
+    HANDLE file_ = INVALID_HANDLE_VALUE;
+    HANDLE mapping_ = nullptr;
+    char* view_ = nullptr;
+    size_t offset_ = 0;
+};
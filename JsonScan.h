@@ -0,0 +1,214 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <string_view>
+#include "SimdScan.h"
+
+// -------------------------
+// JSON field scanner
+// -------------------------
+// The proxy only needs a few top-level fields of each request body, so it
+// locates them in place instead of building a DOM. Values are returned as raw
+// slices of the input (strings keep their quotes, escapes are not decoded).
+// Strings and nested containers are skipped with SIMD searches for the next
+// quote, backslash or bracket, so long message contents cost little.
+namespace JsonScan {
+
+inline bool IsWhitespace(char c) { return c == ' ' || c == '\t' || c == '\r' || c == '\n'; }
+
+inline size_t SkipWhitespace(std::string_view json, size_t pos) {
+    while (pos < json.size() && IsWhitespace(json[pos])) ++pos;
+    return pos;
+}
+
+// Returns the index just past the string starting at `pos` (which must be a quote).
+inline size_t SkipString(std::string_view json, size_t pos) {
+    for (++pos;; pos += 2) {
+        pos = SimdScan::FindEither(json, pos, '"', '\\');
+        if (pos >= json.size())
+            return json.size();
+        if (json[pos] == '"')
+            return pos + 1;
+    }
+}
+
+// Returns the index just past the value starting at `pos`.
+inline size_t SkipValue(std::string_view json, size_t pos) {
+    if (pos >= json.size())
+        return pos;
+    if (json[pos] == '"')
+        return SkipString(json, pos);
+    if (json[pos] == '{' || json[pos] == '[') {
+        int depth = 0;
+        for (;;) {
+            pos = SimdScan::FindStructural(json, pos);
+            if (pos >= json.size())
+                return json.size();
+            const char c = json[pos];
+            if (c == '"') {
+                pos = SkipString(json, pos);
+                continue;
+            }
+            if (c == '{' || c == '[')
+                ++depth;
+            else if (--depth == 0)
+                return pos + 1;
+            ++pos;
+        }
+    }
+    while (pos < json.size() && json[pos] != ',' && json[pos] != '}' && json[pos] != ']' && !IsWhitespace(json[pos]))
+        ++pos;
+    return pos;
+}
+
+// Calls `visit(name, rawValue)` for each top-level member of a JSON object
+// until it returns false.
+template <typename Visitor>
+void ForEachMember(std::string_view json, Visitor&& visit) {
+    size_t pos = SkipWhitespace(json, 0);
+    if (pos >= json.size() || json[pos] != '{')
+        return;
+    ++pos;
+    for (;;) {
+        pos = SkipWhitespace(json, pos);
+        if (pos >= json.size() || json[pos] != '"')
+            return;
+        const size_t keyEnd = SkipString(json, pos);
+        const std::string_view name = json.substr(pos + 1, keyEnd - pos - 2);
+        pos = SkipWhitespace(json, keyEnd);
+        if (pos >= json.size() || json[pos] != ':')
+            return;
+        pos = SkipWhitespace(json, pos + 1);
+        const size_t valueEnd = SkipValue(json, pos);
+        if (!visit(name, json.substr(pos, valueEnd - pos)))
+            return;
+        pos = SkipWhitespace(json, valueEnd);
+        if (pos >= json.size() || json[pos] != ',')
+            return;
+        ++pos;
+    }
+}
+
+// Finds the raw value of `key` among the top-level members of a JSON object.
+inline std::string_view FindField(std::string_view json, std::string_view key) {
+    std::string_view found;
+    ForEachMember(json, [&](std::string_view name, std::string_view value) {
+        if (name != key)
+            return true;
+        found = value;
+        return false;
+    });
+    return found;
+}
+
+// Finds several top-level members in one pass; values[i] receives the raw
+// value of keys[i], or stays empty. Returns how many were found.
+template <size_t N>
+size_t FindFields(std::string_view json, const std::string_view (&keys)[N], std::string_view (&values)[N]) {
+    size_t found = 0;
+    ForEachMember(json, [&](std::string_view name, std::string_view value) {
+        for (size_t i = 0; i < N; ++i) {
+            if (values[i].empty() && name == keys[i]) {
+                values[i] = value;
+                ++found;
+                break;
+            }
+        }
+        return found < N;
+    });
+    return found;
+}
+
+inline std::string_view Unquote(std::string_view value) {
+    if (value.size() >= 2 && value.front() == '"' && value.back() == '"')
+        return value.substr(1, value.size() - 2);
+    return {};
+}
+
+inline bool ToInt(std::string_view value, int64_t& out) {
+    if (value.empty() || value.size() > 20)
+        return false;
+    char digits[24];
+    value.copy(digits, value.size());
+    digits[value.size()] = '\0';
+    char* end = nullptr;
+    out = std::strtoll(digits, &end, 10);
+    return end == digits + value.size();
+}
+
+inline bool ToDouble(std::string_view value, double& out) {
+    if (value.empty() || value.size() > 31)
+        return false;
+    char digits[32];
+    value.copy(digits, value.size());
+    digits[value.size()] = '\0';
+    char* end = nullptr;
+    out = std::strtod(digits, &end);
+    return end == digits + value.size();
+}
+
+inline bool IsTrue(std::string_view value) { return value == "true"; }
+
+// Loose lookup of `"key": <integer>` anywhere in `text`; used on response
+// tails where the enclosing object may have been cut off.
+inline bool FindIntAnywhere(std::string_view text, std::string_view key, int64_t& out) {
+    const std::string quoted = "\"" + std::string(key) + "\"";
+    const size_t at = text.rfind(quoted);
+    if (at == std::string_view::npos)
+        return false;
+    size_t pos = SkipWhitespace(text, at + quoted.size());
+    if (pos >= text.size() || text[pos] != ':')
+        return false;
+    pos = SkipWhitespace(text, pos + 1);
+    return ToInt(text.substr(pos, SkipValue(text, pos) - pos), out);
+}
+
+// -------------------------
+// NDJSON line splitter
+// -------------------------
+// Hands out the lines of a byte stream as views into the caller's buffers.
+// Only a line that straddles two reads is copied, into a carry buffer that is
+// reused for the life of the stream; overlong lines are dropped.
+class NdjsonSplitter {
+public:
+    template <typename OnLine>
+    void Feed(const char* data, size_t length, OnLine&& onLine) {
+        const std::string_view input(data, length);
+        size_t start = 0;
+        for (;;) {
+            const size_t newline = SimdScan::Find(input, start, '\n');
+            if (newline == input.size())
+                break;
+            const std::string_view piece = input.substr(start, newline - start);
+            if (overflowed_) {
+                overflowed_ = false;
+            }
+            else if (carry_.empty()) {
+                onLine(piece);
+            }
+            else {
+                carry_.append(piece);
+                onLine(std::string_view(carry_));
+                carry_.clear();
+            }
+            start = newline + 1;
+        }
+        if (overflowed_ || start == input.size())
+            return;
+        if (carry_.size() + (input.size() - start) > kMaxLine) {
+            carry_.clear();
+            overflowed_ = true;
+            return;
+        }
+        carry_.append(input.substr(start));
+    }
+
+private:
+    static constexpr size_t kMaxLine = 1024 * 1024;
+    std::string carry_;
+    bool overflowed_ = false;
+};
+
+} // namespace JsonScan
@@ -0,0 +1,298 @@
+#pragma once
+
+#include <winsock2.h>
+#include <windows.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cwchar>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+
+// Lines below this level compile to nothing, message included, at Log()
+// call sites (Common.h) with a constant level: 0 keeps everything, 1 drops
+// Info, 2 keeps only Error.
+#ifndef OWUI_LOG_MIN_LEVEL
+#define OWUI_LOG_MIN_LEVEL 0
+#endif
+
+enum class LogLevel { Info, Warning, Error };
+
+// -------------------------
+// Logger configuration
+// -------------------------
+struct LogConfig {
+    bool console = true;
+    std::wstring file;                    // empty disables file logging
+    size_t maxFileBytes = 10 * 1024 * 1024;
+    int maxFiles = 5;                     // rotated copies kept: file.1 ... file.N
+    bool blockWhenFull = false;           // false drops lines (and counts them)
+};
+
+// -------------------------
+// Asynchronous logger
+// -------------------------
+// Log lines are copied into fixed-size records in a bounded lock-free ring
+// (Vyukov's sequence-numbered queue, used multi-producer/single-consumer)
+// and written by one background thread: to the console, flushed once per
+// batch rather than per line, and to a size-rotated UTF-8 file with
+// timestamps. A producer claims a slot with one CAS and copies its text, so
+// logging never waits on console or disk I/O. When the ring is full a line is
+// dropped (the writer reports how many) or, with blockWhenFull, the producer
+// yields until there is room.
+class AsyncLogger {
+public:
+    static constexpr size_t kCapacity = 1024; // records; a power of two
+    static constexpr size_t kRecordChars = 480;
+
+    static AsyncLogger& Instance() {
+        static AsyncLogger logger;
+        return logger;
+    }
+
+    AsyncLogger(const AsyncLogger&) = delete;
+    AsyncLogger& operator=(const AsyncLogger&) = delete;
+
+    // Takes effect from the next batch the writer drains.
+    void Configure(LogConfig config) {
+        std::lock_guard<std::mutex> lock(configMutex_);
+        blockWhenFull_.store(config.blockWhenFull, std::memory_order_relaxed);
+        pending_ = std::make_unique<LogConfig>(std::move(config));
+    }
+
+    void Write(LogLevel level, std::wstring_view message) {
+        size_t position = tail_.load(std::memory_order_relaxed);
+        Record* record;
+        for (;;) {
+            record = &ring_[position & (kCapacity - 1)];
+            const size_t sequence = record->sequence.load(std::memory_order_acquire);
+            const intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+            if (difference == 0) {
+                if (tail_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (difference < 0) {
+                // Full: the writer has not yet freed this slot.
+                if (!blockWhenFull_.load(std::memory_order_relaxed)) {
+                    dropped_.fetch_add(1, std::memory_order_relaxed);
+                    return;
+                }
+                if (writerSleeping_.exchange(false, std::memory_order_acq_rel))
+                    Wake();
+                std::this_thread::yield();
+                position = tail_.load(std::memory_order_relaxed);
+            }
+            else {
+                position = tail_.load(std::memory_order_relaxed);
+            }
+        }
+        record->level = level;
+        GetSystemTimePreciseAsFileTime(&record->time);
+        record->length = static_cast<uint16_t>((std::min)(message.size(), kRecordChars));
+        std::wmemcpy(record->text, message.data(), record->length);
+        record->truncated = message.size() > kRecordChars;
+        record->sequence.store(position + 1, std::memory_order_release);
+        // Only the first producer to find the writer asleep pays for the wake-up.
+        if (writerSleeping_.load(std::memory_order_acquire) && writerSleeping_.exchange(false, std::memory_order_acq_rel))
+            Wake();
+    }
+
+    // Blocks until every line logged before the call has been written.
+    void Flush() {
+        const size_t target = tail_.load(std::memory_order_acquire);
+        while (written_.load(std::memory_order_acquire) < target && running_.load(std::memory_order_relaxed)) {
+            Wake();
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    uint64_t Dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+private:
+    struct Record {
+        std::atomic<size_t> sequence{ 0 };
+        LogLevel level = LogLevel::Info;
+        bool truncated = false;
+        uint16_t length = 0;
+        FILETIME time{};
+        wchar_t text[kRecordChars];
+    };
+
+    AsyncLogger() : ring_(std::make_unique<Record[]>(kCapacity)) {
+        for (size_t i = 0; i < kCapacity; ++i)
+            ring_[i].sequence.store(i, std::memory_order_relaxed);
+        writer_ = std::thread([this] { Drain(); });
+    }
+
+    ~AsyncLogger() {
+        running_.store(false, std::memory_order_release);
+        Wake();
+        if (writer_.joinable())
+            writer_.join();
+    }
+
+    void Wake() {
+        std::lock_guard<std::mutex> lock(wakeMutex_);
+        wake_.notify_one();
+    }
+
+    void Drain() {
+        for (;;) {
+            ApplyConfig();
+            const bool wrote = WriteAvailable();
+            if (!wrote) {
+                if (!running_.load(std::memory_order_acquire)) {
+                    if (!WriteAvailable())
+                        break;
+                    continue;
+                }
+                // Producers notify only while this flag is set; the timeout
+                // covers a line published just before it was raised.
+                std::unique_lock<std::mutex> lock(wakeMutex_);
+                writerSleeping_.store(true, std::memory_order_seq_cst);
+                wake_.wait_for(lock, std::chrono::milliseconds(50));
+                writerSleeping_.store(false, std::memory_order_relaxed);
+            }
+        }
+        if (file_.is_open())
+            file_.flush();
+    }
+
+    // Writes every published record; returns whether there were any.
+    bool WriteAvailable() {
+        bool any = false;
+        for (;;) {
+            Record& record = ring_[head_ & (kCapacity - 1)];
+            if (record.sequence.load(std::memory_order_acquire) != head_ + 1)
+                break;
+            WriteLine(record);
+            record.sequence.store(head_ + kCapacity, std::memory_order_release);
+            ++head_;
+            written_.store(head_, std::memory_order_release);
+            any = true;
+        }
+        const uint64_t dropped = dropped_.load(std::memory_order_relaxed);
+        if (dropped != reportedDropped_) {
+            const std::wstring notice = L"[WARNING] " + std::to_wstring(dropped - reportedDropped_) +
+                L" log lines dropped (log buffer full)";
+            reportedDropped_ = dropped;
+            Emit(notice, FILETIME{});
+            any = true;
+        }
+        if (any) {
+            if (config_.console)
+                std::wcout.flush();
+            if (file_.is_open())
+                file_.flush();
+        }
+        return any;
+    }
+
+    void WriteLine(const Record& record) {
+        const wchar_t* prefix = record.level == LogLevel::Info ? L"[INFO] " :
+            record.level == LogLevel::Warning ? L"[WARNING] " : L"[ERROR] ";
+        line_.assign(prefix);
+        line_.append(record.text, record.length);
+        if (record.truncated)
+            line_.append(L"...");
+        Emit(line_, record.time);
+    }
+
+    void Emit(const std::wstring& line, FILETIME time) {
+        if (config_.console)
+            std::wcout << line << L'\n';
+        if (config_.file.empty())
+            return;
+        if (!file_.is_open())
+            OpenFile();
+        if (!file_.is_open())
+            return;
+        if (time.dwLowDateTime == 0 && time.dwHighDateTime == 0)
+            GetSystemTimePreciseAsFileTime(&time);
+        SYSTEMTIME utc;
+        FileTimeToSystemTime(&time, &utc);
+        char stamp[40];
+        const int stampLength = snprintf(stamp, sizeof(stamp), "%04u-%02u-%02uT%02u:%02u:%02u.%03uZ ",
+            utc.wYear, utc.wMonth, utc.wDay, utc.wHour, utc.wMinute, utc.wSecond, utc.wMilliseconds);
+        const int size = WideCharToMultiByte(CP_UTF8, 0, line.data(), static_cast<int>(line.size()), nullptr, 0,
+            nullptr, nullptr);
+        utf8_.resize(static_cast<size_t>(size));
+        WideCharToMultiByte(CP_UTF8, 0, line.data(), static_cast<int>(line.size()), utf8_.data(), size, nullptr, nullptr);
+        const size_t bytes = static_cast<size_t>(stampLength) + utf8_.size() + 1;
+        if (fileBytes_ > 0 && fileBytes_ + bytes > config_.maxFileBytes)
+            Rotate();
+        file_.write(stamp, stampLength);
+        file_.write(utf8_.data(), static_cast<std::streamsize>(utf8_.size()));
+        file_.put('\n');
+        fileBytes_ += bytes;
+    }
+
+    void OpenFile() {
+        std::error_code error;
+        const std::filesystem::path path(config_.file);
+        if (path.has_parent_path())
+            std::filesystem::create_directories(path.parent_path(), error);
+        file_.open(path, std::ios::binary | std::ios::app);
+        const auto size = std::filesystem::file_size(path, error);
+        fileBytes_ = error ? 0 : static_cast<size_t>(size);
+    }
+
+    // file -> file.1 -> file.2 ... ; the oldest copy is deleted.
+    void Rotate() {
+        file_.close();
+        std::error_code error;
+        const int keep = (std::max)(1, config_.maxFiles);
+        const auto numbered = [&](int n) { return std::filesystem::path(config_.file + L"." + std::to_wstring(n)); };
+        std::filesystem::remove(numbered(keep), error);
+        for (int n = keep - 1; n >= 1; --n)
+            std::filesystem::rename(numbered(n), numbered(n + 1), error);
+        std::filesystem::rename(config_.file, numbered(1), error);
+        file_.open(std::filesystem::path(config_.file), std::ios::binary | std::ios::trunc);
+        fileBytes_ = 0;
+    }
+
+    void ApplyConfig() {
+        std::unique_ptr<LogConfig> config;
+        {
+            std::lock_guard<std::mutex> lock(configMutex_);
+            config = std::move(pending_);
+        }
+        if (!config)
+            return;
+        if (config->file != config_.file && file_.is_open())
+            file_.close();
+        config_ = std::move(*config);
+    }
+
+    std::unique_ptr<Record[]> ring_;
+    alignas(64) std::atomic<size_t> tail_{ 0 };   // next slot producers claim
+    alignas(64) std::atomic<size_t> written_{ 0 }; // records the writer has finished
+    std::atomic<uint64_t> dropped_{ 0 };
+    std::atomic<bool> blockWhenFull_{ false };
+    std::atomic<bool> writerSleeping_{ false };
+    std::atomic<bool> running_{ true };
+
+    std::mutex wakeMutex_;
+    std::condition_variable wake_;
+    std::mutex configMutex_;
+    std::unique_ptr<LogConfig> pending_;
+
+    // Writer thread only.
+    size_t head_ = 0;
+    uint64_t reportedDropped_ = 0;
+    LogConfig config_;
+    std::ofstream file_;
+    size_t fileBytes_ = 0;
+    std::wstring line_;
+    std::string utf8_;
+    std::thread writer_;
+};
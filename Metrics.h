@@ -0,0 +1,259 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "HdrHistogram.h"
+
+// -------------------------
+// Metrics Registry
+// -------------------------
+// Metrics are registered once (under a lock) and then updated with relaxed
+// atomics, so recording never blocks. Callers keep the returned reference.
+// Counters are striped per thread and only summed when scraped.
+// Render() produces the Prometheus text exposition format.
+
+// Escapes a value for use inside a quoted Prometheus label.
+inline std::string LabelValue(std::string_view value) {
+    std::string escaped;
+    escaped.reserve(value.size());
+    for (const char c : value) {
+        if (c == '\\' || c == '"')
+            escaped += '\\';
+        if (c == '\n') {
+            escaped += "\\n";
+            continue;
+        }
+        escaped += c;
+    }
+    return escaped;
+}
+
+// Monotonic count kept in cache-line-sized stripes. Each thread is given a
+// stripe the first time it counts anything, so threads updating the same
+// counter do not share a cache line (past kStripes threads they start to
+// share, and the compare-exchange keeps that correct). Value() sums them.
+class Counter {
+public:
+    static constexpr size_t kStripes = 16;
+
+    void Add(double delta = 1.0) {
+        std::atomic<double>& stripe = stripes_[ThreadStripe()].value;
+        double current = stripe.load(std::memory_order_relaxed);
+        while (!stripe.compare_exchange_weak(current, current + delta, std::memory_order_relaxed)) {}
+    }
+
+    double Value() const {
+        double total = 0.0;
+        for (const Stripe& stripe : stripes_)
+            total += stripe.value.load(std::memory_order_relaxed);
+        return total;
+    }
+
+private:
+    struct alignas(64) Stripe {
+        std::atomic<double> value{ 0.0 };
+    };
+
+    static size_t ThreadStripe() {
+        static std::atomic<size_t> next{ 0 };
+        thread_local const size_t stripe = next.fetch_add(1, std::memory_order_relaxed) % kStripes;
+        return stripe;
+    }
+
+    Stripe stripes_[kStripes];
+};
+
+class Gauge {
+public:
+    void Set(double value) { value_.store(value, std::memory_order_relaxed); }
+    void Add(double delta) {
+        double current = value_.load(std::memory_order_relaxed);
+        while (!value_.compare_exchange_weak(current, current + delta, std::memory_order_relaxed)) {}
+    }
+    double Value() const { return value_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<double> value_{ 0.0 };
+};
+
+// Distribution of a measurement, exported as a Prometheus summary with
+// quantiles computed from an HDR histogram. Values are stored as integer
+// multiples of `unit` (1e-6 records seconds with microsecond resolution).
+class Histogram {
+public:
+    explicit Histogram(double unit = 1e-6) : unit_(unit) {}
+
+    void Record(double value, uint64_t count = 1) {
+        histogram_.Record(static_cast<uint64_t>((std::max)(0.0, value) / unit_ + 0.5), count);
+    }
+    double Quantile(double q) const { return static_cast<double>(histogram_.ValueAtQuantile(q)) * unit_; }
+    double Sum() const { return static_cast<double>(histogram_.Sum()) * unit_; }
+    uint64_t Count() const { return histogram_.TotalCount(); }
+    double Unit() const { return unit_; }
+    const HdrHistogram& Hdr() const { return histogram_; }
+
+private:
+    double unit_;
+    HdrHistogram histogram_;
+};
+
+class MetricsRegistry {
+public:
+    static MetricsRegistry& Instance() {
+        static MetricsRegistry registry;
+        return registry;
+    }
+
+    // Labels are passed preformatted, e.g. R"(upstream="127.0.0.1:11434")".
+    Counter& GetCounter(const std::string& name, const std::string& help, const std::string& labels = "") {
+        return GetMetric<Counter>(counters_, name, help, labels);
+    }
+
+    Gauge& GetGauge(const std::string& name, const std::string& help, const std::string& labels = "") {
+        return GetMetric<Gauge>(gauges_, name, help, labels);
+    }
+
+    Histogram& GetHistogram(const std::string& name, const std::string& help, const std::string& labels = "",
+        double unit = 1e-6)
+    {
+        return GetMetric<Histogram>(histograms_, name, help, labels, unit);
+    }
+
+    std::string Render() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::ostringstream out;
+        RenderFamilies(out, counters_, "counter");
+        RenderFamilies(out, gauges_, "gauge");
+        RenderSummaries(out);
+        return out.str();
+    }
+
+    // Current value of every counter and gauge, keyed by series
+    // (`name{labels}`).
+    std::vector<std::pair<std::string, double>> Scalars() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::vector<std::pair<std::string, double>> values;
+        const auto collect = [&](const auto& families) {
+            for (const auto& [name, family] : families) {
+                for (const auto& [labels, metric] : family.series)
+                    values.emplace_back(SeriesKey(name, labels), metric->Value());
+            }
+        };
+        collect(counters_);
+        collect(gauges_);
+        return values;
+    }
+
+    // Every histogram, keyed by series. Metrics are never removed, so the
+    // pointers stay valid.
+    std::vector<std::pair<std::string, const Histogram*>> Histograms() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::vector<std::pair<std::string, const Histogram*>> histograms;
+        for (const auto& [name, family] : histograms_) {
+            for (const auto& [labels, histogram] : family.series)
+                histograms.emplace_back(SeriesKey(name, labels), histogram.get());
+        }
+        return histograms;
+    }
+
+    static std::string SeriesKey(const std::string& name, const std::string& labels) {
+        return labels.empty() ? name : name + "{" + labels + "}";
+    }
+
+    // Every histogram in full, as a JSON object keyed by series
+    // (`name{labels}`): {"unit": seconds per count, "count", "hdr": base64 of
+    // HdrHistogram::Encode()}. Scrapes can be merged and re-queried offline at
+    // any quantile, which the summary quantiles cannot.
+    std::string RenderHistograms() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::ostringstream out;
+        out << '{';
+        bool first = true;
+        for (const auto& [name, family] : histograms_) {
+            for (const auto& [labels, histogram] : family.series) {
+                out << (first ? "" : ",") << "\n\"";
+                first = false;
+                for (const char c : SeriesKey(name, labels)) {
+                    if (c == '"' || c == '\\')
+                        out << '\\';
+                    out << c;
+                }
+                out << "\":{\"unit\":" << histogram->Unit() << ",\"count\":" << histogram->Count()
+                    << ",\"hdr\":\"" << histogram->Hdr().ToBase64() << "\"}";
+            }
+        }
+        out << "\n}\n";
+        return out.str();
+    }
+
+private:
+    template <typename T>
+    struct Family {
+        std::string help;
+        std::map<std::string, std::unique_ptr<T>> series;
+    };
+
+    template <typename T, typename... Args>
+    T& GetMetric(std::map<std::string, Family<T>>& families, const std::string& name,
+        const std::string& help, const std::string& labels, Args&&... args)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Family<T>& family = families[name];
+        if (family.help.empty())
+            family.help = help;
+        std::unique_ptr<T>& metric = family.series[labels];
+        if (!metric)
+            metric = std::make_unique<T>(std::forward<Args>(args)...);
+        return *metric;
+    }
+
+    template <typename T>
+    static void RenderFamilies(std::ostringstream& out, const std::map<std::string, Family<T>>& families,
+        const char* type)
+    {
+        for (const auto& [name, family] : families) {
+            out << "# HELP " << name << ' ' << family.help << '\n';
+            out << "# TYPE " << name << ' ' << type << '\n';
+            for (const auto& [labels, metric] : family.series) {
+                out << name;
+                if (!labels.empty())
+                    out << '{' << labels << '}';
+                out << ' ' << metric->Value() << '\n';
+            }
+        }
+    }
+
+    void RenderSummaries(std::ostringstream& out) const {
+        static constexpr std::pair<double, const char*> quantiles[] = {
+            { 0.5, "0.5" }, { 0.9, "0.9" }, { 0.99, "0.99" }, { 0.999, "0.999" }
+        };
+        for (const auto& [name, family] : histograms_) {
+            out << "# HELP " << name << ' ' << family.help << '\n';
+            out << "# TYPE " << name << " summary\n";
+            for (const auto& [labels, histogram] : family.series) {
+                const std::string separator = labels.empty() ? "" : ",";
+                for (const auto& [quantile, text] : quantiles) {
+                    out << name << '{' << labels << separator << "quantile=\"" << text << "\"} "
+                        << histogram->Quantile(quantile) << '\n';
+                }
+                const std::string suffix = labels.empty() ? "" : "{" + labels + "}";
+                out << name << "_sum" << suffix << ' ' << histogram->Sum() << '\n';
+                out << name << "_count" << suffix << ' ' << histogram->Count() << '\n';
+            }
+        }
+    }
+
+    mutable std::mutex mutex_;
+    std::map<std::string, Family<Counter>> counters_;
+    std::map<std::string, Family<Gauge>> gauges_;
+    std::map<std::string, Family<Histogram>> histograms_;
+};
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <winsock2.h>
+#include <windows.h>
+#include <string>
+#include <string_view>
+#include "Arena.h"
+#include "Common.h"
+#include "Metrics.h"
+#include "Net.h"
+#include "TcpServer.h"
+#include "TimeSeries.h"
+
+// -------------------------
+// Metrics endpoint configuration
+// -------------------------
+struct MetricsEndpointConfig {
+    bool enabled = true;
+    std::string listenAddress = "127.0.0.1";
+    uint16_t listenPort = 9464;
+};
+
+// -------------------------
+// Metrics endpoint
+// -------------------------
+// Serves GET /metrics from the registry in Prometheus text format, whether or
+// not the Ollama proxy (which also serves it) is enabled, GET /metrics/hdr
+// with the full histograms as JSON, and GET /history for the sampled history
+// of every series. One reactor: a scrape every few seconds needs no more.
+class MetricsServer {
+public:
+    explicit MetricsServer(MetricsEndpointConfig config) : config_(std::move(config)) {}
+    ~MetricsServer() { Stop(); }
+
+    MetricsServer(const MetricsServer&) = delete;
+    MetricsServer& operator=(const MetricsServer&) = delete;
+
+    bool Start() {
+        if (!server_.Start(config_.listenAddress, config_.listenPort,
+            [](Socket& client, const std::string&) { ServeConnection(client); }, 1))
+        {
+            Log(LogLevel::Error, L"Metrics endpoint could not listen on " + UTF8ToWString(config_.listenAddress) +
+                L":" + std::to_wstring(config_.listenPort));
+            return false;
+        }
+        Log(LogLevel::Info, L"Metrics at http://" + UTF8ToWString(config_.listenAddress) + L":" +
+            std::to_wstring(server_.Port()) + L"/metrics");
+        return true;
+    }
+
+    void Stop() { server_.Stop(); }
+
+private:
+    static void ServeConnection(Socket& client) {
+        std::string buffer;
+        Arena arena;
+        for (;;) {
+            arena.Reset();
+            HttpRequest request(arena);
+            if (!ReadHttpRequest(client, buffer, arena, request, 64 * 1024))
+                return;
+            const std::string_view path = request.target.substr(0, request.target.find('?'));
+            bool ok;
+            if (request.method == "GET" && path == "/metrics")
+                ok = SendSimpleResponse(client, 200, "OK", "text/plain; version=0.0.4", MetricsRegistry::Instance().Render());
+            else if (request.method == "GET" && path == "/metrics/hdr")
+                ok = SendSimpleResponse(client, 200, "OK", "application/json", MetricsRegistry::Instance().RenderHistograms());
+            else if (request.method == "GET" && path == "/history")
+                ok = ServeHistory(client, request.target);
+            else
+                ok = SendSimpleResponse(client, 404, "Not Found", "text/plain", "Not found. Try /metrics.\n");
+            if (!ok)
+                return;
+        }
+    }
+
+    // Without `series`, lists the series. With it, returns the points from
+    // the last `since` seconds (default an hour), averaged per `step` seconds
+    // if given.
+    static bool ServeHistory(Socket& client, std::string_view target) {
+        MetricsHistory& history = MetricsHistory::Instance();
+        std::string series;
+        if (!QueryParameter(target, "series", series))
+            return SendSimpleResponse(client, 200, "OK", "application/json", history.List().dump() + "\n");
+        std::string text;
+        uint64_t since = 3600;
+        uint64_t step = 0;
+        if (QueryParameter(target, "since", text) && !ParseUint(text, since))
+            return SendSimpleResponse(client, 400, "Bad Request", "text/plain", "since must be a number of seconds.\n");
+        if (QueryParameter(target, "step", text) && !ParseUint(text, step))
+            return SendSimpleResponse(client, 400, "Bad Request", "text/plain", "step must be a number of seconds.\n");
+        const int64_t now = MetricsHistory::Now();
+        const nlohmann::json result = history.Query(series, now - static_cast<int64_t>(since), now, static_cast<int64_t>(step));
+        if (result.is_null())
+            return SendSimpleResponse(client, 404, "Not Found", "text/plain", "No such series. Try /history.\n");
+        return SendSimpleResponse(client, 200, "OK", "application/json", result.dump() + "\n");
+    }
+
+    MetricsEndpointConfig config_;
+    TcpServer server_;
+};
@@ -0,0 +1,631 @@
+#pragma once
+
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <windows.h>
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "Arena.h"
+#include "Common.h"
+
+#pragma comment(lib, "ws2_32.lib")
+
+// -------------------------
+// Winsock helpers
+// -------------------------
+class Winsock {
+public:
+    // Initializes Winsock once for the lifetime of the process.
+    static bool Init() {
+        static const bool ok = [] {
+            WSADATA data{};
+            const int result = WSAStartup(MAKEWORD(2, 2), &data);
+            if (result != 0)
+                Log(LogLevel::Error, L"WSAStartup failed. Error code: " + std::to_wstring(result));
+            return result == 0;
+        }();
+        return ok;
+    }
+};
+
+class Socket {
+public:
+    Socket() = default;
+    explicit Socket(SOCKET s) : s_(s) {}
+    ~Socket() { Close(); }
+
+    Socket(const Socket&) = delete;
+    Socket& operator=(const Socket&) = delete;
+    Socket(Socket&& other) noexcept : s_(std::exchange(other.s_, INVALID_SOCKET)) {}
+    Socket& operator=(Socket&& other) noexcept {
+        if (this != &other) {
+            Close();
+            s_ = std::exchange(other.s_, INVALID_SOCKET);
+        }
+        return *this;
+    }
+
+    bool Valid() const { return s_ != INVALID_SOCKET; }
+    SOCKET Get() const { return s_; }
+
+    void Close() {
+        if (s_ != INVALID_SOCKET) {
+            closesocket(s_);
+            s_ = INVALID_SOCKET;
+        }
+    }
+
+    // Closes with a RST instead of a FIN so the peer notices immediately.
+    void Abort() {
+        if (s_ != INVALID_SOCKET) {
+            linger lg{ 1, 0 };
+            setsockopt(s_, SOL_SOCKET, SO_LINGER, reinterpret_cast<const char*>(&lg), sizeof(lg));
+            Close();
+        }
+    }
+
+    void SetNoDelay() {
+        BOOL on = TRUE;
+        setsockopt(s_, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&on), sizeof(on));
+    }
+
+    void SetReceiveTimeout(DWORD milliseconds) {
+        setsockopt(s_, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char*>(&milliseconds), sizeof(milliseconds));
+    }
+
+    bool SendAll(const char* data, size_t length) {
+        while (length > 0) {
+            const int chunk = static_cast<int>((std::min)(length, static_cast<size_t>(1 << 30)));
+            const int sent = send(s_, data, chunk, 0);
+            if (sent == SOCKET_ERROR)
+                return false;
+            data += sent;
+            length -= static_cast<size_t>(sent);
+        }
+        return true;
+    }
+
+    bool SendAll(std::string_view data) { return SendAll(data.data(), data.size()); }
+
+    // Sends several buffers, gathered by WSASend into as few segments as
+    // possible instead of one send per piece. Advances `buffers` as it goes.
+    bool SendAll(WSABUF* buffers, DWORD count) {
+        while (count > 0) {
+            DWORD sent = 0;
+            if (WSASend(s_, buffers, count, &sent, 0, nullptr, nullptr) == SOCKET_ERROR)
+                return false;
+            while (count > 0 && sent >= buffers->len) {
+                sent -= buffers->len;
+                ++buffers;
+                --count;
+            }
+            if (count > 0) {
+                buffers->buf += sent;
+                buffers->len -= sent;
+            }
+        }
+        return true;
+    }
+
+    // Returns bytes read, 0 on orderly close, negative on error.
+    int Recv(char* buffer, int length) { return recv(s_, buffer, length, 0); }
+
+private:
+    SOCKET s_ = INVALID_SOCKET;
+};
+
+// Non-blocking check for a peer that has closed, half-closed or reset the
+// connection. Pending request bytes do not count as closed.
+inline bool PeerClosed(Socket& socket) {
+    WSAPOLLFD fd{ socket.Get(), POLLRDNORM, 0 };
+    if (WSAPoll(&fd, 1, 0) <= 0 || fd.revents == 0)
+        return false;
+    if (fd.revents & (POLLHUP | POLLERR | POLLNVAL))
+        return true;
+    char probe;
+    return recv(socket.Get(), &probe, 1, MSG_PEEK) <= 0;
+}
+
+inline std::string PeerAddress(const sockaddr_in& address) {
+    char text[INET_ADDRSTRLEN] = {};
+    inet_ntop(AF_INET, &address.sin_addr, text, sizeof(text));
+    return text;
+}
+
+// Resolves "host:port" (IPv4) into a socket address.
+inline bool ResolveEndpoint(const std::string& hostPort, sockaddr_in& out) {
+    const size_t colon = hostPort.rfind(':');
+    if (colon == std::string::npos)
+        return false;
+    const std::string host = hostPort.substr(0, colon);
+    const std::string port = hostPort.substr(colon + 1);
+
+    addrinfo hints{};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* result = nullptr;
+    if (getaddrinfo(host.c_str(), port.c_str(), &hints, &result) != 0 || !result)
+        return false;
+    out = *reinterpret_cast<const sockaddr_in*>(result->ai_addr);
+    freeaddrinfo(result);
+    return true;
+}
+
+inline Socket ConnectTcp(const sockaddr_in& address) {
+    Socket socket(::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP));
+    if (!socket.Valid())
+        return socket;
+    if (connect(socket.Get(), reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == SOCKET_ERROR) {
+        socket.Close();
+        return socket;
+    }
+    socket.SetNoDelay();
+    return socket;
+}
+
+inline Socket ListenTcp(const std::string& address, uint16_t port) {
+    Socket socket(::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP));
+    if (!socket.Valid())
+        return socket;
+
+    BOOL exclusive = TRUE;
+    setsockopt(socket.Get(), SOL_SOCKET, SO_EXCLUSIVEADDRUSE, reinterpret_cast<const char*>(&exclusive), sizeof(exclusive));
+
+    sockaddr_in bindAddress{};
+    bindAddress.sin_family = AF_INET;
+    bindAddress.sin_port = htons(port);
+    if (inet_pton(AF_INET, address.c_str(), &bindAddress.sin_addr) != 1 ||
+        bind(socket.Get(), reinterpret_cast<const sockaddr*>(&bindAddress), sizeof(bindAddress)) == SOCKET_ERROR ||
+        listen(socket.Get(), SOMAXCONN) == SOCKET_ERROR)
+    {
+        Log(LogLevel::Error, L"Failed to listen on " + UTF8ToWString(address) + L":" + std::to_wstring(port) +
+            L" Error code: " + std::to_wstring(WSAGetLastError()));
+        socket.Close();
+    }
+    return socket;
+}
+
+// -------------------------
+// HTTP/1.1 message parsing
+// -------------------------
+// Parsed messages are views into the connection's Arena and stay valid until
+// it is reset at the end of the request.
+struct HttpHeader {
+    std::string_view name;
+    std::string_view value;
+};
+
+using HttpHeaders = ArenaVector<HttpHeader>;
+
+struct HttpRequest {
+    explicit HttpRequest(Arena& arena) : headers(ArenaAllocator<HttpHeader>(arena)) {}
+
+    std::string_view method;
+    std::string_view target;
+    std::string_view version;
+    HttpHeaders headers;
+    std::string_view body;
+};
+
+struct HttpResponseHead {
+    explicit HttpResponseHead(Arena& arena) : headers(ArenaAllocator<HttpHeader>(arena)) {}
+
+    std::string_view version;
+    int status = 0;
+    std::string_view reason;
+    HttpHeaders headers;
+};
+
+inline bool EqualsIgnoreCase(std::string_view a, std::string_view b) {
+    return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(), [](char x, char y) {
+        return std::tolower(static_cast<unsigned char>(x)) == std::tolower(static_cast<unsigned char>(y));
+    });
+}
+
+inline bool ContainsTokenIgnoreCase(std::string_view list, std::string_view token) {
+    size_t start = 0;
+    while (start <= list.size()) {
+        size_t end = list.find(',', start);
+        if (end == std::string_view::npos)
+            end = list.size();
+        std::string_view item = list.substr(start, end - start);
+        while (!item.empty() && (item.front() == ' ' || item.front() == '\t')) item.remove_prefix(1);
+        while (!item.empty() && (item.back() == ' ' || item.back() == '\t')) item.remove_suffix(1);
+        if (EqualsIgnoreCase(item, token))
+            return true;
+        start = end + 1;
+    }
+    return false;
+}
+
+inline const std::string_view* FindHeader(const HttpHeaders& headers, std::string_view name) {
+    for (const auto& header : headers) {
+        if (EqualsIgnoreCase(header.name, name))
+            return &header.value;
+    }
+    return nullptr;
+}
+
+// Headers that describe a single hop and must not be forwarded verbatim.
+inline bool IsHopByHopHeader(std::string_view name) {
+    static constexpr std::string_view hopByHop[] = {
+        "connection", "keep-alive", "proxy-connection", "proxy-authenticate", "proxy-authorization",
+        "te", "trailer", "transfer-encoding", "upgrade", "content-length", "expect"
+    };
+    for (const auto& candidate : hopByHop) {
+        if (EqualsIgnoreCase(name, candidate))
+            return true;
+    }
+    return false;
+}
+
+// Appends "Name: value\r\n" to a head being built.
+template <typename String>
+void AppendHeader(String& head, std::string_view name, std::string_view value) {
+    head.append(name).append(": ").append(value).append("\r\n");
+}
+
+// Parses a decimal header value such as Content-Length.
+inline bool ParseUint(std::string_view text, uint64_t& value) {
+    if (text.empty() || text.size() > 19)
+        return false;
+    value = 0;
+    for (const char c : text) {
+        if (c < '0' || c > '9')
+            return false;
+        value = value * 10 + static_cast<uint64_t>(c - '0');
+    }
+    return true;
+}
+
+// Finds `name` in a request target's query string and percent-decodes its
+// value ('+' is a space). False if the parameter is absent.
+inline bool QueryParameter(std::string_view target, std::string_view name, std::string& value) {
+    const size_t question = target.find('?');
+    if (question == std::string_view::npos)
+        return false;
+    std::string_view query = target.substr(question + 1);
+    while (!query.empty()) {
+        const size_t amp = query.find('&');
+        const std::string_view pair = query.substr(0, amp);
+        query = amp == std::string_view::npos ? std::string_view() : query.substr(amp + 1);
+        const size_t equals = pair.find('=');
+        if (pair.substr(0, equals) != name)
+            continue;
+        const std::string_view encoded = equals == std::string_view::npos ? std::string_view() : pair.substr(equals + 1);
+        value.clear();
+        for (size_t i = 0; i < encoded.size(); ++i) {
+            const auto hex = [](char c) {
+                return c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 : c >= 'A' && c <= 'F' ? c - 'A' + 10 : -1;
+            };
+            if (encoded[i] == '%' && i + 2 < encoded.size() && hex(encoded[i + 1]) >= 0 && hex(encoded[i + 2]) >= 0) {
+                value.push_back(static_cast<char>(hex(encoded[i + 1]) * 16 + hex(encoded[i + 2])));
+                i += 2;
+            }
+            else {
+                value.push_back(encoded[i] == '+' ? ' ' : encoded[i]);
+            }
+        }
+        return true;
+    }
+    return false;
+}
+
+// Parses CRLF-separated "Name: value" lines into views of `block`. Returns
+// false on malformed input.
+inline bool ParseHeaderLines(std::string_view block, HttpHeaders& headers) {
+    while (!block.empty()) {
+        const size_t lineEnd = block.find("\r\n");
+        const std::string_view line = block.substr(0, lineEnd);
+        block.remove_prefix(lineEnd == std::string_view::npos ? block.size() : lineEnd + 2);
+        if (line.empty())
+            continue;
+        const size_t colon = line.find(':');
+        if (colon == std::string_view::npos || colon == 0)
+            return false;
+        std::string_view value = line.substr(colon + 1);
+        while (!value.empty() && (value.front() == ' ' || value.front() == '\t')) value.remove_prefix(1);
+        while (!value.empty() && (value.back() == ' ' || value.back() == '\t')) value.remove_suffix(1);
+        headers.push_back({ line.substr(0, colon), value });
+    }
+    return true;
+}
+
+// Reads from `source` (anything with Socket's Recv signature) until `buffer`
+// holds a complete header block. Returns the offset just past the blank line,
+// or 0 on close, error or oversized headers.
+template <typename Source, typename Buffer>
+size_t ReadHeaderBlock(Source& source, Buffer& buffer, size_t maxHeaderBytes = 64 * 1024) {
+    size_t searchFrom = 0;
+    for (;;) {
+        const size_t end = buffer.find("\r\n\r\n", searchFrom);
+        if (end != Buffer::npos)
+            return end + 4;
+        if (buffer.size() > maxHeaderBytes)
+            return 0;
+        searchFrom = buffer.size() >= 3 ? buffer.size() - 3 : 0;
+
+        char chunk[16 * 1024];
+        const int received = source.Recv(chunk, sizeof(chunk));
+        if (received <= 0)
+            return 0;
+        buffer.append(chunk, static_cast<size_t>(received));
+    }
+}
+
+// -------------------------
+// Chunked transfer decoding
+// -------------------------
+// Incremental decoder for "Transfer-Encoding: chunked" bodies. Feed() hands
+// payload bytes to the sink as they become available and returns how many
+// input bytes were consumed (input after the terminating chunk is left alone).
+// A chunk size with no digits, or with more than 16 (which would overflow and
+// lose the framing), fails the decoder: Failed() turns true and nothing more
+// is consumed.
+class ChunkedDecoder {
+public:
+    template <typename Sink>
+    size_t Feed(const char* data, size_t length, Sink&& sink) {
+        size_t i = 0;
+        while (i < length && state_ != State::Done && state_ != State::Failed) {
+            const char c = data[i];
+            switch (state_) {
+            case State::Size:
+                if (std::isxdigit(static_cast<unsigned char>(c))) {
+                    if (++sizeDigits_ > kMaxSizeDigits) {
+                        state_ = State::Failed;
+                        break;
+                    }
+                    remaining_ = remaining_ * 16 + static_cast<uint64_t>(HexValue(c));
+                    ++i;
+                }
+                else {
+                    state_ = sizeDigits_ == 0 ? State::Failed : State::SizeLine;
+                    sizeDigits_ = 0;
+                }
+                break;
+            case State::SizeLine:
+                ++i;
+                if (c == '\n')
+                    state_ = remaining_ == 0 ? State::Trailer : State::Data;
+                break;
+            case State::Data: {
+                const size_t take = static_cast<size_t>((std::min)(remaining_, static_cast<uint64_t>(length - i)));
+                sink(data + i, take);
+                i += take;
+                remaining_ -= take;
+                if (remaining_ == 0)
+                    state_ = State::DataEnd;
+                break;
+            }
+            case State::DataEnd:
+                ++i;
+                if (c == '\n')
+                    state_ = State::Size;
+                break;
+            case State::Trailer:
+                ++i;
+                if (c == '\n') {
+                    if (trailerLineLength_ == 0)
+                        state_ = State::Done;
+                    trailerLineLength_ = 0;
+                }
+                else if (c != '\r') {
+                    ++trailerLineLength_;
+                }
+                break;
+            case State::Done:
+            case State::Failed:
+                break;
+            }
+        }
+        return i;
+    }
+
+    bool Done() const { return state_ == State::Done; }
+    bool Failed() const { return state_ == State::Failed; }
+    // Payload bytes the current chunk has declared but not yet delivered.
+    uint64_t ChunkRemaining() const { return state_ == State::Data ? remaining_ : 0; }
+
+private:
+    enum class State { Size, SizeLine, Data, DataEnd, Trailer, Done, Failed };
+
+    static constexpr size_t kMaxSizeDigits = 16;
+
+    static int HexValue(char c) {
+        if (c >= '0' && c <= '9') return c - '0';
+        return (std::tolower(static_cast<unsigned char>(c)) - 'a') + 10;
+    }
+
+    State state_ = State::Size;
+    uint64_t remaining_ = 0;
+    size_t sizeDigits_ = 0;
+    size_t trailerLineLength_ = 0;
+};
+
+// Frames `length` bytes as a single HTTP chunk, sent with one gathered write.
+inline bool SendChunk(Socket& socket, const char* data, size_t length) {
+    if (length == 0)
+        return true;
+    char sizeLine[32];
+    const int sizeLength = snprintf(sizeLine, sizeof(sizeLine), "%zx\r\n", length);
+    char crlf[] = "\r\n";
+    WSABUF pieces[3] = {
+        { static_cast<ULONG>(sizeLength), sizeLine },
+        { static_cast<ULONG>(length), const_cast<char*>(data) },
+        { 2, crlf }
+    };
+    return socket.SendAll(pieces, 3);
+}
+
+inline bool SendLastChunk(Socket& socket) { return socket.SendAll("0\r\n\r\n", 5); }
+
+// -------------------------
+// Request reading
+// -------------------------
+// Request bodies larger than this are refused unless the caller sets its own
+// limit: a body is held in memory whole.
+constexpr uint64_t kDefaultMaxBodyBytes = 64ull * 1024 * 1024;
+
+// Answers a body over the limit. The rest of it is never read, so the
+// connection closes.
+inline void RejectOversizedBody(Socket& socket) {
+    socket.SendAll("HTTP/1.1 413 Payload Too Large\r\nContent-Type: text/plain\r\nContent-Length: 23\r\n"
+        "Connection: close\r\n\r\nRequest body too large\n");
+}
+
+// Answers a body whose framing cannot be decoded. The connection closes, as
+// where the next request would start is unknown.
+inline void RejectMalformedBody(Socket& socket) {
+    socket.SendAll("HTTP/1.1 400 Bad Request\r\nContent-Type: text/plain\r\nContent-Length: 23\r\n"
+        "Connection: close\r\n\r\nMalformed request body\n");
+}
+
+// Reads one request (head and body) from a client connection into `arena`.
+// `buffer` carries bytes already received and keeps any pipelined bytes that
+// follow the request. A body over `maxBodyBytes` is answered with 413 and
+// the read fails, before any of the body is buffered for a Content-Length
+// body, and as soon as the decoded size passes the limit for a chunked one.
+// A chunked body with broken framing is answered with 400.
+inline bool ReadHttpRequest(Socket& socket, std::string& buffer, Arena& arena, HttpRequest& request,
+    uint64_t maxBodyBytes = kDefaultMaxBodyBytes)
+{
+    const size_t headEnd = ReadHeaderBlock(socket, buffer);
+    if (headEnd == 0)
+        return false;
+
+    const std::string_view head = arena.Copy(std::string_view(buffer.data(), headEnd - 4));
+    buffer.erase(0, headEnd);
+    const size_t lineEnd = head.find("\r\n");
+    const std::string_view requestLine = head.substr(0, lineEnd);
+    const size_t firstSpace = requestLine.find(' ');
+    const size_t secondSpace = requestLine.find(' ', firstSpace + 1);
+    if (firstSpace == std::string_view::npos || secondSpace == std::string_view::npos)
+        return false;
+
+    request.method = requestLine.substr(0, firstSpace);
+    request.target = requestLine.substr(firstSpace + 1, secondSpace - firstSpace - 1);
+    request.version = requestLine.substr(secondSpace + 1);
+    request.headers.reserve(16);
+    if (lineEnd != std::string_view::npos && !ParseHeaderLines(head.substr(lineEnd + 2), request.headers))
+        return false;
+
+    const std::string_view* transferEncoding = FindHeader(request.headers, "Transfer-Encoding");
+    const bool chunked = transferEncoding && ContainsTokenIgnoreCase(*transferEncoding, "chunked");
+    const std::string_view* contentLength = FindHeader(request.headers, "Content-Length");
+    uint64_t bodyLength = 0;
+    if (!chunked && contentLength && !ParseUint(*contentLength, bodyLength))
+        return false;
+    if (bodyLength > maxBodyBytes) {
+        RejectOversizedBody(socket);
+        return false;
+    }
+
+    const std::string_view* expect = FindHeader(request.headers, "Expect");
+    if (expect && EqualsIgnoreCase(*expect, "100-continue"))
+        socket.SendAll("HTTP/1.1 100 Continue\r\n\r\n");
+
+    if (chunked) {
+        ArenaString body{ ArenaAllocator<char>(arena) };
+        ChunkedDecoder decoder;
+        for (;;) {
+            bool tooLarge = false;
+            const size_t consumed = decoder.Feed(buffer.data(), buffer.size(), [&](const char* data, size_t length) {
+                if (body.size() + length > maxBodyBytes)
+                    tooLarge = true;
+                else
+                    body.append(data, length);
+            });
+            // A chunk that declares more than the limit allows is refused
+            // before its bytes arrive.
+            if (decoder.ChunkRemaining() > maxBodyBytes - body.size())
+                tooLarge = true;
+            if (tooLarge) {
+                RejectOversizedBody(socket);
+                return false;
+            }
+            if (decoder.Failed()) {
+                RejectMalformedBody(socket);
+                return false;
+            }
+            buffer.erase(0, consumed);
+            if (decoder.Done()) {
+                request.body = arena.Copy(body);
+                return true;
+            }
+            char chunk[16 * 1024];
+            const int received = socket.Recv(chunk, sizeof(chunk));
+            if (received <= 0)
+                return false;
+            buffer.append(chunk, static_cast<size_t>(received));
+        }
+    }
+
+    // The body is read straight into the arena rather than through `buffer`.
+    if (bodyLength == 0)
+        return true;
+    char* body = static_cast<char*>(arena.Allocate(static_cast<size_t>(bodyLength), 1));
+    size_t have = (std::min)(buffer.size(), static_cast<size_t>(bodyLength));
+    std::memcpy(body, buffer.data(), have);
+    buffer.erase(0, have);
+    while (have < bodyLength) {
+        const int want = static_cast<int>((std::min)(static_cast<uint64_t>(bodyLength - have), uint64_t{ 1 } << 30));
+        const int received = socket.Recv(body + have, want);
+        if (received <= 0)
+            return false;
+        have += static_cast<size_t>(received);
+    }
+    request.body = std::string_view(body, static_cast<size_t>(bodyLength));
+    return true;
+}
+
+// Parses the status line and headers of an upstream response, copying them
+// into `arena` first.
+inline bool ParseResponseHead(std::string_view head, Arena& arena, HttpResponseHead& response) {
+    head = arena.Copy(head);
+    const size_t lineEnd = head.find("\r\n");
+    const std::string_view statusLine = head.substr(0, lineEnd);
+    const size_t firstSpace = statusLine.find(' ');
+    uint64_t status = 0;
+    if (firstSpace == std::string_view::npos || statusLine.size() < firstSpace + 4 ||
+        !ParseUint(statusLine.substr(firstSpace + 1, 3), status))
+        return false;
+    response.version = statusLine.substr(0, firstSpace);
+    response.status = static_cast<int>(status);
+    const size_t secondSpace = statusLine.find(' ', firstSpace + 1);
+    if (secondSpace != std::string_view::npos)
+        response.reason = statusLine.substr(secondSpace + 1);
+    response.headers.reserve(16);
+    return lineEnd == std::string_view::npos || ParseHeaderLines(head.substr(lineEnd + 2), response.headers);
+}
+
+// Whether the server is willing to take another request on the connection
+// after this response.
+inline bool ResponseKeepsConnection(const HttpResponseHead& response) {
+    const std::string_view* connection = FindHeader(response.headers, "Connection");
+    return response.version == "HTTP/1.1" ?
+        !(connection && ContainsTokenIgnoreCase(*connection, "close")) :
+        (connection && ContainsTokenIgnoreCase(*connection, "keep-alive"));
+}
+
+inline bool SendSimpleResponse(Socket& socket, int status, std::string_view reason,
+    std::string_view contentType, std::string_view body)
+{
+    char head[256];
+    const int headLength = snprintf(head, sizeof(head), "HTTP/1.1 %d %.*s\r\nContent-Type: %.*s\r\nContent-Length: %zu\r\n\r\n",
+        status, static_cast<int>(reason.size()), reason.data(), static_cast<int>(contentType.size()), contentType.data(),
+        body.size());
+    if (headLength <= 0 || headLength >= static_cast<int>(sizeof(head)))
+        return false;
+    WSABUF pieces[2] = {
+        { static_cast<ULONG>(headLength), head },
+        { static_cast<ULONG>(body.size()), const_cast<char*>(body.data()) }
+    };
+    return socket.SendAll(pieces, body.empty() ? 1 : 2);
+}
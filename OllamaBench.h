@@ -0,0 +1,378 @@
+#pragma once
+
+#include <winsock2.h>
+#include <windows.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "Arena.h"
+#include "HdrHistogram.h"
+#include "JsonScan.h"
+#include "Net.h"
+
+// -------------------------
+// Ollama load generator
+// -------------------------
+// Drives /api/generate, /api/chat or /api/embed with streamed requests and
+// measures, per request, time to first token, end-to-end latency and decode
+// speed.
+//
+// Open loop sends at a constant arrival rate whether or not earlier requests
+// have finished, and times each request from when it was scheduled, so time
+// spent waiting for a free connection counts (the coordinated omission a
+// closed loop hides). Closed loop keeps `concurrency` requests in flight;
+// its percentiles are corrected afterwards by back-filling the requests that
+// would have been issued during each slow one, at the median service time.
+struct LoadOptions {
+    std::string target = "127.0.0.1:11434";
+    std::string endpoint = "chat";      // generate | chat | embed
+    std::vector<std::string> models = { "llama3.2" }; // cycled per request
+    bool openLoop = true;
+    double rate = 1.0;                  // requests/s (open loop)
+    int concurrency = 4;                // connections; the in-flight limit
+    double seconds = 30.0;
+    int numPredict = 128;
+    int numThread = 0;                  // options.num_thread; 0 leaves Ollama's choice
+    uint64_t maxRequests = 0;           // stop after this many; 0 runs for `seconds`
+    std::vector<std::string> prompts;   // cycled; empty uses a built-in set
+};
+
+struct LoadReport {
+    LoadOptions options;
+    double wallSeconds = 0.0;
+    uint64_t completed = 0;
+    uint64_t failed = 0;
+    uint64_t outputTokens = 0;
+    std::vector<double> endToEndMs;     // corrected (open loop: from the scheduled start)
+    std::vector<double> serviceMs;      // from the moment the request was sent
+    std::vector<double> timeToFirstTokenMs;
+    std::vector<double> tokensPerSecond; // per request, first to last token
+
+    double RequestsPerSecond() const { return wallSeconds > 0.0 ? static_cast<double>(completed) / wallSeconds : 0.0; }
+    double OutputTokensPerSecond() const { return wallSeconds > 0.0 ? static_cast<double>(outputTokens) / wallSeconds : 0.0; }
+    double EndToEndQuantileMs(double q) const { return Quantile(endToEndMs, q); }
+
+    static double Quantile(std::vector<double> values, double q) {
+        if (values.empty())
+            return 0.0;
+        const size_t rank = (std::min)(values.size() - 1, static_cast<size_t>(q * static_cast<double>(values.size())));
+        std::nth_element(values.begin(), values.begin() + rank, values.end());
+        return values[rank];
+    }
+
+    nlohmann::json ToJson() const {
+        using nlohmann::json;
+        const auto summary = [](const std::vector<double>& values) {
+            // Microsecond HDR buckets: stays within 1.6% however many samples.
+            HdrHistogram histogram;
+            double sum = 0.0;
+            double max = 0.0;
+            for (const double value : values) {
+                histogram.Record(static_cast<uint64_t>(value * 1000.0 + 0.5));
+                sum += value;
+                max = (std::max)(max, value);
+            }
+            json out = json::object();
+            out["count"] = values.size();
+            out["mean"] = values.empty() ? 0.0 : sum / static_cast<double>(values.size());
+            for (const auto& [name, q] : { std::pair<const char*, double>{ "p50", 0.5 }, { "p90", 0.9 }, { "p95", 0.95 },
+                { "p99", 0.99 }, { "p999", 0.999 } })
+                out[name] = (std::min)(max, static_cast<double>(histogram.ValueAtQuantile(q)) / 1000.0);
+            out["max"] = max;
+            out["hdr"] = histogram.ToBase64(); // microseconds; HdrHistogram::FromBase64 reads it back
+            return out;
+        };
+        json report;
+        report["target"] = options.target;
+        report["endpoint"] = "/api/" + options.endpoint;
+        report["models"] = options.models;
+        report["mode"] = options.openLoop ? "open" : "closed";
+        if (options.openLoop)
+            report["rate"] = options.rate;
+        report["concurrency"] = options.concurrency;
+        report["seconds"] = wallSeconds;
+        report["requests"] = { { "completed", completed }, { "failed", failed }, { "perSecond", RequestsPerSecond() } };
+        report["outputTokens"] = { { "total", outputTokens }, { "perSecond", OutputTokensPerSecond() } };
+        report["latencyMs"] = {
+            { "endToEnd", summary(endToEndMs) },
+            { "service", summary(serviceMs) },
+            { "timeToFirstToken", summary(timeToFirstTokenMs) }
+        };
+        // Per-request decode speed: the slow tail is the low quantiles.
+        json speed = json::object();
+        speed["count"] = tokensPerSecond.size();
+        speed["p50"] = Quantile(tokensPerSecond, 0.5);
+        speed["p10"] = Quantile(tokensPerSecond, 0.1);
+        speed["p1"] = Quantile(tokensPerSecond, 0.01);
+        report["tokensPerSecondPerRequest"] = speed;
+        report["coordinatedOmission"] = options.openLoop ?
+            "latency measured from each request's scheduled start" :
+            "closed loop; endToEnd back-filled at the median service time";
+        if (options.openLoop && RequestsPerSecond() < 0.9 * options.rate)
+            report["saturated"] = true;
+        return report;
+    }
+};
+
+// Whether an Ollama server answers GET /api/version at `target`.
+inline bool OllamaResponds(const std::string& target) {
+    sockaddr_in address{};
+    if (!Winsock::Init() || !ResolveEndpoint(target, address))
+        return false;
+    Socket connection = ConnectTcp(address);
+    const std::string request = "GET /api/version HTTP/1.1\r\nHost: " + target + "\r\nConnection: close\r\n\r\n";
+    if (!connection.Valid() || !connection.SendAll(request))
+        return false;
+    std::string buffer;
+    Arena arena;
+    HttpResponseHead response(arena);
+    const size_t headEnd = ReadHeaderBlock(connection, buffer);
+    return headEnd != 0 && ParseResponseHead(std::string_view(buffer.data(), headEnd - 4), arena, response) &&
+        response.status == 200;
+}
+
+class OllamaLoadGenerator {
+public:
+    explicit OllamaLoadGenerator(LoadOptions options) : options_(std::move(options)) {
+        if (options_.prompts.empty()) {
+            options_.prompts = {
+                "Why is the sky blue?",
+                "Write a haiku about a lighthouse.",
+                "Summarize the plot of Hamlet in three sentences.",
+                "Explain the difference between TCP and UDP to a new programmer, with an example of when to use each.",
+                "List five tips for writing maintainable C++ code and explain each one briefly.",
+                "Translate 'The quick brown fox jumps over the lazy dog' into French, German and Spanish."
+            };
+        }
+        if (options_.models.empty())
+            options_.models = { "llama3.2" };
+        options_.concurrency = (std::max)(1, options_.concurrency);
+    }
+
+    // Runs the load and returns the measurements. Returns a report with no
+    // completed requests if the target cannot be resolved.
+    LoadReport Run() {
+        LoadReport report;
+        report.options = options_;
+        if (!Winsock::Init() || !ResolveEndpoint(options_.target, address_))
+            return report;
+
+        const auto start = Clock::now();
+        const auto end = start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(options_.seconds));
+        std::atomic<uint64_t> next{ 0 };
+        std::vector<std::thread> workers;
+        for (int w = 0; w < options_.concurrency; ++w) {
+            workers.emplace_back([&] {
+                Socket connection;
+                Arena arena;
+                for (;;) {
+                    const uint64_t index = next.fetch_add(1);
+                    if (options_.maxRequests != 0 && index >= options_.maxRequests)
+                        return;
+                    Clock::time_point scheduled;
+                    if (options_.openLoop) {
+                        scheduled = start + std::chrono::duration_cast<Clock::duration>(
+                            std::chrono::duration<double>(static_cast<double>(index) / options_.rate));
+                        if (scheduled >= end)
+                            return;
+                        std::this_thread::sleep_until(scheduled);
+                    }
+                    else {
+                        scheduled = Clock::now();
+                        if (scheduled >= end)
+                            return;
+                    }
+                    arena.Reset();
+                    Record(report, Issue(connection, arena, BuildBody(index), scheduled));
+                }
+            });
+        }
+        for (auto& worker : workers)
+            worker.join();
+        report.wallSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+        if (!options_.openLoop)
+            BackFill(report);
+        return report;
+    }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Sample {
+        bool ok = false;
+        double endToEndMs = 0.0;
+        double serviceMs = 0.0;
+        double timeToFirstTokenMs = 0.0;
+        uint64_t tokens = 0;
+        double decodeSeconds = 0.0;
+    };
+
+    static double Milliseconds(Clock::duration duration) {
+        return std::chrono::duration<double, std::milli>(duration).count();
+    }
+
+    // The body of request number `index`: prompts and models are cycled
+    // independently so every pairing comes up.
+    std::string BuildBody(uint64_t index) const {
+        const std::string& prompt = options_.prompts[index % options_.prompts.size()];
+        nlohmann::json body;
+        body["model"] = options_.models[index % options_.models.size()];
+        if (options_.endpoint == "embed") {
+            body["input"] = prompt;
+        }
+        else {
+            if (options_.endpoint == "chat")
+                body["messages"] = nlohmann::json::array({ { { "role", "user" }, { "content", prompt } } });
+            else
+                body["prompt"] = prompt;
+            body["stream"] = true;
+            body["options"] = { { "num_predict", options_.numPredict } };
+            if (options_.numThread > 0)
+                body["options"]["num_thread"] = options_.numThread;
+        }
+        return body.dump();
+    }
+
+    // Sends one request on `connection` (reconnecting if needed) and reads
+    // the whole response.
+    Sample Issue(Socket& connection, Arena& arena, const std::string& body, Clock::time_point scheduled) {
+        Sample sample;
+        const std::string head = "POST /api/" + options_.endpoint + " HTTP/1.1\r\nHost: " + options_.target +
+            "\r\nContent-Type: application/json\r\nContent-Length: " + std::to_string(body.size()) + "\r\n\r\n";
+        WSABUF pieces[2] = {
+            { static_cast<ULONG>(head.size()), const_cast<char*>(head.data()) },
+            { static_cast<ULONG>(body.size()), const_cast<char*>(body.data()) }
+        };
+        const auto sent = Clock::now();
+        if (!connection.Valid() || !connection.SendAll(pieces, 2)) {
+            connection = ConnectTcp(address_);
+            pieces[0] = { static_cast<ULONG>(head.size()), const_cast<char*>(head.data()) };
+            pieces[1] = { static_cast<ULONG>(body.size()), const_cast<char*>(body.data()) };
+            if (!connection.Valid() || !connection.SendAll(pieces, 2)) {
+                connection.Close();
+                return sample;
+            }
+        }
+
+        std::string buffer;
+        const size_t headEnd = ReadHeaderBlock(connection, buffer);
+        HttpResponseHead response(arena);
+        if (headEnd == 0 || !ParseResponseHead(std::string_view(buffer.data(), headEnd - 4), arena, response) ||
+            response.status != 200)
+        {
+            connection.Close();
+            return sample;
+        }
+        buffer.erase(0, headEnd);
+        const std::string_view* transferEncoding = FindHeader(response.headers, "Transfer-Encoding");
+        const std::string_view* contentLengthHeader = FindHeader(response.headers, "Content-Length");
+        const bool chunked = transferEncoding && ContainsTokenIgnoreCase(*transferEncoding, "chunked");
+        uint64_t remaining = 0;
+        if (!chunked && (!contentLengthHeader || !ParseUint(*contentLengthHeader, remaining))) {
+            connection.Close();
+            return sample;
+        }
+
+        Clock::time_point firstToken{};
+        Clock::time_point lastToken{};
+        int64_t evalCount = -1;
+        JsonScan::NdjsonSplitter splitter;
+        ChunkedDecoder decoder;
+        const auto onLine = [&](std::string_view line) {
+            const auto now = Clock::now();
+            if (firstToken == Clock::time_point{})
+                firstToken = now;
+            if (JsonScan::IsTrue(JsonScan::FindField(line, "done"))) {
+                JsonScan::ToInt(JsonScan::FindField(line, "eval_count"), evalCount);
+                return;
+            }
+            lastToken = now;
+            ++sample.tokens;
+        };
+        const auto onPayload = [&](const char* data, size_t length) {
+            if (firstToken == Clock::time_point{} && length > 0 && options_.endpoint == "embed")
+                firstToken = Clock::now();
+            splitter.Feed(data, length, onLine);
+        };
+
+        bool done = false;
+        auto consume = [&](const char* data, size_t length) {
+            if (chunked) {
+                decoder.Feed(data, length, onPayload);
+                done = decoder.Done();
+            }
+            else {
+                const size_t take = static_cast<size_t>((std::min)(remaining, static_cast<uint64_t>(length)));
+                onPayload(data, take);
+                remaining -= take;
+                done = remaining == 0;
+            }
+        };
+        if (!buffer.empty() || (!chunked && remaining == 0))
+            consume(buffer.data(), buffer.size());
+        char chunk[16 * 1024];
+        while (!done) {
+            const int received = connection.Recv(chunk, sizeof(chunk));
+            if (received <= 0) {
+                connection.Close();
+                return sample;
+            }
+            consume(chunk, static_cast<size_t>(received));
+        }
+        if (!ResponseKeepsConnection(response))
+            connection.Close();
+
+        const auto finished = Clock::now();
+        sample.ok = true;
+        sample.endToEndMs = Milliseconds(finished - scheduled);
+        sample.serviceMs = Milliseconds(finished - sent);
+        sample.timeToFirstTokenMs = Milliseconds((firstToken == Clock::time_point{} ? finished : firstToken) - scheduled);
+        if (evalCount >= 0 && options_.endpoint != "embed")
+            sample.tokens = static_cast<uint64_t>(evalCount);
+        if (sample.tokens > 1 && lastToken > firstToken)
+            sample.decodeSeconds = std::chrono::duration<double>(lastToken - firstToken).count();
+        return sample;
+    }
+
+    void Record(LoadReport& report, const Sample& sample) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!sample.ok) {
+            ++report.failed;
+            return;
+        }
+        ++report.completed;
+        report.outputTokens += sample.tokens;
+        report.endToEndMs.push_back(sample.endToEndMs);
+        report.serviceMs.push_back(sample.serviceMs);
+        report.timeToFirstTokenMs.push_back(sample.timeToFirstTokenMs);
+        if (sample.decodeSeconds > 0.0)
+            report.tokensPerSecond.push_back(static_cast<double>(sample.tokens - 1) / sample.decodeSeconds);
+    }
+
+    // A closed-loop client issues nothing while a request is slow, so the
+    // requests a steady client would have sent in that time are missing.
+    // Back-fill them as HdrHistogram's recordValueWithExpectedInterval does:
+    // for a sample of v with expected interval i, also count v - i, v - 2i,
+    // ... down to i.
+    static void BackFill(LoadReport& report) {
+        const double interval = LoadReport::Quantile(report.serviceMs, 0.5);
+        if (interval <= 0.0)
+            return;
+        const size_t measured = report.endToEndMs.size();
+        for (size_t k = 0; k < measured; ++k) {
+            for (double missing = report.endToEndMs[k] - interval; missing >= interval; missing -= interval)
+                report.endToEndMs.push_back(missing);
+        }
+    }
+
+    LoadOptions options_;
+    sockaddr_in address_{};
+    std::mutex mutex_;
+};
@@ -0,0 +1,1027 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "AdmissionScheduler.h"
+#include "Common.h"
+#include "JsonScan.h"
+#include "Metrics.h"
+#include "Net.h"
+#include "PrefixRouter.h"
+#include "Relay.h"
+#include "TcpServer.h"
+#include "UpstreamPool.h"
+
+// -------------------------
+// Proxy configuration
+// -------------------------
+struct HedgeConfig {
+    bool enabled = false;
+    double quantile = 0.95;   // hedge once the wait exceeds this TTFT quantile
+    int minDelayMs = 250;     // never hedge sooner than this
+    size_t minSamples = 20;   // TTFT samples needed before a model is hedged
+};
+
+struct CoalesceConfig {
+    int delayMs = 0;           // longest a streamed write is held back; 0 = off
+    size_t maxBytes = 16384;   // send as soon as this much is held
+};
+
+struct ProxyConfig {
+    bool enabled = false;
+    std::string listenAddress = "127.0.0.1";
+    uint16_t listenPort = 11435;
+    std::vector<std::string> upstreams = { "127.0.0.1:11434" };
+    double loadFactor = 1.25;
+    size_t affinityPrefixBytes = 64 * 1024;
+    size_t affinityTableSize = 65536;
+    int reactors = 0; // accept loops; 0 = one per logical processor
+    uint64_t maxBodyBytes = kDefaultMaxBodyBytes; // larger requests get 413
+    std::string userHeader = "X-OpenWebUI-User-Id"; // sent by Open WebUI with ENABLE_FORWARD_USER_INFO_HEADERS
+    SchedulerConfig scheduler;
+    HedgeConfig hedging;
+    CoalesceConfig coalescing;
+    PoolConfig pool;
+};
+
+// -------------------------
+// Ollama Proxy
+// -------------------------
+// HTTP/1.1 reverse proxy that sits between Open WebUI and one or more Ollama
+// instances. Connections are spread over per-core reactors (see TcpServer);
+// requests are routed with prefix affinity so conversations keep hitting a
+// warm KV cache.
+class OllamaProxy {
+public:
+    explicit OllamaProxy(ProxyConfig config) : config_(std::move(config)) {}
+    ~OllamaProxy() { Stop(); }
+
+    OllamaProxy(const OllamaProxy&) = delete;
+    OllamaProxy& operator=(const OllamaProxy&) = delete;
+
+    bool Start() {
+        if (!Winsock::Init())
+            return false;
+        if (config_.upstreams.empty()) {
+            Log(LogLevel::Error, L"Ollama proxy has no upstreams configured.");
+            return false;
+        }
+
+        MetricsRegistry& metrics = MetricsRegistry::Instance();
+        for (const auto& endpoint : config_.upstreams) {
+            auto upstream = std::make_unique<Upstream>();
+            upstream->label = endpoint;
+            if (!ResolveEndpoint(endpoint, upstream->address)) {
+                Log(LogLevel::Error, L"Cannot resolve Ollama upstream: " + UTF8ToWString(endpoint));
+                return false;
+            }
+            const std::string labels = "upstream=\"" + endpoint + "\"";
+            upstream->requests = &metrics.GetCounter("owui_proxy_upstream_requests_total",
+                "Requests forwarded to each Ollama instance.", labels);
+            upstream->errors = &metrics.GetCounter("owui_proxy_upstream_errors_total",
+                "Requests that failed to reach or read from an Ollama instance.", labels);
+            upstream->pool = std::make_unique<UpstreamPool>(upstream->address, endpoint, config_.pool);
+            upstreams_.push_back(std::move(upstream));
+        }
+        std::vector<std::string> labels;
+        for (const auto& upstream : upstreams_)
+            labels.push_back(upstream->label);
+        router_ = std::make_unique<PrefixRouter>(labels, config_.loadFactor, config_.affinityTableSize);
+        if (config_.scheduler.enabled)
+            scheduler_ = std::make_unique<AdmissionScheduler>(config_.scheduler);
+
+        const char* affinityHelp = "Prompt-bearing requests by prefix-affinity outcome.";
+        affinityHits_ = &metrics.GetCounter("owui_proxy_affinity_requests_total", affinityHelp, "result=\"hit\"");
+        affinityMisses_ = &metrics.GetCounter("owui_proxy_affinity_requests_total", affinityHelp, "result=\"miss\"");
+        affinityDiverted_ = &metrics.GetCounter("owui_proxy_affinity_requests_total", affinityHelp, "result=\"diverted\"");
+        promptEvalSaved_ = &metrics.GetCounter("owui_proxy_affinity_prompt_eval_saved_seconds_total",
+            "Estimated prompt evaluation time saved by routing to an instance holding the prefix.");
+        const char* writesHelp = "Client writes per streamed response: as received from Ollama, and as sent after coalescing.";
+        streamWritesReceived_ = &metrics.GetHistogram("owui_proxy_stream_writes_per_response", writesHelp,
+            "kind=\"uncoalesced\"", 1.0);
+        streamWritesSent_ = &metrics.GetHistogram("owui_proxy_stream_writes_per_response", writesHelp,
+            "kind=\"sent\"", 1.0);
+
+        running_ = true;
+        if (!server_.Start(config_.listenAddress, config_.listenPort,
+            [this](Socket& client, const std::string& peer) { ServeConnection(client, peer); }, config_.reactors))
+        {
+            running_ = false;
+            return false;
+        }
+        Log(LogLevel::Info, L"Ollama proxy listening on " + UTF8ToWString(config_.listenAddress) + L":" +
+            std::to_wstring(config_.listenPort) + L" for " + std::to_wstring(upstreams_.size()) + L" instance(s), " +
+            std::to_wstring(server_.ReactorCount()) + L" reactor(s).");
+        return true;
+    }
+
+    void Stop() {
+        if (!running_.exchange(false))
+            return;
+        server_.Stop();
+        for (const auto& upstream : upstreams_)
+            upstream->pool->Clear();
+        Log(LogLevel::Info, L"Ollama proxy stopped.");
+    }
+
+private:
+    static constexpr DWORD kClientIdleTimeoutMs = 120000;
+    static constexpr DWORD kUpstreamTimeoutMs = 600000;
+    static constexpr size_t kBytesPerToken = 4; // rough average for English text
+    static constexpr double kDefaultCompletionTokens = 256.0;
+    static constexpr size_t kMaxModelSeries = 32;
+    static constexpr const char* kOtherModel = "other";
+    static constexpr size_t kMaxUserSeries = 64;
+    static constexpr const char* kOtherUser = "other";
+
+    // Sliding window of the most recent latency samples; small enough that
+    // quantiles are computed by sorting a copy.
+    class RecentLatencies {
+    public:
+        void Add(double seconds) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (samples_.size() < kSize)
+                samples_.push_back(seconds);
+            else
+                samples_[next_] = seconds;
+            next_ = (next_ + 1) % kSize;
+        }
+
+        // Returns 0 until at least `minSamples` samples have been seen.
+        double Quantile(double q, size_t minSamples = 1) const {
+            std::vector<double> sorted;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (samples_.empty() || samples_.size() < minSamples)
+                    return 0.0;
+                sorted = samples_;
+            }
+            const size_t rank = (std::min)(sorted.size() - 1, static_cast<size_t>(q * static_cast<double>(sorted.size())));
+            std::nth_element(sorted.begin(), sorted.begin() + rank, sorted.end());
+            return sorted[rank];
+        }
+
+    private:
+        static constexpr size_t kSize = 512;
+        mutable std::mutex mutex_;
+        std::vector<double> samples_;
+        size_t next_ = 0;
+    };
+
+    struct Upstream {
+        std::string label;
+        sockaddr_in address{};
+        std::atomic<int> inFlight{ 0 };
+        // EWMA of prompt evaluation seconds per token, learned from cold requests.
+        std::atomic<double> promptEvalSecondsPerToken{ 0.0 };
+        Counter* requests = nullptr;
+        Counter* errors = nullptr;
+        std::unique_ptr<UpstreamPool> pool; // idle keep-alive connections
+    };
+
+    // Counts a request against an instance's in-flight load while alive.
+    class InFlight {
+    public:
+        explicit InFlight(Upstream& upstream) : count_(&upstream.inFlight) {
+            count_->fetch_add(1, std::memory_order_relaxed);
+        }
+        ~InFlight() { Release(); }
+        InFlight(const InFlight&) = delete;
+        InFlight& operator=(const InFlight&) = delete;
+
+        void Release() {
+            if (count_)
+                count_->fetch_sub(1, std::memory_order_relaxed);
+            count_ = nullptr;
+        }
+        void Swap(InFlight& other) { std::swap(count_, other.count_); }
+
+    private:
+        std::atomic<int>* count_;
+    };
+
+    // Per-model generation statistics, learned from completed responses.
+    struct ModelStats {
+        std::atomic<double> completionTokens{ 0.0 };  // EWMA of eval_count
+        std::atomic<double> secondsPerToken{ 0.0 };   // EWMA of eval_duration / eval_count
+        Counter* cancellations = nullptr;
+        Counter* cancelledTokensSaved = nullptr;
+        Counter* cancelledSecondsSaved = nullptr;
+        RecentLatencies recentFirstByte;              // upstream first-byte times; sets the hedge delay
+        Histogram* timeToFirstToken = nullptr;
+        Histogram* interTokenLatency = nullptr;
+        Histogram* tokensPerSecond = nullptr;
+        Histogram* promptEvalSeconds = nullptr;
+        Histogram* evalSeconds = nullptr;
+        Counter* hedges = nullptr;
+        Counter* hedgeWins = nullptr;
+        Gauge* hedgeDelay = nullptr;                  // the recent TTFT quantile last used as the delay
+        Histogram* firstByte = nullptr;               // upstream first-byte time, not hedged
+        Histogram* hedgedFirstByte = nullptr;         // ... and hedged
+    };
+
+    struct UserStats {
+        Counter* requests = nullptr;
+        Counter* promptTokens = nullptr;
+        Counter* completionTokens = nullptr;
+    };
+
+    enum class HedgeOutcome { NotHedged, PrimaryWon, BackupWon, ClientGone };
+
+    // Reads from the upstream while watching the client socket, so that a
+    // client which disconnects or half-closes is noticed at once (not on the
+    // next write) and the upstream request is reset, stopping generation.
+    class WatchedUpstream {
+    public:
+        static constexpr int kClientGone = kRecvPeerGone;
+
+        WatchedUpstream(Socket& server, Socket& client) : server_(server), client_(client) {}
+
+        int Recv(char* buffer, int length) {
+            const int received = RecvWithin(buffer, length, static_cast<int>(kUpstreamTimeoutMs));
+            return received == kRecvTimedOut ? SOCKET_ERROR : received;
+        }
+
+        // As Recv, but returns kRecvTimedOut if nothing arrives in `timeoutMs`.
+        int RecvWithin(char* buffer, int length, int timeoutMs) {
+            for (;;) {
+                WSAPOLLFD fds[2] = { { server_.Get(), POLLRDNORM, 0 }, { client_.Get(), POLLRDNORM, 0 } };
+                const int ready = WSAPoll(fds, watchClient_ ? 2 : 1, timeoutMs);
+                if (ready == SOCKET_ERROR)
+                    return SOCKET_ERROR;
+                if (ready == 0)
+                    return kRecvTimedOut;
+                if (watchClient_ && fds[1].revents != 0 && ClientGone(fds[1].revents)) {
+                    clientGone_ = true;
+                    server_.Abort();
+                    return kClientGone;
+                }
+                if (fds[0].revents != 0) {
+                    const int received = server_.Recv(buffer, length);
+                    upstreamClosed_ = upstreamClosed_ || received <= 0;
+                    return received;
+                }
+            }
+        }
+
+        bool ClientGoneSeen() const { return clientGone_; }
+        // The upstream closed or reset the connection (as opposed to a timeout).
+        bool UpstreamClosedSeen() const { return upstreamClosed_; }
+
+    private:
+        bool ClientGone(short revents) {
+            if (revents & (POLLHUP | POLLERR | POLLNVAL))
+                return true;
+            char probe;
+            if (recv(client_.Get(), &probe, 1, MSG_PEEK) > 0) {
+                // A pipelined request, not a disconnect; it stays queued in the
+                // socket for the next read, so stop polling the client.
+                watchClient_ = false;
+                return false;
+            }
+            return true;
+        }
+
+        Socket& server_;
+        Socket& client_;
+        bool watchClient_ = true;
+        bool clientGone_ = false;
+        bool upstreamClosed_ = false;
+    };
+
+    // Keeps the last few hundred bytes of a response body, which is where
+    // Ollama reports its token counts and durations.
+    class ResponseTail {
+    public:
+        void Append(const char* data, size_t length) {
+            if (length >= kSize) {
+                std::memcpy(tail_, data + length - kSize, kSize);
+                size_ = kSize;
+                return;
+            }
+            if (size_ + length > sizeof(tail_)) {
+                std::memmove(tail_, tail_ + size_ - kSize, kSize);
+                size_ = kSize;
+            }
+            std::memcpy(tail_ + size_, data, length);
+            size_ += length;
+        }
+        std::string_view View() const { return { tail_, size_ }; }
+
+    private:
+        static constexpr size_t kSize = 1024;
+        char tail_[2 * kSize];
+        size_t size_ = 0;
+    };
+
+    void ServeConnection(Socket& client, const std::string& clientAddress) {
+        client.SetReceiveTimeout(kClientIdleTimeoutMs);
+        std::string buffer;
+        Arena arena;
+        bool keepAlive = true;
+        while (keepAlive && running_) {
+            // Everything the previous request left in the arena goes at once.
+            arena.Reset();
+            HttpRequest request(arena);
+            if (!ReadHttpRequest(client, buffer, arena, request, config_.maxBodyBytes))
+                break;
+            const std::string_view* connection = FindHeader(request.headers, "Connection");
+            keepAlive = request.version == "HTTP/1.1" ?
+                !(connection && ContainsTokenIgnoreCase(*connection, "close")) :
+                (connection && ContainsTokenIgnoreCase(*connection, "keep-alive"));
+
+            if (request.method == "GET" && request.target == "/metrics") {
+                keepAlive = SendSimpleResponse(client, 200, "OK", "text/plain; version=0.0.4",
+                    MetricsRegistry::Instance().Render()) && keepAlive;
+                continue;
+            }
+            keepAlive = Forward(client, request, arena, keepAlive, clientAddress);
+        }
+    }
+
+    // Forwards one request and relays the response. Returns whether the client
+    // connection can be reused.
+    bool Forward(Socket& client, const HttpRequest& request, Arena& arena, bool keepAlive,
+        const std::string& clientAddress)
+    {
+        const auto received = std::chrono::steady_clock::now();
+        const std::string_view model = JsonScan::Unquote(JsonScan::FindField(request.body, "model"));
+        int64_t numPredict = 0;
+        JsonScan::ToInt(JsonScan::FindField(JsonScan::FindField(request.body, "options"), "num_predict"), numPredict);
+
+        // Inference requests wait for a slot on their model; everything else
+        // (tags, show, pull, ...) goes straight through.
+        const std::string_view path = request.target.substr(0, request.target.find('?'));
+        const bool inference = !model.empty() && IsInferenceRoute(path);
+        const std::string modelName = inference ? CanonicalModelName(model) : std::string();
+        ModelStats* stats = inference ? &StatsFor(modelName) : nullptr;
+        const bool admitted = scheduler_ && inference;
+        AdmissionTicket ticket;
+        if (inference) {
+            ticket.model = modelName;
+            ticket.user = IdentifyUser(request, clientAddress);
+            ticket.cost = EstimateCost(request, path, numPredict, *stats);
+        }
+        if (admitted) {
+            ticket.classIndex = scheduler_->Classify(path, request.headers, clientAddress);
+            if (!scheduler_->Acquire(ticket, [&] { return PeerClosed(client); }))
+                return false;
+        }
+        struct AdmissionGuard {
+            AdmissionScheduler* scheduler;
+            const AdmissionTicket& ticket;
+            double consumedTokens;
+            ~AdmissionGuard() { if (scheduler) scheduler->Release(ticket, consumedTokens); }
+        } admission{ admitted ? scheduler_.get() : nullptr, ticket, ticket.cost };
+        UserStats* user = inference ? &UserStatsFor(ticket.user) : nullptr;
+        if (user)
+            user->requests->Add();
+
+        const std::vector<PrefixCheckpoint> checkpoints =
+            ComputePrefixCheckpoints(request.body, model, config_.affinityPrefixBytes);
+
+        std::vector<int> loads;
+        loads.reserve(upstreams_.size());
+        for (const auto& candidate : upstreams_)
+            loads.push_back(candidate->inFlight.load(std::memory_order_relaxed));
+        PrefixRouter::Decision decision = router_->Route(checkpoints, Fnv1a(model), loads);
+        if (!checkpoints.empty()) {
+            if (decision.result == PrefixRouter::Result::Hit) affinityHits_->Add();
+            else if (decision.result == PrefixRouter::Result::Diverted) affinityDiverted_->Add();
+            else affinityMisses_->Add();
+        }
+
+        Upstream* upstream = upstreams_[decision.upstream].get();
+        upstream->requests->Add();
+        InFlight inFlight(*upstream);
+
+        const ArenaString upstreamHead = BuildUpstreamHead(request, *upstream, arena);
+        bool reused = false;
+        Socket server = upstream->pool->Acquire(reused);
+        bool requestSent = server.Valid() && SendRequest(server, upstreamHead, request.body);
+        if (!requestSent && reused) {
+            server = upstream->pool->Connect();
+            reused = false;
+            requestSent = server.Valid() && SendRequest(server, upstreamHead, request.body);
+        }
+        if (!requestSent)
+            return FailUpstream(client, *upstream, L"send request") && keepAlive;
+        const auto sent = std::chrono::steady_clock::now();
+
+        ArenaString buffer{ ArenaAllocator<char>(arena) };
+        bool clientGone = false;
+        HedgeOutcome hedge = HedgeOutcome::NotHedged;
+        if (config_.hedging.enabled && upstreams_.size() > 1 && inference && IsIdempotent(request, path)) {
+            hedge = Hedge(client, request, arena, *stats, admitted ? &ticket : nullptr, server, decision.upstream,
+                inFlight, buffer);
+            clientGone = hedge == HedgeOutcome::ClientGone;
+            if (hedge == HedgeOutcome::BackupWon) {
+                // The backup evaluated the whole prompt and now holds the prefix.
+                upstream = upstreams_[decision.upstream].get();
+                decision.result = PrefixRouter::Result::Miss;
+                decision.cachedBytes = 0;
+                router_->Record(checkpoints, decision.upstream);
+            }
+        }
+        WatchedUpstream watched(server, client);
+
+        size_t headEnd = clientGone ? 0 : ReadHeaderBlock(watched, buffer);
+        if (headEnd == 0 && buffer.empty() && reused && hedge != HedgeOutcome::BackupWon && watched.UpstreamClosedSeen() &&
+            !watched.ClientGoneSeen())
+        {
+            // Ollama closed the pooled connection as the request went out, so
+            // nothing was processed; send it once more on a new connection.
+            server = upstream->pool->Connect();
+            if (!server.Valid() || !SendRequest(server, upstreamHead, request.body))
+                return FailUpstream(client, *upstream, L"send request") && keepAlive;
+            headEnd = ReadHeaderBlock(watched, buffer);
+        }
+        HttpResponseHead response(arena);
+        if (clientGone || watched.ClientGoneSeen()) {
+            if (stats)
+                RecordCancellation(*stats, numPredict, 0, 0.0);
+            admission.consumedTokens = static_cast<double>(request.body.size() / kBytesPerToken);
+            return false;
+        }
+        if (headEnd == 0 || !ParseResponseHead(std::string_view(buffer.data(), headEnd - 4), arena, response))
+            return FailUpstream(client, *upstream, L"read response") && keepAlive;
+        buffer.erase(0, headEnd);
+        if (inference && response.status == 200) {
+            const double firstByte = Seconds(std::chrono::steady_clock::now() - sent);
+            stats->recentFirstByte.Add(firstByte);
+            (hedge == HedgeOutcome::NotHedged ? stats->firstByte : stats->hedgedFirstByte)->Record(firstByte);
+        }
+
+        const bool noBody = request.method == "HEAD" || response.status / 100 == 1 ||
+            response.status == 204 || response.status == 304;
+        const std::string_view* transferEncoding = FindHeader(response.headers, "Transfer-Encoding");
+        const std::string_view* contentLengthHeader = FindHeader(response.headers, "Content-Length");
+        const bool chunked = transferEncoding && ContainsTokenIgnoreCase(*transferEncoding, "chunked");
+        uint64_t contentLength = 0;
+        const bool hasLength = !chunked && contentLengthHeader && ParseUint(*contentLengthHeader, contentLength);
+        // The connection can serve another request once this body has been read to its end.
+        const bool upstreamReusable = ResponseKeepsConnection(response) && (noBody || chunked || hasLength);
+
+        ArenaString head{ ArenaAllocator<char>(arena) };
+        head.reserve(1024);
+        head.append("HTTP/1.1 ").append(std::to_string(response.status)).append(" ").append(response.reason).append("\r\n");
+        for (const auto& header : response.headers) {
+            if (!IsHopByHopHeader(header.name))
+                AppendHeader(head, header.name, header.value);
+        }
+        if (hasLength)
+            AppendHeader(head, "Content-Length", std::to_string(contentLength));
+        else if (!noBody)
+            head.append("Transfer-Encoding: chunked\r\n");
+        head.append(keepAlive ? "Connection: keep-alive\r\n\r\n" : "Connection: close\r\n\r\n");
+        if (!client.SendAll(std::string_view(head)))
+            return false;
+        if (noBody) {
+            if (upstreamReusable)
+                upstream->pool->Release(std::move(server));
+            return keepAlive;
+        }
+
+        // Bodies the proxy has no use for (model lists, pull progress, ...)
+        // are passed through with their own framing.
+        if (!inference && (chunked || hasLength)) {
+            const RelayStatus status = RelayPassThrough(watched, client, buffer,
+                chunked ? BodyFraming::Chunked : BodyFraming::Length, contentLength);
+            if (status == RelayStatus::UpstreamFailed)
+                upstream->errors->Add();
+            if (status == RelayStatus::Complete && upstreamReusable)
+                upstream->pool->Release(std::move(server));
+            return status == RelayStatus::Complete && keepAlive;
+        }
+
+        // Streamed responses carry one NDJSON line per generated token, then a
+        // final `"done": true` line with the totals. Token timing is taken as
+        // lines arrive; nothing is buffered beyond the tail.
+        const std::string_view* contentType = FindHeader(response.headers, "Content-Type");
+        const bool ndjson = contentType && contentType->find("ndjson") != std::string::npos;
+        uint64_t streamedTokens = 0;
+        std::chrono::steady_clock::time_point firstToken;
+        std::chrono::steady_clock::time_point lastToken;
+        JsonScan::NdjsonSplitter splitter;
+
+        ResponseTail tail;
+        ChunkCoalescer coalescer(client, !hasLength, config_.coalescing.delayMs, config_.coalescing.maxBytes);
+        const RelayStatus status = RelayBody(watched, buffer, chunked, hasLength, contentLength, &coalescer,
+            [&](const char* data, size_t length) {
+                tail.Append(data, length);
+                uint64_t lines = 0;
+                if (ndjson && stats) {
+                    splitter.Feed(data, length, [&](std::string_view line) {
+                        lines += !JsonScan::IsTrue(JsonScan::FindField(line, "done"));
+                    });
+                }
+                if (lines > 0) {
+                    const auto now = std::chrono::steady_clock::now();
+                    if (streamedTokens == 0) {
+                        firstToken = now;
+                        stats->timeToFirstToken->Record(Seconds(now - received));
+                    }
+                    else {
+                        // Lines that arrive in one read share the gap since the previous one.
+                        stats->interTokenLatency->Record(Seconds(now - lastToken) / static_cast<double>(lines), lines);
+                    }
+                    lastToken = now;
+                    streamedTokens += lines;
+                }
+                return coalescer.Write(data, length);
+            });
+        if (status == RelayStatus::ClientGone) {
+            server.Abort();
+            const double streaming = Seconds(std::chrono::steady_clock::now() - firstToken);
+            if (stats)
+                RecordCancellation(*stats, numPredict, streamedTokens, streamedTokens > 1 ? streaming : 0.0);
+            if (user)
+                user->completionTokens->Add(static_cast<double>(streamedTokens));
+            admission.consumedTokens = static_cast<double>(request.body.size() / kBytesPerToken + streamedTokens);
+            return false;
+        }
+        if (status == RelayStatus::UpstreamFailed) {
+            upstream->errors->Add();
+            return false;
+        }
+        if (upstreamReusable)
+            upstream->pool->Release(std::move(server));
+        if (!coalescer.Finish())
+            return false;
+        if (ndjson) {
+            streamWritesReceived_->Record(static_cast<double>(coalescer.Writes()));
+            streamWritesSent_->Record(static_cast<double>(coalescer.Sends()));
+        }
+
+        RecordPromptEval(*upstream, decision, tail.View());
+        if (stats)
+            RecordGeneration(*stats, tail.View());
+        if (user)
+            admission.consumedTokens = RecordUsage(*user, tail.View(), admission.consumedTokens);
+        return keepAlive;
+    }
+
+    static bool IsInferenceRoute(std::string_view path) {
+        static constexpr std::string_view routes[] = {
+            "/api/generate", "/api/chat", "/api/embed", "/api/embeddings",
+            "/v1/chat/completions", "/v1/completions", "/v1/embeddings"
+        };
+        for (const auto& route : routes) {
+            if (path == route)
+                return true;
+        }
+        return false;
+    }
+
+    // Requests that may safely run twice: embeddings, and generations that
+    // are deterministic because they sample at temperature 0.
+    static bool IsIdempotent(const HttpRequest& request, std::string_view path) {
+        if (path.find("embed") != std::string_view::npos)
+            return true;
+        std::string_view temperature = JsonScan::FindField(JsonScan::FindField(request.body, "options"), "temperature");
+        if (temperature.empty())
+            temperature = JsonScan::FindField(request.body, "temperature"); // OpenAI-compatible routes
+        double value = 1.0;
+        return JsonScan::ToDouble(temperature, value) && value == 0.0;
+    }
+
+    // Waits for the first response byte from `server`. If none arrives within
+    // the model's recent TTFT quantile, the request is duplicated to the least
+    // loaded other instance (taking a scheduler slot for it when the request
+    // was admitted, and only if one is free). The backup wins only with a 2xx
+    // status line before the primary sends anything; an error or a closed
+    // connection from it is dropped and the primary waited for. The winner is
+    // left in `server` and `serving` (an index into upstreams_), with the
+    // bytes already read from a winning backup in `buffer`, and the other
+    // connection is reset so Ollama stops working on it.
+    HedgeOutcome Hedge(Socket& client, const HttpRequest& request, Arena& arena, ModelStats& stats,
+        const AdmissionTicket* ticket, Socket& server, size_t& serving, InFlight& inFlight, ArenaString& buffer)
+    {
+        const double threshold = stats.recentFirstByte.Quantile(config_.hedging.quantile, config_.hedging.minSamples);
+        if (threshold <= 0.0)
+            return HedgeOutcome::NotHedged;
+        stats.hedgeDelay->Set(threshold);
+        const int delayMs = (std::max)(config_.hedging.minDelayMs, static_cast<int>(threshold * 1000.0));
+        const int first = WaitFirstByte(client, server, nullptr, delayMs);
+        if (first == WatchedUpstream::kClientGone) {
+            server.Abort();
+            return HedgeOutcome::ClientGone;
+        }
+        if (first >= 0)
+            return HedgeOutcome::NotHedged;
+
+        // The duplicate runs the model once more, so it holds a slot of its own.
+        struct ExtraSlot {
+            AdmissionScheduler* scheduler = nullptr;
+            const std::string* model = nullptr;
+            ~ExtraSlot() { if (scheduler) scheduler->ReleaseExtra(*model); }
+        } slot;
+        if (ticket) {
+            if (!scheduler_->TryAcquireExtra(ticket->model))
+                return HedgeOutcome::NotHedged;
+            slot.scheduler = scheduler_.get();
+            slot.model = &ticket->model;
+        }
+
+        size_t backupIndex = serving;
+        for (size_t i = 0; i < upstreams_.size(); ++i) {
+            if (i != serving && (backupIndex == serving || upstreams_[i]->inFlight.load(std::memory_order_relaxed) <
+                upstreams_[backupIndex]->inFlight.load(std::memory_order_relaxed)))
+                backupIndex = i;
+        }
+        Upstream* backup = upstreams_[backupIndex].get();
+        backup->requests->Add();
+        InFlight backupInFlight(*backup);
+        // A fresh connection: a stale pooled one would look like the backup
+        // answering first.
+        Socket duplicate = backup->pool->Connect();
+        if (!duplicate.Valid() || !SendRequest(duplicate, BuildUpstreamHead(request, *backup, arena), request.body)) {
+            backup->errors->Add();
+            return HedgeOutcome::NotHedged;
+        }
+        stats.hedges->Add();
+
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(kUpstreamTimeoutMs);
+        Socket* racing = &duplicate;
+        for (;;) {
+            const auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+            const int winner = WaitFirstByte(client, server, racing, static_cast<int>(left.count()));
+            if (winner == WatchedUpstream::kClientGone) {
+                server.Abort();
+                duplicate.Abort();
+                return HedgeOutcome::ClientGone;
+            }
+            if (winner != 1) {
+                duplicate.Abort();
+                return HedgeOutcome::PrimaryWon;
+            }
+            char chunk[1024];
+            const int received = duplicate.Recv(chunk, sizeof(chunk));
+            if (received > 0)
+                buffer.append(chunk, static_cast<size_t>(received));
+            const size_t lineEnd = buffer.find("\r\n");
+            if (received > 0 && lineEnd == ArenaString::npos && buffer.size() < sizeof(chunk))
+                continue; // the status line is still arriving
+            if (received > 0 && IsSuccessStatusLine(std::string_view(buffer.data(), (std::min)(lineEnd, buffer.size()))))
+                break;
+            // Closed, failed or answered with an error: not worth switching to.
+            backup->errors->Add();
+            duplicate.Abort();
+            buffer.clear();
+            racing = nullptr;
+        }
+        server.Abort();
+        server = std::move(duplicate);
+        serving = backupIndex;
+        inFlight.Swap(backupInFlight);
+        stats.hedgeWins->Add();
+        return HedgeOutcome::BackupWon;
+    }
+
+    // "HTTP/1.x 2xx ...", the start of a response worth relaying.
+    static bool IsSuccessStatusLine(std::string_view line) {
+        return line.size() >= 12 && line.compare(0, 7, "HTTP/1.") == 0 && line[8] == ' ' && line[9] == '2';
+    }
+
+    // Returns 0 or 1 for the first of `primary` / `backup` with data (or a
+    // closed connection), -1 on timeout, or kClientGone if the client left.
+    // `backup` may be null.
+    static int WaitFirstByte(Socket& client, Socket& primary, Socket* backup, int timeoutMs) {
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+        bool watchClient = true;
+        for (;;) {
+            const auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+            if (left.count() <= 0)
+                return -1;
+            WSAPOLLFD fds[3] = { { primary.Get(), POLLRDNORM, 0 } };
+            ULONG count = 1;
+            if (backup)
+                fds[count++] = { backup->Get(), POLLRDNORM, 0 };
+            const ULONG clientSlot = count;
+            if (watchClient)
+                fds[count++] = { client.Get(), POLLRDNORM, 0 };
+            const int ready = WSAPoll(fds, count, static_cast<int>(left.count()));
+            if (ready == SOCKET_ERROR)
+                return -1;
+            if (watchClient && fds[clientSlot].revents != 0) {
+                if (PeerClosed(client))
+                    return WatchedUpstream::kClientGone;
+                watchClient = false; // pipelined request; leave it queued
+            }
+            if (fds[0].revents != 0)
+                return 0;
+            if (backup && fds[1].revents != 0)
+                return 1;
+        }
+    }
+
+    // Cheap job size estimate for shortest-job-first ordering: prompt tokens
+    // plus the tokens expected to be generated.
+    static double EstimateCost(const HttpRequest& request, std::string_view path, int64_t numPredict,
+        const ModelStats& stats)
+    {
+        const double promptTokens = static_cast<double>(request.body.size() / kBytesPerToken);
+        if (path.find("embed") != std::string_view::npos)
+            return promptTokens;
+        if (numPredict > 0)
+            return promptTokens + static_cast<double>(numPredict);
+        const double typical = stats.completionTokens.load(std::memory_order_relaxed);
+        return promptTokens + (typical > 0.0 ? typical : kDefaultCompletionTokens);
+    }
+
+    // Names the user a request is accounted to: the header Open WebUI
+    // forwards, else a hash of the API key (never the key itself), else the
+    // client address.
+    std::string IdentifyUser(const HttpRequest& request, const std::string& clientAddress) const {
+        const std::string_view* id = config_.userHeader.empty() ? nullptr : FindHeader(request.headers, config_.userHeader);
+        if (id && !id->empty())
+            return std::string(*id);
+        if (const std::string_view* authorization = FindHeader(request.headers, "Authorization")) {
+            char digest[17];
+            snprintf(digest, sizeof(digest), "%016llx", static_cast<unsigned long long>(Mix64(Fnv1a(*authorization))));
+            return std::string("key-") + digest;
+        }
+        return clientAddress;
+    }
+
+    ArenaString BuildUpstreamHead(const HttpRequest& request, const Upstream& upstream, Arena& arena) const {
+        ArenaString head{ ArenaAllocator<char>(arena) };
+        head.reserve(1024);
+        head.append(request.method).append(" ").append(request.target).append(" HTTP/1.1\r\n");
+        AppendHeader(head, "Host", upstream.label);
+        for (const auto& header : request.headers) {
+            if (!IsHopByHopHeader(header.name) && !EqualsIgnoreCase(header.name, "Host"))
+                AppendHeader(head, header.name, header.value);
+        }
+        if (!request.body.empty() || request.method == "POST" || request.method == "PUT")
+            AppendHeader(head, "Content-Length", std::to_string(request.body.size()));
+        head.append(config_.pool.enabled ? "Connection: keep-alive\r\n\r\n" : "Connection: close\r\n\r\n");
+        return head;
+    }
+
+    // Sends the head and body in one gathered write.
+    static bool SendRequest(Socket& server, std::string_view head, std::string_view body) {
+        WSABUF pieces[2] = {
+            { static_cast<ULONG>(head.size()), const_cast<char*>(head.data()) },
+            { static_cast<ULONG>(body.size()), const_cast<char*>(body.data()) }
+        };
+        return server.SendAll(pieces, body.empty() ? 1 : 2);
+    }
+
+    static bool FailUpstream(Socket& client, Upstream& upstream, const std::wstring& step) {
+        upstream.errors->Add();
+        Log(LogLevel::Warning, L"Ollama proxy failed to " + step + L" on " + UTF8ToWString(upstream.label) +
+            L" Error code: " + std::to_wstring(WSAGetLastError()));
+        return SendSimpleResponse(client, 502, "Bad Gateway", "text/plain", "Ollama instance unavailable\n");
+    }
+
+    // Decodes the upstream body framing (chunked, Content-Length or
+    // read-until-close) and hands payload bytes to `sink`, which returns false
+    // when the client can no longer be written to. While `coalescer` holds
+    // bytes, reads wait only until they are due and then flush them.
+    template <typename Sink>
+    static RelayStatus RelayBody(WatchedUpstream& server, std::string_view pending, bool chunked, bool hasLength,
+        uint64_t contentLength, ChunkCoalescer* coalescer, Sink&& sink)
+    {
+        ChunkedDecoder decoder;
+        uint64_t remaining = contentLength;
+        bool sinkOk = true;
+        auto deliver = [&](const char* data, size_t length) {
+            if (sinkOk)
+                sinkOk = sink(data, length);
+        };
+        auto consume = [&](const char* data, size_t length) {
+            if (chunked) {
+                decoder.Feed(data, length, deliver);
+                return decoder.Done();
+            }
+            if (hasLength) {
+                const size_t take = static_cast<size_t>((std::min)(remaining, static_cast<uint64_t>(length)));
+                deliver(data, take);
+                remaining -= take;
+                return remaining == 0;
+            }
+            deliver(data, length);
+            return false;
+        };
+
+        bool done = hasLength && remaining == 0;
+        if (!done && !pending.empty())
+            done = consume(pending.data(), pending.size());
+        if (decoder.Failed())
+            return RelayStatus::UpstreamFailed;
+
+        PooledBuffer chunk;
+        while (!done && sinkOk) {
+            const int dueInMs = coalescer ? coalescer->DueInMs() : -1;
+            const int received = dueInMs < 0 ? server.Recv(chunk.Data(), chunk.Size()) :
+                server.RecvWithin(chunk.Data(), chunk.Size(), dueInMs);
+            if (received == kRecvTimedOut) {
+                sinkOk = coalescer->Flush();
+                continue;
+            }
+            if (received == WatchedUpstream::kClientGone)
+                return RelayStatus::ClientGone;
+            if (received < 0)
+                return RelayStatus::UpstreamFailed;
+            if (received == 0) {
+                if (chunked || hasLength)
+                    return RelayStatus::UpstreamFailed;
+                break;
+            }
+            done = consume(chunk.Data(), static_cast<size_t>(received));
+            if (decoder.Failed())
+                return RelayStatus::UpstreamFailed;
+        }
+        return sinkOk ? RelayStatus::Complete : RelayStatus::ClientGone;
+    }
+
+    // On a cold request, learn the instance's prompt evaluation speed; on an
+    // affinity hit, credit the evaluation time the cached prefix avoided.
+    void RecordPromptEval(Upstream& upstream, const PrefixRouter::Decision& decision, std::string_view tail) {
+        int64_t count = 0;
+        int64_t durationNs = 0;
+        if (!JsonScan::FindIntAnywhere(tail, "prompt_eval_count", count) ||
+            !JsonScan::FindIntAnywhere(tail, "prompt_eval_duration", durationNs) || count <= 0)
+            return;
+
+        const double learned = upstream.promptEvalSecondsPerToken.load(std::memory_order_relaxed);
+        if (decision.result == PrefixRouter::Result::Hit) {
+            promptEvalSaved_->Add(static_cast<double>(decision.cachedBytes / kBytesPerToken) * learned);
+            return;
+        }
+        const double sample = static_cast<double>(durationNs) / 1e9 / static_cast<double>(count);
+        upstream.promptEvalSecondsPerToken.store(learned == 0.0 ? sample : 0.8 * learned + 0.2 * sample,
+            std::memory_order_relaxed);
+    }
+
+    // Lookups take the lock shared so requests on different cores do not
+    // serialize; only the first request for a model registers its metrics.
+    // The model name comes from the client, so only the first
+    // kMaxModelSeries models get series of their own; later ones share
+    // model="other" (and its learned completion length and hedge delay).
+    ModelStats& StatsFor(std::string_view model) {
+        std::string key(model);
+        {
+            std::shared_lock<std::shared_mutex> lock(statsMutex_);
+            auto found = modelStats_.find(key);
+            if (found == modelStats_.end() && modelStats_.size() >= kMaxModelSeries)
+                found = modelStats_.find(key = kOtherModel);
+            if (found != modelStats_.end())
+                return *found->second;
+        }
+        std::unique_lock<std::shared_mutex> lock(statsMutex_);
+        if (modelStats_.size() >= kMaxModelSeries && modelStats_.find(key) == modelStats_.end())
+            key = kOtherModel;
+        std::unique_ptr<ModelStats>& stats = modelStats_[key];
+        if (!stats) {
+            MetricsRegistry& metrics = MetricsRegistry::Instance();
+            const std::string labels = "model=\"" + LabelValue(key) + "\"";
+            stats = std::make_unique<ModelStats>();
+            stats->cancellations = &metrics.GetCounter("owui_proxy_cancellations_total",
+                "Requests whose upstream generation was aborted because the client went away.", labels);
+            stats->cancelledTokensSaved = &metrics.GetCounter("owui_proxy_cancelled_tokens_saved_total",
+                "Estimated tokens Ollama did not have to generate thanks to cancellation.", labels);
+            stats->cancelledSecondsSaved = &metrics.GetCounter("owui_proxy_cancelled_seconds_saved_total",
+                "Estimated generation time saved thanks to cancellation.", labels);
+            stats->timeToFirstToken = &metrics.GetHistogram("owui_proxy_time_to_first_token_seconds",
+                "Time from receiving a streamed request to relaying its first token, queueing included.", labels);
+            stats->interTokenLatency = &metrics.GetHistogram("owui_proxy_inter_token_latency_seconds",
+                "Time between consecutive streamed tokens.", labels);
+            stats->tokensPerSecond = &metrics.GetHistogram("owui_proxy_tokens_per_second",
+                "Generation speed per request (eval_count / eval_duration).", labels, 1e-3);
+            stats->promptEvalSeconds = &metrics.GetHistogram("owui_proxy_prompt_eval_duration_seconds",
+                "Prompt evaluation time reported by Ollama.", labels);
+            stats->evalSeconds = &metrics.GetHistogram("owui_proxy_eval_duration_seconds",
+                "Generation time reported by Ollama.", labels);
+            stats->hedges = &metrics.GetCounter("owui_proxy_hedged_requests_total",
+                "Requests duplicated to a second instance because the first was slow to answer.", labels);
+            stats->hedgeWins = &metrics.GetCounter("owui_proxy_hedge_wins_total",
+                "Hedged requests where the duplicate answered first with a success status.", labels);
+            stats->hedgeDelay = &metrics.GetGauge("owui_proxy_hedge_delay_seconds",
+                "Recent time-to-first-byte quantile after which requests are hedged.", labels);
+            const char* firstByteHelp = "Time from sending a request upstream to its first response byte.";
+            stats->firstByte = &metrics.GetHistogram("owui_proxy_upstream_first_byte_seconds", firstByteHelp,
+                labels + ",hedged=\"false\"");
+            stats->hedgedFirstByte = &metrics.GetHistogram("owui_proxy_upstream_first_byte_seconds", firstByteHelp,
+                labels + ",hedged=\"true\"");
+        }
+        return *stats;
+    }
+
+    // As StatsFor: the user key comes from the client (a header, a key hash
+    // or the address), so past kMaxUserSeries users the rest share
+    // user="other".
+    UserStats& UserStatsFor(const std::string& user) {
+        std::string key = user;
+        {
+            std::shared_lock<std::shared_mutex> lock(statsMutex_);
+            auto found = userStats_.find(key);
+            if (found == userStats_.end() && userStats_.size() >= kMaxUserSeries)
+                found = userStats_.find(key = kOtherUser);
+            if (found != userStats_.end())
+                return *found->second;
+        }
+        std::unique_lock<std::shared_mutex> lock(statsMutex_);
+        if (userStats_.size() >= kMaxUserSeries && userStats_.find(key) == userStats_.end())
+            key = kOtherUser;
+        std::unique_ptr<UserStats>& stats = userStats_[key];
+        if (!stats) {
+            MetricsRegistry& metrics = MetricsRegistry::Instance();
+            const std::string labels = "user=\"" + LabelValue(key) + "\"";
+            const char* tokensHelp = "Tokens consumed per user, as reported by Ollama.";
+            stats = std::make_unique<UserStats>();
+            stats->requests = &metrics.GetCounter("owui_proxy_user_requests_total",
+                "Inference requests per user.", labels);
+            stats->promptTokens = &metrics.GetCounter("owui_proxy_user_tokens_total", tokensHelp,
+                labels + ",kind=\"prompt\"");
+            stats->completionTokens = &metrics.GetCounter("owui_proxy_user_tokens_total", tokensHelp,
+                labels + ",kind=\"completion\"");
+        }
+        return *stats;
+    }
+
+    // Counts the prompt_eval_count / eval_count Ollama reports and returns
+    // their sum, or `fallback` when the response carried neither.
+    static double RecordUsage(UserStats& user, std::string_view tail, double fallback) {
+        int64_t promptTokens = 0;
+        int64_t completionTokens = 0;
+        const bool hasPrompt = JsonScan::FindIntAnywhere(tail, "prompt_eval_count", promptTokens);
+        const bool hasCompletion = JsonScan::FindIntAnywhere(tail, "eval_count", completionTokens);
+        if (!hasPrompt && !hasCompletion)
+            return fallback;
+        user.promptTokens->Add(static_cast<double>(promptTokens));
+        user.completionTokens->Add(static_cast<double>(completionTokens));
+        return static_cast<double>(promptTokens + completionTokens);
+    }
+
+    template <typename Duration>
+    static double Seconds(Duration duration) { return std::chrono::duration<double>(duration).count(); }
+
+    // Records Ollama's own timings from the final chunk and learns typical
+    // completion length and generation speed from eval_count / eval_duration.
+    static void RecordGeneration(ModelStats& stats, std::string_view tail) {
+        int64_t promptEvalDurationNs = 0;
+        if (JsonScan::FindIntAnywhere(tail, "prompt_eval_duration", promptEvalDurationNs))
+            stats.promptEvalSeconds->Record(static_cast<double>(promptEvalDurationNs) / 1e9);
+
+        int64_t evalCount = 0;
+        int64_t evalDurationNs = 0;
+        if (!JsonScan::FindIntAnywhere(tail, "eval_count", evalCount) ||
+            !JsonScan::FindIntAnywhere(tail, "eval_duration", evalDurationNs) || evalCount <= 0 || evalDurationNs <= 0)
+            return;
+        const double evalSeconds = static_cast<double>(evalDurationNs) / 1e9;
+        stats.evalSeconds->Record(evalSeconds);
+        stats.tokensPerSecond->Record(static_cast<double>(evalCount) / evalSeconds);
+        const auto blend = [](std::atomic<double>& ewma, double sample) {
+            const double previous = ewma.load(std::memory_order_relaxed);
+            ewma.store(previous == 0.0 ? sample : 0.8 * previous + 0.2 * sample, std::memory_order_relaxed);
+        };
+        blend(stats.completionTokens, static_cast<double>(evalCount));
+        blend(stats.secondsPerToken, static_cast<double>(evalDurationNs) / 1e9 / static_cast<double>(evalCount));
+    }
+
+    // The tokens saved are what was still left of num_predict (or of the
+    // model's typical completion length when the request sets no limit).
+    static void RecordCancellation(ModelStats& stats, int64_t numPredict, uint64_t generated, double streamingSeconds) {
+        stats.cancellations->Add();
+        const double expected = numPredict > 0 ? static_cast<double>(numPredict) :
+            stats.completionTokens.load(std::memory_order_relaxed);
+        const double remaining = expected - static_cast<double>(generated);
+        if (remaining <= 0.0)
+            return;
+        const double secondsPerToken = streamingSeconds > 0.0 ?
+            streamingSeconds / static_cast<double>(generated - 1) :
+            stats.secondsPerToken.load(std::memory_order_relaxed);
+        stats.cancelledTokensSaved->Add(remaining);
+        stats.cancelledSecondsSaved->Add(remaining * secondsPerToken);
+        Log(LogLevel::Info, L"Client disconnected; aborted upstream generation (~" +
+            std::to_wstring(static_cast<int64_t>(remaining)) + L" tokens saved).");
+    }
+
+    ProxyConfig config_;
+    std::vector<std::unique_ptr<Upstream>> upstreams_;
+    std::unique_ptr<PrefixRouter> router_;
+    std::unique_ptr<AdmissionScheduler> scheduler_;
+    TcpServer server_;
+    std::atomic<bool> running_{ false };
+
+    std::shared_mutex statsMutex_;
+    std::unordered_map<std::string, std::unique_ptr<ModelStats>> modelStats_;
+    std::unordered_map<std::string, std::unique_ptr<UserStats>> userStats_;
+
+    Counter* affinityHits_ = nullptr;
+    Counter* affinityMisses_ = nullptr;
+    Counter* affinityDiverted_ = nullptr;
+    Counter* promptEvalSaved_ = nullptr;
+    Histogram* streamWritesReceived_ = nullptr;
+    Histogram* streamWritesSent_ = nullptr;
+};
@@ -1,7 +1,10 @@
+#include <winsock2.h>
 #include <windows.h>
 #include <tlhelp32.h>
 #include <winhttp.h>
 #include <iostream>
+#include <algorithm>
+#include <map>
 #include <string>
 #include <chrono>
 #include <thread>
@@ -9,26 +12,43 @@
 #include <filesystem>
 #include <vector>
 #include <stdexcept>
+#include <cstdlib>
+#include <new>
 #include <nlohmann/json.hpp>
+#include "Benchmarks.h"
+#include "Common.h"
+#include "ControlChannel.h"
+#include "Journal.h"
+#include "MetricsServer.h"
+#include "ProcessSampler.h"
+#include "StatusPage.h"
+#include "TimeSeries.h"
+#include "OllamaBench.h"
+#include "OllamaProxy.h"
+#include "Trace.h"
+#include "WebUIProxy.h"
 
 #pragma comment(lib, "winhttp.lib")
+#pragma comment(lib, "psapi.lib")
 
 using json = nlohmann::json;
 namespace fs = std::filesystem;
 using namespace std::chrono_literals;
 
 // -------------------------
-// Logging Helper
+// Allocation counting
 // -------------------------
-enum class LogLevel { Info, Warning, Error };
-
-void Log(LogLevel level, const std::wstring& message) {
-    const std::wstring prefix =
-        (level == LogLevel::Info) ? L"[INFO] " :
-        (level == LogLevel::Warning) ? L"[WARNING] " : L"[ERROR] ";
-    std::wcout << prefix << message << std::endl;
+// Lets `bench` report heap allocations; costs one relaxed load while off.
+void* operator new(size_t size) {
+    Bench::CountAllocation();
+    if (void* memory = std::malloc(size ? size : 1))
+        return memory;
+    throw std::bad_alloc();
 }
 
+void operator delete(void* memory) noexcept { std::free(memory); }
+void operator delete(void* memory, size_t) noexcept { std::free(memory); }
+
 // -------------------------
 // Console Manager
 // -------------------------
@@ -38,26 +58,45 @@ public:
     static void Show() { ::ShowWindow(::GetConsoleWindow(), SW_SHOW); }
 };
 
-// -------------------------
-// Unicode conversion helper
-// -------------------------
-std::wstring UTF8ToWString(const std::string& str) {
-    if (str.empty())
-        return std::wstring();
-    const int size_needed = MultiByteToWideChar(CP_UTF8, 0, str.data(),
-        static_cast<int>(str.size()), nullptr, 0);
-    std::wstring wstr(size_needed, 0);
-    MultiByteToWideChar(CP_UTF8, 0, str.data(),
-        static_cast<int>(str.size()), &wstr[0], size_needed);
-    return wstr;
-}
-
 // -------------------------
 // Configuration structure
 // -------------------------
+// Settings for the managed Ollama process, written by `tune`.
+struct OllamaSettings {
+    std::map<std::string, std::string> environment; // added to Ollama's environment at launch
+    int numThread = 0;                               // tuned options.num_thread; 0 if not tuned
+};
+
+// The search `tune` runs: every combination of the listed values is
+// benchmarked for `seconds`.
+struct TuneConfig {
+    std::string target = "127.0.0.1:11434";
+    std::string endpoint = "chat";
+    std::vector<std::string> models = { "llama3.2" };
+    std::vector<std::string> prompts;      // empty uses the load generator's own
+    double seconds = 60.0;
+    int numPredict = 128;
+    double p95LatencyMs = 30000.0;         // end-to-end target a configuration must meet
+    std::vector<int> numParallel = { 1, 2, 4 };
+    std::vector<int> maxLoadedModels;      // empty: 1, plus the number of models if more
+    std::vector<bool> flashAttention = { false, true };
+    std::vector<int> numThread = { 0 };    // 0 leaves Ollama's choice
+};
+
 struct Config {
     std::wstring ollamaPath;
     std::wstring dockerPath;
+    ProxyConfig proxy;
+    WebUIConfig webui;
+    OllamaSettings ollama;
+    TuneConfig tune;
+    JournalConfig journal;
+    TraceConfig trace;
+    MetricsEndpointConfig metrics;
+    HistoryConfig history;
+    ProcessSamplerConfig processSampler;
+    ControlConfig control;
+    StatusPageConfig statusPage;
 
     bool isValid() const {
         return !ollamaPath.empty() && !dockerPath.empty();
@@ -89,24 +128,60 @@ public:
         return found;
     }
 
+    // The id of a running process with one of the names, preferring earlier
+    // names; 0 if none runs. One snapshot for the whole list.
+    static DWORD FindProcessId(const std::vector<std::wstring>& processNames) {
+        HANDLE snapshot = CreateToolhelp32Snapshot(TH32CS_SNAPPROCESS, 0);
+        if (snapshot == INVALID_HANDLE_VALUE) return 0;
+
+        PROCESSENTRY32W pe32{ sizeof(pe32) };
+        DWORD pid = 0;
+        size_t rank = processNames.size();
+        if (Process32FirstW(snapshot, &pe32)) {
+            do {
+                for (size_t i = 0; i < rank; ++i) {
+                    if (_wcsicmp(pe32.szExeFile, processNames[i].c_str()) == 0) {
+                        pid = pe32.th32ProcessID;
+                        rank = i;
+                        break;
+                    }
+                }
+            } while (rank > 0 && Process32NextW(snapshot, &pe32));
+        }
+        CloseHandle(snapshot);
+        return pid;
+    }
+
     // Wait for at least one process from a list to appear, up to a timeout.
     static bool WaitForAnyProcess(const std::vector<std::wstring>& processNames,
         std::chrono::milliseconds checkInterval = 500ms,
         std::chrono::milliseconds timeout = 10000ms)
     {
         const auto start = std::chrono::steady_clock::now();
-        while (std::chrono::steady_clock::now() - start < timeout) {
+        for (int attempt = 1; std::chrono::steady_clock::now() - start < timeout; ++attempt) {
+            TraceSpan span("process scan", "probe");
+            span.Arg("attempt", attempt);
+            const auto scanStart = std::chrono::steady_clock::now();
             for (const auto& name : processNames) {
                 if (IsRunning(name)) {
                     Log(LogLevel::Info, L"Detected process: " + name);
+                    RecordScan(scanStart);
                     return true;
                 }
             }
+            RecordScan(scanStart);
+            span.End();
             std::this_thread::sleep_for(checkInterval);
         }
         return false;
     }
 
+    static void RecordScan(std::chrono::steady_clock::time_point start) {
+        static Histogram& scans = MetricsRegistry::Instance().GetHistogram("owui_probe_seconds",
+            "Round-trip time of health probes.", "probe=\"process_scan\"");
+        scans.Record(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+
     // Overload for waiting for a single process.
     static bool WaitForProcess(std::wstring_view processName,
         std::chrono::milliseconds checkInterval = 500ms,
@@ -115,15 +190,29 @@ public:
         return WaitForAnyProcess({ std::wstring(processName) }, checkInterval, timeout);
     }
 
-    // Start a process given its full path.
-    static bool Start(const std::wstring& path) {
+    // Start a process given its full path. `environment` is added to (and
+    // overrides) the variables inherited from this process.
+    static bool Start(const std::wstring& path, const std::map<std::string, std::string>& environment = {}) {
         STARTUPINFOW si{ sizeof(si) };
         PROCESS_INFORMATION pi{};
+        std::vector<wchar_t> block;
+        std::wstring settings;
+        if (!environment.empty()) {
+            block = BuildEnvironment(environment);
+            for (const auto& [name, value] : environment)
+                settings += (settings.empty() ? L" (" : L", ") + UTF8ToWString(name) + L"=" + UTF8ToWString(value);
+            settings += L")";
+        }
         BOOL success = CreateProcessW(path.c_str(), nullptr, nullptr, nullptr,
-            FALSE, 0, nullptr, nullptr, &si, &pi);
+            FALSE, environment.empty() ? 0 : CREATE_UNICODE_ENVIRONMENT,
+            environment.empty() ? nullptr : block.data(), nullptr, &si, &pi);
 
         if (success) {
-            Log(LogLevel::Info, L"Started process: " + path);
+            Log(LogLevel::Info, L"Started process: " + path + settings);
+            Journal::Instance().Record(JournalEvent::ProcessStart, pi.dwProcessId, 0, WStringToUTF8(path));
+            MetricsRegistry::Instance().GetCounter("owui_process_starts_total",
+                "Managed process launches; more than one means it was restarted.",
+                "process=\"" + LabelValue(WStringToUTF8(fs::path(path).filename().wstring())) + "\"").Add();
             CloseHandle(pi.hProcess);
             CloseHandle(pi.hThread);
         }
@@ -131,10 +220,42 @@ public:
             DWORD errorCode = GetLastError();
             Log(LogLevel::Error, L"Failed to start process: " + path +
                 L" Error code: " + std::to_wstring(errorCode));
+            Journal::Instance().Record(JournalEvent::ProcessStart, 0, errorCode, WStringToUTF8(path));
         }
         return success != 0;
     }
 
+    // This process's environment block with `overrides` applied, sorted by
+    // name as Windows keeps it.
+    static std::vector<wchar_t> BuildEnvironment(const std::map<std::string, std::string>& overrides) {
+        std::vector<std::wstring> entries;
+        for (const auto& [name, value] : overrides)
+            entries.push_back(UTF8ToWString(name) + L"=" + UTF8ToWString(value));
+        if (wchar_t* current = GetEnvironmentStringsW()) {
+            for (const wchar_t* entry = current; *entry; entry += wcslen(entry) + 1) {
+                // Names may start with '=' (the per-drive current directories).
+                const wchar_t* equals = wcschr(entry + 1, L'=');
+                const std::wstring name(entry, equals ? static_cast<size_t>(equals - entry) : wcslen(entry));
+                const bool overridden = std::any_of(overrides.begin(), overrides.end(), [&](const auto& item) {
+                    return _wcsicmp(UTF8ToWString(item.first).c_str(), name.c_str()) == 0;
+                });
+                if (!overridden)
+                    entries.emplace_back(entry);
+            }
+            FreeEnvironmentStringsW(current);
+        }
+        std::sort(entries.begin(), entries.end(), [](const std::wstring& a, const std::wstring& b) {
+            return _wcsicmp(a.c_str(), b.c_str()) < 0;
+        });
+        std::vector<wchar_t> block;
+        for (const auto& entry : entries) {
+            block.insert(block.end(), entry.begin(), entry.end());
+            block.push_back(L'\0');
+        }
+        block.push_back(L'\0');
+        return block;
+    }
+
     // Kill all processes that match the given process name.
     static void Kill(std::wstring_view processName) {
         HANDLE snapshot = CreateToolhelp32Snapshot(TH32CS_SNAPPROCESS, 0);
@@ -146,8 +267,14 @@ public:
                 if (_wcsicmp(pe32.szExeFile, processName.data()) == 0) {
                     HANDLE process = OpenProcess(PROCESS_TERMINATE, FALSE, pe32.th32ProcessID);
                     if (process) {
-                        if (TerminateProcess(process, 0))
+                        if (TerminateProcess(process, 0)) {
                             Log(LogLevel::Info, L"Terminated process: " + std::wstring(processName));
+                            Journal::Instance().Record(JournalEvent::ProcessExit, pe32.th32ProcessID, 1,
+                                WStringToUTF8(std::wstring(processName)));
+                            MetricsRegistry::Instance().GetCounter("owui_process_terminations_total",
+                                "Managed processes terminated by the tool.",
+                                "process=\"" + LabelValue(WStringToUTF8(std::wstring(processName))) + "\"").Add();
+                        }
                         else {
                             DWORD errorCode = GetLastError();
                             Log(LogLevel::Error, L"Failed to terminate process: " + std::wstring(processName) +
@@ -161,9 +288,11 @@ public:
         CloseHandle(snapshot);
     }
 
-    // Execute a command as administrator (using runas verb).
-    static bool ExecuteAsAdmin(const std::wstring& command) {
+    // Execute a command as administrator (using runas verb), waiting up to
+    // `wait` for it to finish.
+    static bool ExecuteAsAdmin(const std::wstring& command, std::chrono::milliseconds wait = 0ms) {
         SHELLEXECUTEINFOW sei{ sizeof(sei) };
+        sei.fMask = wait.count() > 0 ? SEE_MASK_NOCLOSEPROCESS : 0;
         sei.lpVerb = L"runas";
         sei.lpFile = L"powershell.exe";
         sei.lpParameters = command.c_str();
@@ -174,6 +303,11 @@ public:
             return false;
         }
         Log(LogLevel::Info, L"Executed admin command: " + command);
+        if (sei.hProcess) {
+            if (WaitForSingleObject(sei.hProcess, static_cast<DWORD>(wait.count())) == WAIT_TIMEOUT)
+                Log(LogLevel::Warning, L"Admin command still running after " + std::to_wstring(wait.count()) + L" ms.");
+            CloseHandle(sei.hProcess);
+        }
         return true;
     }
 };
@@ -186,8 +320,26 @@ bool WaitForWebUI(const std::wstring& host, INTERNET_PORT port,
     std::chrono::milliseconds interval = 1000ms)
 {
     const auto start = std::chrono::steady_clock::now();
+    const std::string target = WStringToUTF8(L"http://" + host + L":" + std::to_wstring(port) + L"/");
     while (std::chrono::steady_clock::now() - start < timeout)
     {
+        const auto attemptStart = std::chrono::steady_clock::now();
+        DWORD statusCode = 0;
+        TraceSpan span("WebUI probe", "probe");
+        // Journals and traces the attempt with its status (0 if nothing answered).
+        const auto recordProbe = [&] {
+            const auto latency = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - attemptStart);
+            Journal::Instance().Record(JournalEvent::Probe, statusCode, latency.count(), target);
+            MetricsRegistry& metrics = MetricsRegistry::Instance();
+            metrics.GetHistogram("owui_probe_seconds", "Round-trip time of health probes.", "probe=\"webui\"")
+                .Record(static_cast<double>(latency.count()) * 1e-6);
+            metrics.GetCounter("owui_probe_total", "Health probes by outcome.",
+                statusCode == 200 ? "probe=\"webui\",result=\"up\"" : "probe=\"webui\",result=\"down\"").Add();
+            span.Arg("status", statusCode);
+            span.End();
+        };
+
         // Open a WinHTTP session.
         HINTERNET hSession = WinHttpOpen(L"WebUI Checker/1.0", WINHTTP_ACCESS_TYPE_DEFAULT_PROXY,
             WINHTTP_NO_PROXY_NAME, WINHTTP_NO_PROXY_BYPASS, 0);
@@ -208,7 +360,6 @@ bool WaitForWebUI(const std::wstring& host, INTERNET_PORT port,
                     {
                         if (WinHttpReceiveResponse(hRequest, nullptr))
                         {
-                            DWORD statusCode = 0;
                             DWORD size = sizeof(statusCode);
                             // Query the HTTP status code.
                             if (WinHttpQueryHeaders(hRequest, WINHTTP_QUERY_STATUS_CODE | WINHTTP_QUERY_FLAG_NUMBER,
@@ -216,6 +367,7 @@ bool WaitForWebUI(const std::wstring& host, INTERNET_PORT port,
                             {
                                 if (statusCode == 200)
                                 {
+                                    recordProbe();
                                     Log(LogLevel::Info, L"WebUI is up with status code 200.");
                                     WinHttpCloseHandle(hRequest);
                                     WinHttpCloseHandle(hConnect);
@@ -231,6 +383,7 @@ bool WaitForWebUI(const std::wstring& host, INTERNET_PORT port,
             }
             WinHttpCloseHandle(hSession);
         }
+        recordProbe();
         std::this_thread::sleep_for(interval);
     }
     Log(LogLevel::Warning, L"Timed out waiting for WebUI to become available.");
@@ -257,9 +410,46 @@ public:
             std::ifstream file(configPath);
             json j = json::parse(file);
 
+            // Log to a file from here on, so later lines survive the console being hidden.
+            AsyncLogger::Instance().Configure(ParseLogConfig(j.value("log", json::object())));
+
             Config config;
             config.ollamaPath = UTF8ToWString(j.at("ollamaPath").get<std::string>());
             config.dockerPath = UTF8ToWString(j.at("dockerPath").get<std::string>());
+            if (j.contains("proxy"))
+                config.proxy = ParseProxyConfig(j.at("proxy"));
+            if (j.contains("webui"))
+                config.webui = ParseWebUIConfig(j.at("webui"));
+            if (j.contains("ollama")) {
+                const json& ollama = j.at("ollama");
+                config.ollama.environment = ollama.value("environment", config.ollama.environment);
+                config.ollama.numThread = ollama.value("numThread", config.ollama.numThread);
+            }
+            if (j.contains("tune"))
+                config.tune = ParseTuneConfig(j.at("tune"));
+            config.journal = ParseJournalConfig(j.value("journal", json::object()));
+            config.trace = ParseTraceConfig(j.value("trace", json::object()));
+            if (j.contains("metrics")) {
+                const json& metrics = j.at("metrics");
+                config.metrics.enabled = metrics.value("enabled", config.metrics.enabled);
+                config.metrics.listenAddress = metrics.value("listenAddress", config.metrics.listenAddress);
+                config.metrics.listenPort = metrics.value("listenPort", config.metrics.listenPort);
+            }
+            config.history = ParseHistoryConfig(j.value("history", json::object()));
+            config.control = ParseControlConfig(j.value("control", json::object()));
+            if (j.contains("statusPage")) {
+                const json& statusPage = j.at("statusPage");
+                config.statusPage.enabled = statusPage.value("enabled", config.statusPage.enabled);
+                const std::wstring name = UTF8ToWString(statusPage.value("name", std::string()));
+                if (!name.empty())
+                    config.statusPage.name = name;
+            }
+            if (j.contains("processSampler")) {
+                const json& sampler = j.at("processSampler");
+                config.processSampler.enabled = sampler.value("enabled", config.processSampler.enabled);
+                config.processSampler.intervalMs = (std::max)(100, sampler.value("intervalMs", config.processSampler.intervalMs));
+                config.processSampler.rescanMs = sampler.value("rescanMs", config.processSampler.rescanMs);
+            }
 
             Log(LogLevel::Info, L"Checking paths...");
             ValidatePaths(config);
@@ -272,17 +462,55 @@ public:
         }
     }
 
-private:
+    // Replaces the "ollama" block of config.json, leaving the rest as it is.
+    static bool SaveOllamaSettings(const OllamaSettings& settings) {
+        const fs::path configPath = GetExecutablePath() / "config.json";
+        try {
+            json j;
+            {
+                std::ifstream file(configPath);
+                j = json::parse(file);
+            }
+            j["ollama"] = {
+                {"environment", settings.environment},
+                {"numThread", settings.numThread}
+            };
+            std::ofstream ofs(configPath, std::ios::trunc);
+            ofs << j.dump(4);
+            if (!ofs)
+                throw std::runtime_error("Unable to write config file: " + configPath.string());
+            Log(LogLevel::Info, L"Saved Ollama settings to: " + configPath.wstring());
+            return true;
+        }
+        catch (const std::exception& e) {
+            Log(LogLevel::Error, L"Error saving config: " + UTF8ToWString(e.what()));
+            return false;
+        }
+    }
+
     static fs::path GetExecutablePath() {
         wchar_t buffer[MAX_PATH];
         GetModuleFileNameW(nullptr, buffer, MAX_PATH);
         return fs::path(buffer).parent_path();
     }
 
+    // The control settings alone, without logging: for the `ctl` client.
+    static ControlConfig LoadControlConfig() {
+        std::ifstream file(GetExecutablePath() / "config.json");
+        const json j = json::parse(file, nullptr, false);
+        return ParseControlConfig(j.is_object() ? j.value("control", json::object()) : json::object());
+    }
+
+private:
     static void CreateDefaultConfig(const fs::path& path) {
         const json defaultConfig = {
             {"ollamaPath", ""},
-            {"dockerPath", ""}
+            {"dockerPath", ""},
+            {"proxy", {
+                {"enabled", false},
+                {"listenPort", 11435},
+                {"upstreams", {"127.0.0.1:11434"}}
+            }}
         };
 
         std::ofstream ofs(path);
@@ -295,6 +523,162 @@ private:
         Log(LogLevel::Info, L"Please edit config.json and set the following paths:");
         Log(LogLevel::Info, L"- ollamaPath (path to Ollama executable)");
         Log(LogLevel::Info, L"- dockerPath (path to Docker Desktop)");
+        Log(LogLevel::Info, L"Optionally enable \"proxy\" to route WebUI traffic across Ollama instances.");
+    }
+
+    static ProxyConfig ParseProxyConfig(const json& j) {
+        ProxyConfig proxy;
+        proxy.enabled = j.value("enabled", proxy.enabled);
+        proxy.listenAddress = j.value("listenAddress", proxy.listenAddress);
+        proxy.listenPort = j.value("listenPort", proxy.listenPort);
+        proxy.upstreams = j.value("upstreams", proxy.upstreams);
+        proxy.loadFactor = j.value("loadFactor", proxy.loadFactor);
+        proxy.affinityPrefixBytes = j.value("affinityPrefixBytes", proxy.affinityPrefixBytes);
+        proxy.affinityTableSize = j.value("affinityTableSize", proxy.affinityTableSize);
+        proxy.reactors = j.value("reactors", proxy.reactors);
+        proxy.maxBodyBytes = j.value("maxBodyBytes", proxy.maxBodyBytes);
+        proxy.userHeader = j.value("userHeader", proxy.userHeader);
+        if (j.contains("scheduler"))
+            proxy.scheduler = ParseSchedulerConfig(j.at("scheduler"));
+        if (j.contains("hedging")) {
+            const json& hedging = j.at("hedging");
+            proxy.hedging.enabled = hedging.value("enabled", proxy.hedging.enabled);
+            proxy.hedging.quantile = hedging.value("quantile", proxy.hedging.quantile);
+            proxy.hedging.minDelayMs = hedging.value("minDelayMs", proxy.hedging.minDelayMs);
+            proxy.hedging.minSamples = hedging.value("minSamples", proxy.hedging.minSamples);
+        }
+        if (j.contains("coalescing")) {
+            const json& coalescing = j.at("coalescing");
+            proxy.coalescing.delayMs = coalescing.value("delayMs", proxy.coalescing.delayMs);
+            proxy.coalescing.maxBytes = coalescing.value("maxBytes", proxy.coalescing.maxBytes);
+        }
+        if (j.contains("pool"))
+            proxy.pool = ParsePoolConfig(j.at("pool"));
+        return proxy;
+    }
+
+    static WebUIConfig ParseWebUIConfig(const json& j) {
+        WebUIConfig webui;
+        webui.enabled = j.value("enabled", webui.enabled);
+        webui.listenAddress = j.value("listenAddress", webui.listenAddress);
+        webui.listenPort = j.value("listenPort", webui.listenPort);
+        webui.containerPort = j.value("containerPort", webui.containerPort);
+        webui.reactors = j.value("reactors", webui.reactors);
+        webui.maxBodyBytes = j.value("maxBodyBytes", webui.maxBodyBytes);
+        if (j.contains("pool"))
+            webui.pool = ParsePoolConfig(j.at("pool"));
+        if (j.contains("assetCache")) {
+            const json& assets = j.at("assetCache");
+            webui.assets.enabled = assets.value("enabled", webui.assets.enabled);
+            webui.assets.maxBytes = assets.value("maxBytes", webui.assets.maxBytes);
+            webui.assets.maxAssetBytes = assets.value("maxAssetBytes", webui.assets.maxAssetBytes);
+            webui.assets.prefixes = assets.value("prefixes", webui.assets.prefixes);
+        }
+        return webui;
+    }
+
+    static PoolConfig ParsePoolConfig(const json& j) {
+        PoolConfig pool;
+        pool.enabled = j.value("enabled", pool.enabled);
+        pool.maxIdle = j.value("maxIdle", pool.maxIdle);
+        pool.idleTimeoutMs = j.value("idleTimeoutMs", pool.idleTimeoutMs);
+        return pool;
+    }
+
+    static LogConfig ParseLogConfig(const json& j) {
+        LogConfig log;
+        log.console = j.value("console", log.console);
+        const std::string file = j.value("file", std::string("logs/Open WebUI Automation.log"));
+        if (!file.empty()) {
+            const fs::path path(UTF8ToWString(file));
+            log.file = (path.is_absolute() ? path : GetExecutablePath() / path).wstring();
+        }
+        log.maxFileBytes = j.value("maxFileBytes", log.maxFileBytes);
+        log.maxFiles = j.value("maxFiles", log.maxFiles);
+        log.blockWhenFull = j.value("blockWhenFull", log.blockWhenFull);
+        return log;
+    }
+
+    static TraceConfig ParseTraceConfig(const json& j) {
+        TraceConfig trace;
+        trace.enabled = j.value("enabled", trace.enabled);
+        const std::string file = j.value("file", std::string("logs/startup-trace.json"));
+        if (!file.empty()) {
+            const fs::path path(UTF8ToWString(file));
+            trace.file = (path.is_absolute() ? path : GetExecutablePath() / path).wstring();
+        }
+        return trace;
+    }
+
+    static ControlConfig ParseControlConfig(const json& j) {
+        ControlConfig control;
+        control.enabled = j.value("enabled", control.enabled);
+        const std::wstring name = UTF8ToWString(j.value("pipeName", std::string()));
+        if (!name.empty())
+            control.pipeName = name.rfind(L"\\\\.\\pipe\\", 0) == 0 ? name : L"\\\\.\\pipe\\" + name;
+        return control;
+    }
+
+    static HistoryConfig ParseHistoryConfig(const json& j) {
+        HistoryConfig history;
+        history.enabled = j.value("enabled", history.enabled);
+        history.intervalSeconds = (std::max)(1, j.value("intervalSeconds", history.intervalSeconds));
+        history.fullResolutionHours = (std::max)(0, j.value("fullResolutionHours", history.fullResolutionHours));
+        history.downsampleSeconds = (std::max)(1, j.value("downsampleSeconds", history.downsampleSeconds));
+        history.retentionDays = (std::max)(0, j.value("retentionDays", history.retentionDays));
+        history.budgetBytes = j.value("budgetBytes", history.budgetBytes);
+        return history;
+    }
+
+    static JournalConfig ParseJournalConfig(const json& j) {
+        JournalConfig journal;
+        journal.enabled = j.value("enabled", journal.enabled);
+        const fs::path directory(UTF8ToWString(j.value("directory", std::string("journal"))));
+        journal.directory = (directory.is_absolute() ? directory : GetExecutablePath() / directory).wstring();
+        journal.segmentBytes = j.value("segmentBytes", journal.segmentBytes);
+        journal.maxSegments = j.value("maxSegments", journal.maxSegments);
+        return journal;
+    }
+
+    static TuneConfig ParseTuneConfig(const json& j) {
+        TuneConfig tune;
+        tune.target = j.value("target", tune.target);
+        tune.endpoint = j.value("endpoint", tune.endpoint);
+        tune.models = j.value("models", tune.models);
+        tune.prompts = j.value("prompts", tune.prompts);
+        tune.seconds = j.value("seconds", tune.seconds);
+        tune.numPredict = j.value("numPredict", tune.numPredict);
+        tune.p95LatencyMs = j.value("p95LatencyMs", tune.p95LatencyMs);
+        tune.numParallel = j.value("numParallel", tune.numParallel);
+        tune.maxLoadedModels = j.value("maxLoadedModels", tune.maxLoadedModels);
+        tune.flashAttention = j.value("flashAttention", tune.flashAttention);
+        tune.numThread = j.value("numThread", tune.numThread);
+        return tune;
+    }
+
+    static SchedulerConfig ParseSchedulerConfig(const json& j) {
+        SchedulerConfig scheduler;
+        scheduler.enabled = j.value("enabled", scheduler.enabled);
+        scheduler.concurrency = j.value("concurrency", scheduler.concurrency);
+        scheduler.modelConcurrency = j.value("modelConcurrency", scheduler.modelConcurrency);
+        scheduler.priorityHeader = j.value("priorityHeader", scheduler.priorityHeader);
+        scheduler.agingSeconds = (std::max)(1.0, j.value("agingSeconds", scheduler.agingSeconds));
+        scheduler.quantumTokens = (std::max)(1.0, j.value("quantumTokens", scheduler.quantumTokens));
+        scheduler.maxCostTokens = (std::max)(1.0, j.value("maxCostTokens", scheduler.maxCostTokens));
+        scheduler.userWeights = j.value("userWeights", scheduler.userWeights);
+        if (j.contains("classes")) {
+            scheduler.classes.clear();
+            for (const auto& entry : j.at("classes")) {
+                PriorityClass priorityClass;
+                priorityClass.name = entry.at("name").get<std::string>();
+                priorityClass.routes = entry.value("routes", priorityClass.routes);
+                priorityClass.clients = entry.value("clients", priorityClass.clients);
+                priorityClass.header = entry.value("header", priorityClass.header);
+                priorityClass.headerValue = entry.value("headerValue", priorityClass.headerValue);
+                scheduler.classes.push_back(std::move(priorityClass));
+            }
+        }
+        return scheduler;
     }
 
     static void ValidatePaths(const Config& config) {
@@ -312,65 +696,718 @@ private:
     }
 };
 
+// -------------------------
+// Startup phases
+// -------------------------
+// A phase of startup: traced as a span, and exported once it ends as
+// owui_startup_phase_seconds{phase="..."} for the latest start.
+class StartupPhase {
+public:
+    explicit StartupPhase(const char* name)
+        : name_(name), span_(name), start_(std::chrono::steady_clock::now()) {}
+    ~StartupPhase() { End(); }
+
+    StartupPhase(const StartupPhase&) = delete;
+    StartupPhase& operator=(const StartupPhase&) = delete;
+
+    void End() {
+        if (ended_)
+            return;
+        ended_ = true;
+        span_.End();
+        MetricsRegistry::Instance().GetGauge("owui_startup_phase_seconds", "Duration of each phase of the last startup.",
+            "phase=\"" + LabelValue(name_) + "\"")
+            .Set(std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count());
+    }
+
+private:
+    const char* name_;
+    TraceSpan span_;
+    std::chrono::steady_clock::time_point start_;
+    bool ended_ = false;
+};
+
+// Whether something accepts TCP connections on the port (the published
+// container port, for liveness).
+inline bool PortAccepts(uint16_t port) {
+    sockaddr_in address{};
+    return ResolveEndpoint("127.0.0.1:" + std::to_string(port), address) && ConnectTcp(address).Valid();
+}
+
+// The models Ollama at `target` has loaded, from GET /api/ps. False if it
+// did not answer with a model list.
+inline bool OllamaLoadedModels(const std::string& target, std::vector<LoadedModel>& models) {
+    sockaddr_in address{};
+    if (!ResolveEndpoint(target, address))
+        return false;
+    Socket connection = ConnectTcp(address);
+    const std::string request = "GET /api/ps HTTP/1.1\r\nHost: " + target + "\r\nConnection: close\r\n\r\n";
+    if (!connection.Valid() || !connection.SendAll(request))
+        return false;
+    connection.SetReceiveTimeout(2000);
+    std::string buffer;
+    Arena arena;
+    HttpResponseHead response(arena);
+    const size_t headEnd = ReadHeaderBlock(connection, buffer);
+    if (headEnd == 0 || !ParseResponseHead(std::string_view(buffer.data(), headEnd - 4), arena, response) ||
+        response.status != 200)
+        return false;
+    char chunk[16 * 1024];
+    int received;
+    while ((received = connection.Recv(chunk, sizeof(chunk))) > 0)
+        buffer.append(chunk, static_cast<size_t>(received));
+    std::string body;
+    const std::string_view* encoding = FindHeader(response.headers, "Transfer-Encoding");
+    if (encoding && ContainsTokenIgnoreCase(*encoding, "chunked"))
+        ChunkedDecoder().Feed(buffer.data() + headEnd, buffer.size() - headEnd,
+            [&](const char* data, size_t length) { body.append(data, length); });
+    else
+        body = buffer.substr(headEnd);
+    const json list = json::parse(body, nullptr, false);
+    if (!list.is_object() || !list.contains("models") || !list["models"].is_array())
+        return false;
+    models.clear();
+    for (const json& model : list["models"]) {
+        if (model.is_object())
+            models.push_back({ model.value("name", std::string()), model.value("size_vram", uint64_t{ 0 }) });
+    }
+    return true;
+}
+
+// -------------------------
+// Control commands
+// -------------------------
+// Commands a running instance answers on its control pipe, from just after
+// the config is loaded. Status comes from the gauges the monitor loop keeps
+// current, so it scans no processes.
+class ControlCommands {
+public:
+    ControlCommands(const Config& config, HANDLE stopEvent)
+        : config_(config), stopEvent_(stopEvent), started_(std::chrono::steady_clock::now()) {}
+
+    // Called instead of Ready when the instance runs `tune`, which exits
+    // when done; status and open report "tuning" meanwhile.
+    void Tuning() { tuning_.store(true, std::memory_order_release); }
+
+    // Called once startup is done. Until then, status reports "starting",
+    // open leaves the browser to startup and restarts are refused.
+    void Ready(bool proxyRunning, bool frontRunning, uint16_t webPort) {
+        proxyRunning_ = proxyRunning;
+        frontRunning_ = frontRunning;
+        webPort_ = webPort;
+        ready_.store(true, std::memory_order_release);
+    }
+
+    json operator()(const json& request) {
+        const std::string command = request.at("command").get<std::string>();
+        if (command == "status")
+            return Status();
+        if (command == "open")
+            return Open();
+        if (command == "stop") {
+            Log(LogLevel::Info, L"Stop requested on the control pipe.");
+            SetEvent(stopEvent_);
+            return { { "stopping", true } };
+        }
+        if (command == "restart")
+            return Restart(request.value("component", std::string()));
+        if (command == "reload-config")
+            return ReloadConfig();
+        if (command == "metrics")
+            return { { "text", MetricsRegistry::Instance().Render() } };
+        if (command == "history")
+            return History(request);
+        throw std::invalid_argument("unknown command \"" + command +
+            "\"; expected status, open, stop, restart, reload-config, metrics or history");
+    }
+
+private:
+    json Status() const {
+        json status = {
+            { "pid", GetCurrentProcessId() },
+            { "state", State() },
+            { "uptimeSeconds", std::chrono::duration<double>(std::chrono::steady_clock::now() - started_).count() }
+        };
+        if (!ready_.load(std::memory_order_acquire))
+            return status;
+        MetricsRegistry& metrics = MetricsRegistry::Instance();
+        const char* upHelp = "Whether a managed process is running.";
+        const auto up = [](Gauge& gauge) { return gauge.Value() != 0.0; };
+        status.update({
+            { "webUrl", "http://localhost:" + std::to_string(webPort_) + "/" },
+            { "components", {
+                { "docker", { { "up", up(metrics.GetGauge("owui_process_up", upHelp, "process=\"docker\"")) } } },
+                { "ollama", { { "up", up(metrics.GetGauge("owui_process_up", upHelp, "process=\"ollama\"")) } } },
+                { "container", { { "up", up(metrics.GetGauge("owui_container_up",
+                    "Whether the Open WebUI container's published port accepts connections.")) } } },
+                { "proxy", { { "enabled", config_.proxy.enabled }, { "running", proxyRunning_ } } },
+                { "webFront", { { "enabled", config_.webui.enabled }, { "running", frontRunning_ } } }
+            } }
+        });
+        return status;
+    }
+
+    const char* State() const {
+        if (ready_.load(std::memory_order_acquire))
+            return "running";
+        return tuning_.load(std::memory_order_acquire) ? "tuning" : "starting";
+    }
+
+    // Opens the WebUI in the browser, if it is up. During startup, startup
+    // opens it once the WebUI answers; `tune` never starts the WebUI.
+    json Open() const {
+        if (!ready_.load(std::memory_order_acquire))
+            return { { "opened", false }, { "state", State() } };
+        if (MetricsRegistry::Instance().GetGauge("owui_container_up",
+            "Whether the Open WebUI container's published port accepts connections.").Value() == 0.0)
+            return { { "ok", false }, { "opened", false }, { "error", "the WebUI is not accepting connections" } };
+        const std::wstring url = L"http://localhost:" + std::to_wstring(webPort_) + L"/";
+        Log(LogLevel::Info, L"Opening browser (control pipe)...");
+        ShellExecuteW(nullptr, L"open", url.c_str(), nullptr, nullptr, SW_SHOWNORMAL);
+        return { { "opened", true }, { "webUrl", WStringToUTF8(url) } };
+    }
+
+    json Restart(const std::string& component) {
+        if (tuning_.load(std::memory_order_acquire))
+            throw std::invalid_argument("tuning; restarts are left to the tuner");
+        if (!ready_.load(std::memory_order_acquire))
+            throw std::invalid_argument("still starting; try again once startup is done");
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (component == "ollama") {
+            Log(LogLevel::Info, L"Restarting Ollama (control pipe)...");
+            for (const wchar_t* process : { L"ollama app.exe", L"ollama.exe", L"ollama_llama_server.exe" })
+                ProcessManager::Kill(process);
+            const bool started = ProcessManager::Start(config_.ollamaPath, config_.ollama.environment) &&
+                ProcessManager::WaitForAnyProcess({ L"ollama app.exe", L"ollama.exe", L"ollama_llama_server.exe" },
+                    500ms, 10000ms);
+            return { { "ok", started }, { "component", component }, { "running", started } };
+        }
+        if (component == "container") {
+            Log(LogLevel::Info, L"Restarting the Open WebUI container (control pipe)...");
+            const bool restarted = ProcessManager::ExecuteAsAdmin(L"docker restart open-webui", 120000ms);
+            return { { "ok", restarted }, { "component", component } };
+        }
+        throw std::invalid_argument("cannot restart \"" + component + "\"; expected ollama or container");
+    }
+
+    // Logging (applied by Load itself) and tracing change at once; the
+    // Ollama path and settings are used from the next `restart ollama`.
+    // Everything else is read once at startup.
+    json ReloadConfig() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        const Config fresh = ConfigManager::Load();
+        if (!fresh.isValid())
+            return { { "ok", false }, { "error", "config.json could not be loaded; see the log" } };
+        Trace::Instance().Configure(fresh.trace);
+        config_.ollamaPath = fresh.ollamaPath;
+        config_.dockerPath = fresh.dockerPath;
+        config_.ollama = fresh.ollama;
+        config_.trace = fresh.trace;
+        return {
+            { "applied", { "log", "trace", "ollama (from the next restart)" } },
+            { "atNextStart", { "proxy", "webui", "metrics", "history", "processSampler", "journal", "control", "statusPage" } }
+        };
+    }
+
+    static json History(const json& request) {
+        MetricsHistory& history = MetricsHistory::Instance();
+        if (!request.contains("series"))
+            return history.List();
+        const int64_t now = MetricsHistory::Now();
+        const json result = history.Query(request.at("series").get<std::string>(),
+            now - request.value("since", int64_t{ 3600 }), now, request.value("step", int64_t{ 0 }));
+        if (result.is_null())
+            throw std::invalid_argument("no such series");
+        return result;
+    }
+
+    std::mutex mutex_; // one restart or reload at a time
+    Config config_;
+    std::atomic<bool> ready_{ false };
+    std::atomic<bool> tuning_{ false };
+    bool proxyRunning_ = false; // set before ready_
+    bool frontRunning_ = false;
+    uint16_t webPort_ = 3000;
+    HANDLE stopEvent_;
+    std::chrono::steady_clock::time_point started_;
+};
+
+// `ctl <command> [arguments]`: sends one command to the running instance and
+// prints the reply.
+int RunControlClient(const std::vector<std::string>& args) {
+    if (args.empty()) {
+        std::wcout << L"Usage: \"Open WebUI Automation.exe\" ctl <command>\n"
+            << L"  status | open | stop | reload-config | metrics | restart ollama|container\n"
+            << L"  history [series [since-seconds [step-seconds]]]\n";
+        return 1;
+    }
+    json request = { { "command", args[0] } };
+    if (args[0] == "restart" && args.size() > 1)
+        request["component"] = args[1];
+    if (args[0] == "history" && args.size() > 1) {
+        request["series"] = args[1];
+        if (args.size() > 2)
+            request["since"] = std::atoll(args[2].c_str());
+        if (args.size() > 3)
+            request["step"] = std::atoll(args[3].c_str());
+    }
+    const ControlConfig control = ConfigManager::LoadControlConfig();
+    const json reply = SendControlRequest(control.pipeName, request);
+    if (!reply.is_object()) {
+        std::wcerr << L"No running instance answered on " << control.pipeName << L"\n";
+        return 2;
+    }
+    if (reply.contains("text") && reply["text"].is_string())
+        std::cout << reply["text"].get<std::string>();
+    else
+        std::cout << reply.dump(2, ' ', false, json::error_handler_t::replace) << std::endl;
+    return reply.value("ok", false) ? 0 : 1;
+}
+
+// The instance mutex's name. One per session, whatever the pipe name: a
+// second copy would share the status page, the metrics and proxy ports, the
+// WebUI port and the open-webui container.
+constexpr wchar_t kInstanceMutexName[] = L"Local\\open-webui-automation.instance";
+
+// Run instead of startup when another instance holds the instance mutex:
+// asks it to open the browser, or prints its status, and returns at once.
+int HandOffToRunningInstance(const ControlConfig& control, bool tune) {
+    if (tune) {
+        std::wcerr << L"Open WebUI Automation is running; stop it (ctl stop) before tuning.\n";
+        return 1;
+    }
+    if (!control.enabled) {
+        std::wcout << L"Open WebUI Automation is already running.\n";
+        return 0;
+    }
+    // The running instance opens its pipe right after loading its config, so
+    // only a launch racing its very start has to wait for it.
+    AllowSetForegroundWindow(ASFW_ANY); // lets the browser it opens come to the front
+    json reply;
+    for (int attempt = 0; attempt < 40; ++attempt) {
+        reply = SendControlRequest(control.pipeName, { { "command", "open" } }, 250);
+        if (reply.is_object())
+            break;
+        std::this_thread::sleep_for(50ms);
+    }
+    if (!reply.is_object()) {
+        std::wcerr << L"Open WebUI Automation is already running, but did not answer on " << control.pipeName << L"\n";
+        return 1;
+    }
+    if (reply.value("opened", false)) {
+        std::wcout << L"Open WebUI Automation is already running; opened " << UTF8ToWString(reply.value("webUrl", std::string())) << L"\n";
+        return 0;
+    }
+    if (reply.value("state", std::string()) == "starting") {
+        std::wcout << L"Open WebUI Automation is still starting; it opens the browser once the WebUI is up.\n";
+        return 0;
+    }
+    if (reply.value("state", std::string()) == "tuning") {
+        std::wcout << L"Open WebUI Automation is tuning Ollama settings and exits when done; launch it again then.\n";
+        return 0;
+    }
+    const json status = SendControlRequest(control.pipeName, { { "command", "status" } });
+    std::cout << (status.is_object() ? status : reply).dump(2, ' ', false, json::error_handler_t::replace) << std::endl;
+    return 0;
+}
+
+// -------------------------
+// Ollama Tuner
+// -------------------------
+// `tune` restarts the managed Ollama under every combination of server
+// settings in the "tune" block, benchmarks each with the built-in load
+// generator at as many concurrent requests as Ollama runs in parallel, and
+// keeps the one with the highest throughput whose p95 end-to-end latency
+// meets the target. The winner goes into config.json's "ollama" block,
+// which later launches pass to Ollama.
+class OllamaTuner {
+public:
+    static int Run(const Config& config) {
+        const TuneConfig& tune = config.tune;
+        std::vector<int> maxLoadedModels = tune.maxLoadedModels;
+        if (maxLoadedModels.empty()) {
+            maxLoadedModels = { 1 };
+            if (tune.models.size() > 1)
+                maxLoadedModels.push_back(static_cast<int>(tune.models.size()));
+        }
+        std::vector<Candidate> candidates;
+        for (const int parallel : tune.numParallel)
+            for (const int loaded : maxLoadedModels)
+                for (const bool flash : tune.flashAttention)
+                    for (const int threads : tune.numThread)
+                        candidates.push_back({ (std::max)(1, parallel), (std::max)(1, loaded), flash, threads });
+        Log(LogLevel::Info, L"Tuning Ollama: " + std::to_wstring(candidates.size()) + L" configurations, " +
+            std::to_wstring(static_cast<int>(tune.seconds)) + L" s each, p95 target " +
+            std::to_wstring(static_cast<int>(tune.p95LatencyMs)) + L" ms.");
+
+        const Candidate* best = nullptr;
+        const Candidate* fastest = nullptr; // fallback when none meets the target
+        for (Candidate& candidate : candidates) {
+            if (!Measure(config, candidate))
+                continue;
+            if (candidate.p95Ms <= tune.p95LatencyMs && (!best || candidate.throughput > best->throughput))
+                best = &candidate;
+            if (!fastest || candidate.p95Ms < fastest->p95Ms)
+                fastest = &candidate;
+        }
+        StopOllama();
+
+        if (!best) {
+            if (!fastest) {
+                Log(LogLevel::Error, L"No configuration could be benchmarked; config.json was not changed.");
+                return 1;
+            }
+            Log(LogLevel::Warning, L"No configuration met the p95 target; keeping the one with the lowest p95.");
+            best = fastest;
+        }
+        Log(LogLevel::Info, L"Best: " + Describe(*best));
+        OllamaSettings settings;
+        settings.environment = Environment(config, *best);
+        settings.numThread = best->numThread;
+        return ConfigManager::SaveOllamaSettings(settings) ? 0 : 1;
+    }
+
+private:
+    struct Candidate {
+        int numParallel;
+        int maxLoadedModels;
+        bool flashAttention;
+        int numThread;
+        double throughput = 0.0; // output tokens/s (requests/s for embed)
+        double p95Ms = 0.0;
+    };
+
+    // The configured environment with the candidate's settings on top.
+    static std::map<std::string, std::string> Environment(const Config& config, const Candidate& candidate) {
+        std::map<std::string, std::string> environment = config.ollama.environment;
+        environment["OLLAMA_NUM_PARALLEL"] = std::to_string(candidate.numParallel);
+        environment["OLLAMA_MAX_LOADED_MODELS"] = std::to_string(candidate.maxLoadedModels);
+        environment["OLLAMA_FLASH_ATTENTION"] = candidate.flashAttention ? "1" : "0";
+        return environment;
+    }
+
+    static std::wstring Describe(const Candidate& candidate) {
+        wchar_t text[256];
+        swprintf(text, 256, L"parallel=%d maxLoaded=%d flashAttention=%d numThread=%d: %.1f/s, p95 %.0f ms",
+            candidate.numParallel, candidate.maxLoadedModels, candidate.flashAttention ? 1 : 0, candidate.numThread,
+            candidate.throughput, candidate.p95Ms);
+        return text;
+    }
+
+    static void StopOllama() {
+        for (const wchar_t* process : { L"ollama app.exe", L"ollama.exe", L"ollama_llama_server.exe" })
+            ProcessManager::Kill(process);
+    }
+
+    // Restarts Ollama with the candidate's settings and benchmarks it.
+    static bool Measure(const Config& config, Candidate& candidate) {
+        const TuneConfig& tune = config.tune;
+        StopOllama();
+        std::this_thread::sleep_for(1000ms);
+        if (!ProcessManager::Start(config.ollamaPath, Environment(config, candidate)))
+            return false;
+        const auto deadline = std::chrono::steady_clock::now() + 60s;
+        while (!OllamaResponds(tune.target)) {
+            if (std::chrono::steady_clock::now() > deadline) {
+                Log(LogLevel::Warning, L"Ollama did not answer at " + UTF8ToWString(tune.target) + L"; skipping.");
+                return false;
+            }
+            std::this_thread::sleep_for(500ms);
+        }
+
+        LoadOptions options;
+        options.target = tune.target;
+        options.endpoint = tune.endpoint;
+        options.models = tune.models;
+        options.prompts = tune.prompts;
+        options.numThread = candidate.numThread;
+        options.openLoop = false;
+
+        // Load every model first so loading is not measured.
+        options.concurrency = 1;
+        options.numPredict = 1;
+        options.seconds = 600.0;
+        options.maxRequests = tune.models.size();
+        OllamaLoadGenerator(options).Run();
+
+        options.concurrency = candidate.numParallel;
+        options.numPredict = tune.numPredict;
+        options.seconds = tune.seconds;
+        options.maxRequests = 0;
+        const LoadReport report = OllamaLoadGenerator(options).Run();
+        if (report.completed == 0) {
+            Log(LogLevel::Warning, L"No requests completed; skipping.");
+            return false;
+        }
+        candidate.throughput = tune.endpoint == "embed" ? report.RequestsPerSecond() : report.OutputTokensPerSecond();
+        candidate.p95Ms = report.EndToEndQuantileMs(0.95);
+        Log(LogLevel::Info, Describe(candidate));
+        return true;
+    }
+};
+
 // -------------------------
 // Main Application
 // -------------------------
-int main() {
+int main(int argc, char* argv[]) {
+    // Developer tools: `bench <suite>` runs benchmarks and exits.
+    if (argc > 1 && std::string_view(argv[1]) == "bench")
+        return Benchmarks::Run(std::vector<std::string>(argv + 2, argv + argc));
+
+    // `ctl <command>` talks to the running instance over its control pipe.
+    if (argc > 1 && std::string_view(argv[1]) == "ctl")
+        return RunControlClient(std::vector<std::string>(argv + 2, argv + argc));
+
+    // `journal dump [directory]` prints the event journal as JSON and exits.
+    if (argc > 2 && std::string_view(argv[1]) == "journal" && std::string_view(argv[2]) == "dump") {
+        const fs::path directory = argc > 3 ? fs::path(argv[3]) : ConfigManager::GetExecutablePath() / "journal";
+        std::cout << Journal::Dump(directory).dump(2, ' ', false, json::error_handler_t::replace) << std::endl;
+        return 0;
+    }
+
+    // One instance at a time. A second launch hands off to the first before
+    // it loads the config (which logs), scans, probes or launches anything.
+    // The mutex is held until exit.
+    const ControlConfig control = ConfigManager::LoadControlConfig();
+    HANDLE instanceMutex = CreateMutexW(nullptr, FALSE, kInstanceMutexName);
+    if (instanceMutex && GetLastError() == ERROR_ALREADY_EXISTS) {
+        CloseHandle(instanceMutex);
+        return HandOffToRunningInstance(control, argc > 1 && std::string_view(argv[1]) == "tune");
+    }
+
     // Load configuration.
+    StartupPhase startup("startup");
+    StartupPhase loadSpan("load config");
     const Config config = ConfigManager::Load();
+    loadSpan.End();
+    Trace::Instance().Configure(config.trace);
+    Trace::Instance().NameThread("main");
+    // Writes the trace again on the way out, with shutdown included.
+    struct TraceWriter {
+        ~TraceWriter() { Trace::Instance().WriteFile(); }
+    } traceWriter;
     if (!config.isValid()) {
         Log(LogLevel::Error, L"Invalid configuration. Please check config.json");
+        AsyncLogger::Instance().Flush();
         std::cin.get();
         return 1;
     }
 
+    StatusPage& status = StatusPage::Instance();
+    if (config.statusPage.enabled)
+        status.Open(config.statusPage);
+
+    // Answer control commands from here on, so a second launch can hand off
+    // during startup too; `stop` ends the monitoring below.
+    HANDLE stopEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+    ControlCommands controlCommands(config, stopEvent);
+    ControlServer controlServer(config.control, std::ref(controlCommands));
+    if (config.control.enabled)
+        controlServer.Start();
+
+    MetricsServer metricsServer(config.metrics);
+    if (config.metrics.enabled)
+        metricsServer.Start();
+    if (config.history.enabled)
+        MetricsHistory::Instance().Start(config.history);
+    ProcessSampler processSampler(config.processSampler, {
+        { "ollama", { L"ollama app.exe", L"ollama.exe", L"ollama_llama_server.exe" } },
+        { "docker", { L"Docker Desktop.exe", L"com.docker.backend.exe" } },
+        { "wsl", { L"vmmemWSL", L"vmmem", L"wslservice.exe" } }
+    });
+    if (config.processSampler.enabled)
+        processSampler.Start();
+
+    if (config.journal.enabled && !Journal::Instance().Open(config.journal))
+        Log(LogLevel::Warning, L"Could not open the event journal in: " + config.journal.directory);
+
+    // `tune` benchmarks Ollama settings, saves the best and exits.
+    if (argc > 1 && std::string_view(argv[1]) == "tune") {
+        controlCommands.Tuning();
+        return OllamaTuner::Run(config);
+    }
+
     // Start Ollama and wait for one of its processes.
     Log(LogLevel::Info, L"Starting Ollama...");
-    if (!ProcessManager::Start(config.ollamaPath)) {
+    StartupPhase ollamaSpan("start Ollama");
+    if (!ProcessManager::Start(config.ollamaPath, config.ollama.environment)) {
         Log(LogLevel::Error, L"Failed to start Ollama.");
         return 1;
     }
+    ollamaSpan.End();
+    status.SetComponent(OWUI_COMPONENT_OLLAMA, OWUI_STATE_STARTING, 0);
     const std::vector<std::wstring> ollamaProcesses = {
         L"ollama app.exe",
         L"ollama.exe",
         L"ollama_llama_server.exe"
     };
-    ProcessManager::WaitForAnyProcess(ollamaProcesses, 500ms, 10000ms);
+    {
+        StartupPhase span("wait for Ollama process");
+        ProcessManager::WaitForAnyProcess(ollamaProcesses, 500ms, 10000ms);
+    }
+
+    // Start the Ollama proxy so the WebUI can be pointed at it.
+    StartupPhase proxySpan("start Ollama proxy");
+    OllamaProxy proxy(config.proxy);
+    const bool proxyRunning = config.proxy.enabled && proxy.Start();
+    if (config.proxy.enabled && !proxyRunning)
+        Log(LogLevel::Warning, L"Ollama proxy failed to start; WebUI will connect to Ollama directly.");
+    proxySpan.End();
+    status.SetComponent(OWUI_COMPONENT_PROXY,
+        !config.proxy.enabled ? OWUI_STATE_DISABLED : proxyRunning ? OWUI_STATE_UP : OWUI_STATE_DOWN,
+        proxyRunning ? GetCurrentProcessId() : 0);
 
     // Start Docker and wait for its process.
     Log(LogLevel::Info, L"Starting Docker...");
+    StartupPhase dockerSpan("start Docker");
     if (!ProcessManager::Start(config.dockerPath)) {
         Log(LogLevel::Error, L"Failed to start Docker.");
         return 1;
     }
-    ProcessManager::WaitForProcess(L"Docker Desktop.exe", 500ms, 10000ms);
+    dockerSpan.End();
+    status.SetComponent(OWUI_COMPONENT_DOCKER, OWUI_STATE_STARTING, 0);
+    {
+        StartupPhase span("wait for Docker process");
+        ProcessManager::WaitForProcess(L"Docker Desktop.exe", 500ms, 10000ms);
+    }
+
+    // With the WebUI front enabled, it takes the WebUI port and the container
+    // is published on loopback only.
+    StartupPhase frontSpan("start WebUI front");
+    WebUIProxy webFront(config.webui);
+    const bool frontRunning = config.webui.enabled && webFront.Start();
+    if (config.webui.enabled && !frontRunning)
+        Log(LogLevel::Warning, L"WebUI front failed to start; publishing the container directly.");
+    frontSpan.End();
+    status.SetComponent(OWUI_COMPONENT_WEB_FRONT,
+        !config.webui.enabled ? OWUI_STATE_DISABLED : frontRunning ? OWUI_STATE_UP : OWUI_STATE_DOWN,
+        frontRunning ? GetCurrentProcessId() : 0);
+    const uint16_t webPort = frontRunning ? config.webui.listenPort : 3000;
 
     // Start Open WebUI container as admin.
     Log(LogLevel::Info, L"Starting Open WebUI container...");
-    const std::wstring dockerCommand =
-        L"docker run -d -p 3000:8080 --add-host=host.docker.internal:host-gateway "
+    std::wstring dockerCommand = frontRunning ?
+        L"docker run -d -p 127.0.0.1:" + std::to_wstring(config.webui.containerPort) + L":8080 " :
+        std::wstring(L"docker run -d -p 3000:8080 ");
+    dockerCommand += L"--add-host=host.docker.internal:host-gateway ";
+    if (proxyRunning)
+        dockerCommand += L"-e OLLAMA_BASE_URL=http://host.docker.internal:" + std::to_wstring(config.proxy.listenPort) + L" ";
+    dockerCommand +=
         L"-v open-webui:/app/backend/data --name open-webui --restart always "
         L"ghcr.io/open-webui/open-webui:main";
-    ProcessManager::ExecuteAsAdmin(dockerCommand);
+    {
+        // Waits for `docker run -d` itself, which returns once the container is created.
+        StartupPhase span("docker run");
+        ProcessManager::ExecuteAsAdmin(dockerCommand, 120000ms);
+    }
+    status.SetComponent(OWUI_COMPONENT_CONTAINER, OWUI_STATE_STARTING, 0);
+    Journal::Instance().Record(JournalEvent::ContainerState,
+        static_cast<int64_t>(JournalContainerState::Starting), 0, "docker run issued");
 
     // Wait until WebUI is available before opening the browser.
-    if (WaitForWebUI(L"localhost", 3000, 30000ms, 1000ms)) {
+    StartupPhase waitSpan("wait for WebUI");
+    const bool webUIUp = WaitForWebUI(L"localhost", webPort, 30000ms, 1000ms);
+    waitSpan.End();
+    Journal::Instance().Record(JournalEvent::ContainerState,
+        static_cast<int64_t>(webUIUp ? JournalContainerState::Up : JournalContainerState::Unavailable), 0,
+        webUIUp ? "WebUI answered" : "WebUI did not answer in time");
+    status.SetComponent(OWUI_COMPONENT_CONTAINER, webUIUp ? OWUI_STATE_UP : OWUI_STATE_DOWN, 0);
+    if (webUIUp) {
         Log(LogLevel::Info, L"Opening browser...");
-        ShellExecuteW(nullptr, L"open", L"http://localhost:3000/", nullptr, nullptr, SW_SHOWNORMAL);
+        StartupPhase span("open browser");
+        const std::wstring url = L"http://localhost:" + std::to_wstring(webPort) + L"/";
+        ShellExecuteW(nullptr, L"open", url.c_str(), nullptr, nullptr, SW_SHOWNORMAL);
     }
     else {
         Log(LogLevel::Warning, L"WebUI did not become available within the timeout period.");
     }
+    startup.End();
+    status.SetInstanceState(OWUI_STATE_UP);
+    Trace::Instance().WriteFile();
+
+    controlCommands.Ready(proxyRunning, frontRunning, webPort);
 
     // Monitor Docker process.
     Log(LogLevel::Info, L"Monitoring Docker process...");
     ConsoleManager::Hide();
-    while (ProcessManager::IsRunning(L"Docker Desktop.exe")) {
-        std::this_thread::sleep_for(5000ms);
+    MetricsRegistry& metrics = MetricsRegistry::Instance();
+    const char* upHelp = "Whether a managed process is running.";
+    Gauge& dockerUp = metrics.GetGauge("owui_process_up", upHelp, "process=\"docker\"");
+    Gauge& ollamaUp = metrics.GetGauge("owui_process_up", upHelp, "process=\"ollama\"");
+    Gauge& containerUp = metrics.GetGauge("owui_container_up",
+        "Whether the Open WebUI container's published port accepts connections.");
+    const uint16_t containerPort = frontRunning ? config.webui.containerPort : 3000;
+    // Probed directly, not through the proxy, so /api/ps does not show up in
+    // the proxy's request metrics.
+    const std::string ollamaTarget = config.proxy.upstreams.empty() ? "127.0.0.1:11434" : config.proxy.upstreams.front();
+    const std::vector<std::wstring> ollamaByPreference = { L"ollama.exe", L"ollama_llama_server.exe", L"ollama app.exe" };
+    const auto microsecondsSince = [](std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+    };
+    bool stopRequested = false;
+    for (;;) {
+        auto probeStart = std::chrono::steady_clock::now();
+        const DWORD dockerPid = ProcessManager::FindProcessId({ L"Docker Desktop.exe" });
+        status.SetComponent(OWUI_COMPONENT_DOCKER, dockerPid ? OWUI_STATE_UP : OWUI_STATE_DOWN, dockerPid,
+            microsecondsSince(probeStart));
+        dockerUp.Set(dockerPid ? 1.0 : 0.0);
+        if (!dockerPid)
+            break;
+
+        probeStart = std::chrono::steady_clock::now();
+        const DWORD ollamaPid = ProcessManager::FindProcessId(ollamaByPreference);
+        ollamaUp.Set(ollamaPid ? 1.0 : 0.0);
+        // With a process up, the probe is the /api/ps round trip.
+        std::vector<LoadedModel> models;
+        if (ollamaPid) {
+            probeStart = std::chrono::steady_clock::now();
+            OllamaLoadedModels(ollamaTarget, models);
+        }
+        status.SetComponent(OWUI_COMPONENT_OLLAMA, ollamaPid ? OWUI_STATE_UP : OWUI_STATE_DOWN, ollamaPid,
+            microsecondsSince(probeStart));
+        status.SetModels(models);
+
+        probeStart = std::chrono::steady_clock::now();
+        const bool containerAccepts = PortAccepts(containerPort);
+        status.SetComponent(OWUI_COMPONENT_CONTAINER, containerAccepts ? OWUI_STATE_UP : OWUI_STATE_DOWN, 0,
+            microsecondsSince(probeStart));
+        containerUp.Set(containerAccepts ? 1.0 : 0.0);
+        if (WaitForSingleObject(stopEvent, 5000) == WAIT_OBJECT_0) {
+            stopRequested = true;
+            break;
+        }
     }
+    containerUp.Set(0.0);
+    status.SetInstanceState(OWUI_STATE_STOPPING);
     ConsoleManager::Show();
 
-    Log(LogLevel::Info, L"Docker closed, shutting down...");
+    TraceSpan shutdown("shutdown");
+    if (stopRequested) {
+        Log(LogLevel::Info, L"Stop requested, shutting down...");
+        Journal::Instance().Record(JournalEvent::ShutdownStep, 0, 0, "stop Docker Desktop");
+        TraceSpan span("stop Docker Desktop");
+        ProcessManager::Kill(L"Docker Desktop.exe");
+    }
+    else {
+        Log(LogLevel::Info, L"Docker closed, shutting down...");
+        Journal::Instance().Record(JournalEvent::ProcessExit, 0, 0, "Docker Desktop.exe");
+    }
+    Journal::Instance().Record(JournalEvent::ContainerState,
+        static_cast<int64_t>(JournalContainerState::Stopped), 0,
+        stopRequested ? "stopped on request" : "Docker Desktop exited");
+    status.SetComponent(OWUI_COMPONENT_DOCKER, OWUI_STATE_DOWN, 0);
+    status.SetComponent(OWUI_COMPONENT_CONTAINER, OWUI_STATE_DOWN, 0);
+    Journal::Instance().Record(JournalEvent::ShutdownStep, 1, 0, "stop proxies");
+    {
+        TraceSpan span("stop proxies");
+        controlServer.Stop();
+        webFront.Stop();
+        proxy.Stop();
+        processSampler.Stop();
+        MetricsHistory::Instance().Stop();
+    }
+    status.SetComponent(OWUI_COMPONENT_PROXY, config.proxy.enabled ? OWUI_STATE_DOWN : OWUI_STATE_DISABLED, 0);
+    status.SetComponent(OWUI_COMPONENT_WEB_FRONT, config.webui.enabled ? OWUI_STATE_DOWN : OWUI_STATE_DISABLED, 0);
 
     // Kill all Ollama-related processes.
     const std::vector<std::wstring> processesToKill = {
@@ -378,15 +1415,28 @@ int main() {
         L"ollama.exe",
         L"ollama_llama_server.exe"
     };
-    for (const auto& process : processesToKill) {
-        ProcessManager::Kill(process);
+    Journal::Instance().Record(JournalEvent::ShutdownStep, 2, 0, "kill Ollama");
+    {
+        TraceSpan span("kill Ollama");
+        for (const auto& process : processesToKill) {
+            ProcessManager::Kill(process);
+        }
     }
+    status.SetComponent(OWUI_COMPONENT_OLLAMA, OWUI_STATE_DOWN, 0);
+    status.SetModels({});
 
     // Shut down WSL.
     Log(LogLevel::Info, L"Shutting down WSL...");
-    ProcessManager::ExecuteAsAdmin(L"wsl --shutdown");
+    Journal::Instance().Record(JournalEvent::ShutdownStep, 3, 0, "wsl --shutdown");
+    {
+        TraceSpan span("wsl --shutdown");
+        ProcessManager::ExecuteAsAdmin(L"wsl --shutdown");
+    }
+    shutdown.End();
 
     Log(LogLevel::Info, L"Shutdown process completed.");
+    Journal::Instance().Record(JournalEvent::ShutdownStep, 4, 0, "completed");
+    status.Close();
     std::this_thread::sleep_for(2000ms);
 
     return 0;
@@ -0,0 +1,213 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "JsonScan.h"
+
+// -------------------------
+// Prompt prefix hashing
+// -------------------------
+// Ollama can only reuse its KV cache when a follow-up turn reaches the runner
+// that evaluated the earlier turns. A request's prompt is hashed with a rolling
+// FNV-1a over its leading bytes, and the running hash is snapshotted at every
+// message boundary ("checkpoint"). Turn N+1 of a conversation repeats all of
+// turn N's checkpoints, so the longest checkpoint already seen identifies the
+// instance that holds the prefix.
+
+struct PrefixCheckpoint {
+    uint64_t hash;
+    size_t bytes; // prompt bytes covered by this checkpoint
+};
+
+constexpr uint64_t kFnvOffset = 14695981039346656037ull;
+constexpr uint64_t kFnvPrime = 1099511628211ull;
+
+inline uint64_t Fnv1a(std::string_view data, uint64_t hash = kFnvOffset) {
+    for (const char c : data) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= kFnvPrime;
+    }
+    return hash;
+}
+
+// Finalizer from SplitMix64; spreads FNV output evenly around the ring.
+inline uint64_t Mix64(uint64_t x) {
+    x ^= x >> 30; x *= 0xbf58476d1ce4e5b9ull;
+    x ^= x >> 27; x *= 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+}
+
+// Computes checkpoints for /api/chat style `messages` arrays (one per message)
+// and /api/generate style `prompt` strings (one per `blockBytes`). Hashing
+// stops after `maxBytes` so huge prompts cost a bounded amount of work.
+inline std::vector<PrefixCheckpoint> ComputePrefixCheckpoints(std::string_view body, std::string_view model,
+    size_t maxBytes, size_t blockBytes = 256)
+{
+    std::vector<PrefixCheckpoint> checkpoints;
+    uint64_t hash = Fnv1a(model);
+
+    const std::string_view messages = JsonScan::FindField(body, "messages");
+    if (messages.size() >= 2 && messages.front() == '[') {
+        // Hash array contents without the closing bracket so that an earlier
+        // turn's array is a byte prefix of the next turn's array.
+        size_t pos = 1;
+        while (pos < messages.size()) {
+            pos = JsonScan::SkipWhitespace(messages, pos);
+            if (pos >= messages.size() || messages[pos] == ']')
+                break;
+            const size_t end = (std::min)(JsonScan::SkipValue(messages, pos), maxBytes + 1);
+            if (end > maxBytes)
+                break;
+            hash = Fnv1a(messages.substr(pos, end - pos), hash);
+            checkpoints.push_back({ hash, end - 1 });
+            pos = JsonScan::SkipWhitespace(messages, end);
+            if (pos < messages.size() && messages[pos] == ',')
+                ++pos;
+        }
+        return checkpoints;
+    }
+
+    const std::string_view prompt = JsonScan::Unquote(JsonScan::FindField(body, "prompt"));
+    const size_t limit = (std::min)(prompt.size(), maxBytes);
+    for (size_t offset = 0; offset + blockBytes <= limit; offset += blockBytes) {
+        hash = Fnv1a(prompt.substr(offset, blockBytes), hash);
+        checkpoints.push_back({ hash, offset + blockBytes });
+    }
+    return checkpoints;
+}
+
+// -------------------------
+// Bounded-load consistent hashing
+// -------------------------
+// Consistent hashing with bounded loads (Mirrokni, Thorup, Zadimoghaddam):
+// walk clockwise from the key and take the first instance whose in-flight
+// count is below ceil(loadFactor * (total + 1) / instances).
+class ConsistentHashRing {
+public:
+    ConsistentHashRing(const std::vector<std::string>& nodes, int virtualNodes = 100) : nodeCount_(nodes.size()) {
+        for (size_t node = 0; node < nodes.size(); ++node) {
+            for (int replica = 0; replica < virtualNodes; ++replica)
+                points_.emplace_back(Mix64(Fnv1a(nodes[node] + "#" + std::to_string(replica))), node);
+        }
+        std::sort(points_.begin(), points_.end());
+    }
+
+    static int Capacity(const std::vector<int>& loads, double loadFactor) {
+        int total = 0;
+        for (const int load : loads) total += load;
+        const double bound = loadFactor * static_cast<double>(total + 1) / static_cast<double>(loads.size());
+        return (std::max)(1, static_cast<int>(bound + 0.999999));
+    }
+
+    size_t Pick(uint64_t key, const std::vector<int>& loads, double loadFactor) const {
+        const int capacity = Capacity(loads, loadFactor);
+        const uint64_t position = Mix64(key);
+        auto it = std::lower_bound(points_.begin(), points_.end(), std::make_pair(position, size_t{ 0 }));
+        for (size_t step = 0; step < points_.size(); ++step, ++it) {
+            if (it == points_.end())
+                it = points_.begin();
+            if (loads[it->second] < capacity)
+                return it->second;
+        }
+        return points_.empty() ? 0 : points_.front().second;
+    }
+
+    size_t NodeCount() const { return nodeCount_; }
+
+private:
+    size_t nodeCount_;
+    std::vector<std::pair<uint64_t, size_t>> points_;
+};
+
+// -------------------------
+// Prefix router
+// -------------------------
+// Remembers which instance last received each checkpoint (LRU-bounded) and
+// routes a request to the instance holding its longest known prefix, as long
+// as that instance is within the load bound. Otherwise the ring decides, keyed
+// by the conversation's opening messages so that the choice stays stable.
+class PrefixRouter {
+public:
+    enum class Result { Hit, Miss, Diverted };
+
+    struct Decision {
+        size_t upstream = 0;
+        Result result = Result::Miss;
+        size_t cachedBytes = 0; // prefix bytes expected to be in the chosen instance's cache
+    };
+
+    PrefixRouter(const std::vector<std::string>& nodes, double loadFactor, size_t tableCapacity)
+        : ring_(nodes), loadFactor_(loadFactor), tableCapacity_(tableCapacity) {}
+
+    Decision Route(const std::vector<PrefixCheckpoint>& checkpoints, uint64_t fallbackKey, const std::vector<int>& loads) {
+        Decision decision;
+        // The opening messages (often a system prompt shared by every chat)
+        // say little about which conversation this is, so table lookups stop
+        // at the checkpoint the ring is keyed on.
+        const size_t keyIndex = checkpoints.empty() ? 0 : (std::min)(checkpoints.size() - 1, size_t{ 1 });
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        for (size_t i = checkpoints.size(); i > keyIndex; --i) {
+            const auto found = table_.find(checkpoints[i - 1].hash);
+            if (found == table_.end())
+                continue;
+            const size_t owner = found->second->second;
+            if (loads[owner] < ConsistentHashRing::Capacity(loads, loadFactor_)) {
+                decision.upstream = owner;
+                decision.result = Result::Hit;
+                decision.cachedBytes = checkpoints[i - 1].bytes;
+            }
+            else {
+                decision.result = Result::Diverted;
+            }
+            break;
+        }
+
+        if (decision.result != Result::Hit) {
+            const uint64_t key = checkpoints.empty() ? fallbackKey : checkpoints[keyIndex].hash;
+            decision.upstream = ring_.Pick(key, loads, loadFactor_);
+        }
+
+        for (const auto& checkpoint : checkpoints)
+            Remember(checkpoint.hash, decision.upstream);
+        return decision;
+    }
+
+    // Re-points checkpoints at another instance, e.g. when a hedged duplicate
+    // ended up serving the request.
+    void Record(const std::vector<PrefixCheckpoint>& checkpoints, size_t upstream) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto& checkpoint : checkpoints)
+            Remember(checkpoint.hash, upstream);
+    }
+
+private:
+    void Remember(uint64_t hash, size_t upstream) {
+        const auto found = table_.find(hash);
+        if (found != table_.end()) {
+            found->second->second = upstream;
+            lru_.splice(lru_.begin(), lru_, found->second);
+            return;
+        }
+        lru_.emplace_front(hash, upstream);
+        table_.emplace(hash, lru_.begin());
+        if (table_.size() > tableCapacity_) {
+            table_.erase(lru_.back().first);
+            lru_.pop_back();
+        }
+    }
+
+    ConsistentHashRing ring_;
+    double loadFactor_;
+    size_t tableCapacity_;
+    std::mutex mutex_;
+    std::list<std::pair<uint64_t, size_t>> lru_;
+    std::unordered_map<uint64_t, std::list<std::pair<uint64_t, size_t>>::iterator> table_;
+};
@@ -0,0 +1,287 @@
+#pragma once
+
+#include <winsock2.h>
+#include <windows.h>
+#include <psapi.h>
+#include <tlhelp32.h>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Common.h"
+#include "Metrics.h"
+
+// -------------------------
+// Process sampler configuration
+// -------------------------
+struct ProcessSamplerConfig {
+    bool enabled = true;
+    int intervalMs = 1000; // how often CPU, memory and I/O are read
+    int rescanMs = 5000;   // how often the process list is walked for new processes
+};
+
+// A group of processes reported together: every process whose executable is
+// one of `roots`, plus all of their descendants.
+struct ProcessComponent {
+    std::string name; // the `component` label
+    std::vector<std::wstring> roots;
+};
+
+// -------------------------
+// Process sampler
+// -------------------------
+// Reports CPU, memory and I/O for each component's process tree. Processes
+// are found with a Toolhelp snapshot only every rescanMs, or as soon as a
+// tracked one exits; in between, each tick reads GetProcessTimes,
+// GetProcessMemoryInfo and GetProcessIoCounters through handles kept open
+// (which also pin the process id, so it cannot be reused under us). Per
+// component it publishes:
+//   owui_component_cpu_seconds_total, owui_component_io_read_bytes_total and
+//   owui_component_io_write_bytes_total (counters), and
+//   owui_component_cpu_cores, owui_component_resident_bytes,
+//   owui_component_private_bytes and owui_component_processes (gauges),
+// which the metrics endpoint and the history pick up from the registry.
+class ProcessSampler {
+public:
+    ProcessSampler(ProcessSamplerConfig config, std::vector<ProcessComponent> components)
+        : config_(config)
+    {
+        MetricsRegistry& registry = MetricsRegistry::Instance();
+        for (auto& component : components) {
+            const std::string labels = "component=\"" + LabelValue(component.name) + "\"";
+            Component entry;
+            entry.roots = std::move(component.roots);
+            entry.cpuSeconds = &registry.GetCounter("owui_component_cpu_seconds_total",
+                "CPU time used by a component's processes (user and kernel).", labels);
+            entry.readBytes = &registry.GetCounter("owui_component_io_read_bytes_total",
+                "Bytes read by a component's processes (file, network and device I/O).", labels);
+            entry.writeBytes = &registry.GetCounter("owui_component_io_write_bytes_total",
+                "Bytes written by a component's processes (file, network and device I/O).", labels);
+            entry.cpuCores = &registry.GetGauge("owui_component_cpu_cores",
+                "CPU used by a component over the last interval, in cores.", labels);
+            entry.residentBytes = &registry.GetGauge("owui_component_resident_bytes",
+                "Working set of a component's processes.", labels);
+            entry.privateBytes = &registry.GetGauge("owui_component_private_bytes",
+                "Private committed memory of a component's processes.", labels);
+            entry.processes = &registry.GetGauge("owui_component_processes",
+                "Processes in a component's tree.", labels);
+            components_.push_back(std::move(entry));
+        }
+    }
+
+    ~ProcessSampler() { Stop(); }
+
+    ProcessSampler(const ProcessSampler&) = delete;
+    ProcessSampler& operator=(const ProcessSampler&) = delete;
+
+    void Start() {
+        Stop();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = false;
+        }
+        thread_ = std::thread([this] { Run(); });
+    }
+
+    void Stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        wake_.notify_all();
+        if (thread_.joinable())
+            thread_.join();
+        for (auto& [pid, process] : processes_)
+            CloseHandle(process.handle);
+        processes_.clear();
+    }
+
+    // Reads every tracked process once, rescanning first if it is time to.
+    void Sample() {
+        const auto now = std::chrono::steady_clock::now();
+        if (rescanNeeded_ || now >= nextRescan_) {
+            Rescan();
+            nextRescan_ = now + std::chrono::milliseconds((std::max)(config_.intervalMs, config_.rescanMs));
+            rescanNeeded_ = false;
+        }
+        const double elapsed = lastSample_.time_since_epoch().count() ?
+            std::chrono::duration<double>(now - lastSample_).count() : 0.0;
+        lastSample_ = now;
+
+        std::vector<Totals> totals(components_.size());
+        for (auto it = processes_.begin(); it != processes_.end();) {
+            Process& process = it->second;
+            // An exited process still reports its final CPU and I/O totals.
+            const bool exited = WaitForSingleObject(process.handle, 0) == WAIT_OBJECT_0;
+            Totals& total = totals[process.component];
+            FILETIME creation, exit, kernel, user;
+            if (GetProcessTimes(process.handle, &creation, &exit, &kernel, &user)) {
+                const uint64_t cpu = FileTimeTicks(kernel) + FileTimeTicks(user);
+                total.cpuTicks += cpu - (std::min)(cpu, process.cpuTicks);
+                process.cpuTicks = cpu;
+            }
+            IO_COUNTERS io{};
+            if (GetProcessIoCounters(process.handle, &io)) {
+                total.readBytes += io.ReadTransferCount - (std::min)(io.ReadTransferCount, process.readBytes);
+                total.writeBytes += io.WriteTransferCount - (std::min)(io.WriteTransferCount, process.writeBytes);
+                process.readBytes = io.ReadTransferCount;
+                process.writeBytes = io.WriteTransferCount;
+            }
+            if (exited) {
+                CloseHandle(process.handle);
+                it = processes_.erase(it);
+                rescanNeeded_ = true;
+                continue;
+            }
+            ++total.processes;
+            PROCESS_MEMORY_COUNTERS_EX memory{};
+            memory.cb = sizeof(memory);
+            if (GetProcessMemoryInfo(process.handle, reinterpret_cast<PROCESS_MEMORY_COUNTERS*>(&memory), sizeof(memory))) {
+                total.residentBytes += memory.WorkingSetSize;
+                total.privateBytes += memory.PrivateUsage;
+            }
+            ++it;
+        }
+
+        for (size_t i = 0; i < components_.size(); ++i) {
+            const Component& component = components_[i];
+            const Totals& total = totals[i];
+            const double cpuSeconds = static_cast<double>(total.cpuTicks) / 1e7;
+            component.cpuSeconds->Add(cpuSeconds);
+            component.readBytes->Add(static_cast<double>(total.readBytes));
+            component.writeBytes->Add(static_cast<double>(total.writeBytes));
+            if (elapsed > 0.0)
+                component.cpuCores->Set(cpuSeconds / elapsed);
+            component.residentBytes->Set(static_cast<double>(total.residentBytes));
+            component.privateBytes->Set(static_cast<double>(total.privateBytes));
+            component.processes->Set(static_cast<double>(total.processes));
+        }
+    }
+
+private:
+    struct Component {
+        std::vector<std::wstring> roots;
+        Counter* cpuSeconds;
+        Counter* readBytes;
+        Counter* writeBytes;
+        Gauge* cpuCores;
+        Gauge* residentBytes;
+        Gauge* privateBytes;
+        Gauge* processes;
+    };
+
+    struct Process {
+        HANDLE handle;
+        size_t component;
+        // Readings as of the last sample, or of discovery: usage before the
+        // sampler saw the process is not counted.
+        uint64_t cpuTicks = 0;
+        uint64_t readBytes = 0;
+        uint64_t writeBytes = 0;
+    };
+
+    struct Totals {
+        uint64_t cpuTicks = 0;
+        uint64_t readBytes = 0;
+        uint64_t writeBytes = 0;
+        uint64_t residentBytes = 0;
+        uint64_t privateBytes = 0;
+        size_t processes = 0;
+    };
+
+    static uint64_t FileTimeTicks(const FILETIME& time) {
+        return (static_cast<uint64_t>(time.dwHighDateTime) << 32) | time.dwLowDateTime;
+    }
+
+    // Opens a handle to each process in a component tree that is not yet
+    // tracked. Processes that cannot be opened (protected, or already gone)
+    // are skipped until the next rescan.
+    void Rescan() {
+        HANDLE snapshot = CreateToolhelp32Snapshot(TH32CS_SNAPPROCESS, 0);
+        if (snapshot == INVALID_HANDLE_VALUE)
+            return;
+        struct Entry {
+            DWORD pid;
+            DWORD parent;
+            std::wstring exe;
+        };
+        std::vector<Entry> entries;
+        PROCESSENTRY32W pe32{};
+        pe32.dwSize = sizeof(pe32);
+        if (Process32FirstW(snapshot, &pe32)) {
+            do {
+                entries.push_back({ pe32.th32ProcessID, pe32.th32ParentProcessID, pe32.szExeFile });
+            } while (Process32NextW(snapshot, &pe32));
+        }
+        CloseHandle(snapshot);
+
+        for (size_t component = 0; component < components_.size(); ++component) {
+            std::set<DWORD> tree;
+            for (const Entry& entry : entries) {
+                for (const std::wstring& root : components_[component].roots) {
+                    if (_wcsicmp(entry.exe.c_str(), root.c_str()) == 0)
+                        tree.insert(entry.pid);
+                }
+            }
+            // Descendants, a generation per pass. A reused parent id can make
+            // an unrelated process look like a child; a Docker or Ollama tree
+            // is a few levels deep, so the passes are capped.
+            for (int depth = 0; depth < 8; ++depth) {
+                const size_t before = tree.size();
+                for (const Entry& entry : entries) {
+                    if (entry.pid != 0 && tree.count(entry.parent))
+                        tree.insert(entry.pid);
+                }
+                if (tree.size() == before)
+                    break;
+            }
+            for (const DWORD pid : tree) {
+                if (processes_.count(pid))
+                    continue;
+                HANDLE handle = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION | PROCESS_VM_READ | SYNCHRONIZE, FALSE, pid);
+                if (!handle)
+                    handle = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION | SYNCHRONIZE, FALSE, pid);
+                if (!handle)
+                    continue;
+                Process process{ handle, component };
+                FILETIME creation, exit, kernel, user;
+                if (GetProcessTimes(handle, &creation, &exit, &kernel, &user))
+                    process.cpuTicks = FileTimeTicks(kernel) + FileTimeTicks(user);
+                IO_COUNTERS io{};
+                if (GetProcessIoCounters(handle, &io)) {
+                    process.readBytes = io.ReadTransferCount;
+                    process.writeBytes = io.WriteTransferCount;
+                }
+                processes_.emplace(pid, process);
+            }
+        }
+    }
+
+    void Run() {
+        auto next = std::chrono::steady_clock::now();
+        for (;;) {
+            Sample();
+            std::unique_lock<std::mutex> lock(mutex_);
+            next += std::chrono::milliseconds((std::max)(100, config_.intervalMs));
+            if (wake_.wait_until(lock, next, [this] { return stopping_; }))
+                return;
+        }
+    }
+
+    ProcessSamplerConfig config_;
+    std::vector<Component> components_;
+    std::map<DWORD, Process> processes_; // sampler thread only
+    bool rescanNeeded_ = true;
+    std::chrono::steady_clock::time_point nextRescan_{};
+    std::chrono::steady_clock::time_point lastSample_{};
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    bool stopping_ = false;
+    std::thread thread_;
+};
@@ -0,0 +1,222 @@
+#pragma once
+
+#include <winsock2.h>
+#include <windows.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <utility>
+#include "BufferPool.h"
+#include "Net.h"
+
+// -------------------------
+// Body relaying
+// -------------------------
+// Windows has no socket-to-socket splice (TransmitFile only sends from file
+// handles), so the cheapest relay is one read and one write per buffer. When
+// the proxy does not need to look at a body it is passed through with its
+// framing intact: no decoding, no re-chunking, one pooled buffer per stream.
+enum class RelayStatus { Complete, UpstreamFailed, ClientGone };
+
+// Returned by Recv-like sources that also watch the other peer, when that
+// peer has gone away.
+constexpr int kRecvPeerGone = -2;
+
+// Returned by sources that take a wait limit when nothing arrived in time.
+constexpr int kRecvTimedOut = -3;
+
+enum class BodyFraming { None, Length, Chunked, UntilClose };
+
+// Forwards a response body from `source` to `destination` byte for byte.
+// `pending` holds body bytes already read with the head. Chunked bodies are
+// only scanned for their final chunk so the connection can be reused.
+template <typename Source>
+RelayStatus RelayPassThrough(Source& source, Socket& destination, std::string_view pending,
+    BodyFraming framing, uint64_t contentLength)
+{
+    if (framing == BodyFraming::None)
+        return RelayStatus::Complete;
+    ChunkedDecoder decoder;
+    uint64_t remaining = contentLength;
+    bool done = framing == BodyFraming::Length && remaining == 0;
+
+    // Forwards the part of `data` that belongs to the body; returns whether the body is complete.
+    auto forward = [&](const char* data, size_t length, bool& sent) {
+        size_t take = length;
+        if (framing == BodyFraming::Chunked)
+            take = decoder.Feed(data, length, [](const char*, size_t) {});
+        else if (framing == BodyFraming::Length)
+            take = static_cast<size_t>((std::min)(remaining, static_cast<uint64_t>(length)));
+        remaining -= framing == BodyFraming::Length ? take : 0;
+        sent = destination.SendAll(data, take);
+        return framing == BodyFraming::Chunked ? decoder.Done() :
+            framing == BodyFraming::Length && remaining == 0;
+    };
+
+    bool sent = true;
+    if (!done && !pending.empty())
+        done = forward(pending.data(), pending.size(), sent);
+    if (!sent)
+        return RelayStatus::ClientGone;
+    if (decoder.Failed())
+        return RelayStatus::UpstreamFailed;
+
+    PooledBuffer buffer;
+    while (!done) {
+        const int received = source.Recv(buffer.Data(), buffer.Size());
+        if (received == kRecvPeerGone)
+            return RelayStatus::ClientGone;
+        if (received < 0)
+            return RelayStatus::UpstreamFailed;
+        if (received == 0)
+            return framing == BodyFraming::UntilClose ? RelayStatus::Complete : RelayStatus::UpstreamFailed;
+        done = forward(buffer.Data(), static_cast<size_t>(received), sent);
+        if (!sent)
+            return RelayStatus::ClientGone;
+        if (decoder.Failed())
+            return RelayStatus::UpstreamFailed;
+    }
+    return RelayStatus::Complete;
+}
+
+// -------------------------
+// Chunk coalescing
+// -------------------------
+// Ollama writes one NDJSON line per token, and relayed as they come each
+// line is its own send and (with Nagle off) its own packet. The coalescer
+// holds small writes for up to `delayMs`, or until `maxBytes` have gathered,
+// and sends them as one chunk. A write that follows the previous send by
+// more than `delayMs` goes out at once: the first token (so time to first
+// token is unchanged) and every token of a stream too slow to batch. A
+// `delayMs` of 0 sends every write.
+class ChunkCoalescer {
+public:
+    ChunkCoalescer(Socket& destination, bool chunked, int delayMs, size_t maxBytes)
+        : destination_(destination), chunked_(chunked), delay_(std::chrono::milliseconds((std::max)(0, delayMs))),
+          maxBytes_((std::min)(maxBytes, BufferPool::kBufferSize)) {}
+    ~ChunkCoalescer() {
+        if (hold_)
+            BufferPool::Instance().Release(std::move(hold_));
+    }
+
+    ChunkCoalescer(const ChunkCoalescer&) = delete;
+    ChunkCoalescer& operator=(const ChunkCoalescer&) = delete;
+
+    // Returns false once the destination can no longer be written to.
+    bool Write(const char* data, size_t length) {
+        if (length == 0)
+            return true;
+        ++writes_;
+        const auto now = std::chrono::steady_clock::now();
+        if (delay_.count() == 0 || (held_ == 0 && (sends_ == 0 || now - lastSend_ >= delay_)))
+            return Send(data, length);
+        if (held_ + length > maxBytes_ && !Flush())
+            return false;
+        if (length >= maxBytes_)
+            return Send(data, length);
+        if (!hold_)
+            hold_ = BufferPool::Instance().Acquire();
+        if (held_ == 0)
+            heldSince_ = now;
+        std::memcpy(hold_.get() + held_, data, length);
+        held_ += length;
+        return held_ >= maxBytes_ || now - heldSince_ >= delay_ ? Flush() : true;
+    }
+
+    // Sends whatever is held.
+    bool Flush() {
+        if (held_ == 0)
+            return true;
+        const size_t length = std::exchange(held_, 0);
+        return Send(hold_.get(), length);
+    }
+
+    // Sends what is held and, for a chunked body, the last chunk, in one write.
+    bool Finish() {
+        if (!chunked_)
+            return Flush();
+        char sizeLine[32];
+        const int sizeLength = held_ ? snprintf(sizeLine, sizeof(sizeLine), "%zx\r\n", held_) : 0;
+        char tail[] = "\r\n0\r\n\r\n";
+        WSABUF pieces[3] = {
+            { static_cast<ULONG>(sizeLength), sizeLine },
+            { static_cast<ULONG>(held_), hold_.get() },
+            { held_ ? 7u : 5u, held_ ? tail : tail + 2 }
+        };
+        ++sends_;
+        lastSend_ = std::chrono::steady_clock::now();
+        const bool sent = held_ ? destination_.SendAll(pieces, 3) : destination_.SendAll(pieces + 2, 1);
+        held_ = 0;
+        return sent;
+    }
+
+    // Milliseconds until held bytes are due out, or -1 when nothing is held.
+    int DueInMs() const {
+        if (held_ == 0)
+            return -1;
+        const auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+            heldSince_ + delay_ - std::chrono::steady_clock::now());
+        return left.count() > 0 ? static_cast<int>(left.count()) : 0;
+    }
+
+    uint64_t Writes() const { return writes_; } // what an uncoalesced relay would have sent
+    uint64_t Sends() const { return sends_; }
+
+private:
+    bool Send(const char* data, size_t length) {
+        ++sends_;
+        lastSend_ = std::chrono::steady_clock::now();
+        return chunked_ ? SendChunk(destination_, data, length) : destination_.SendAll(data, length);
+    }
+
+    Socket& destination_;
+    bool chunked_;
+    std::chrono::milliseconds delay_;
+    size_t maxBytes_;
+    std::unique_ptr<char[]> hold_;
+    size_t held_ = 0;
+    std::chrono::steady_clock::time_point heldSince_;
+    std::chrono::steady_clock::time_point lastSend_;
+    uint64_t writes_ = 0;
+    uint64_t sends_ = 0;
+};
+
+// Pumps bytes both ways between two connections (an upgraded WebSocket)
+// until both directions have closed, either side fails, or nothing moves for
+// `idleTimeoutMs`. A close in one direction is passed on as a half-close.
+inline void Tunnel(Socket& a, Socket& b, int idleTimeoutMs) {
+    PooledBuffer buffer;
+    bool aOpen = true;
+    bool bOpen = true;
+    while (aOpen || bOpen) {
+        WSAPOLLFD fds[2];
+        ULONG count = 0;
+        if (aOpen)
+            fds[count++] = { a.Get(), POLLRDNORM, 0 };
+        if (bOpen)
+            fds[count++] = { b.Get(), POLLRDNORM, 0 };
+        if (WSAPoll(fds, count, idleTimeoutMs) <= 0)
+            return;
+        for (ULONG i = 0; i < count; ++i) {
+            if (fds[i].revents == 0)
+                continue;
+            const bool fromA = fds[i].fd == a.Get();
+            Socket& from = fromA ? a : b;
+            Socket& to = fromA ? b : a;
+            const int received = from.Recv(buffer.Data(), buffer.Size());
+            if (received < 0)
+                return;
+            if (received == 0) {
+                shutdown(to.Get(), SD_SEND);
+                (fromA ? aOpen : bOpen) = false;
+                continue;
+            }
+            if (!to.SendAll(buffer.Data(), static_cast<size_t>(received)))
+                return;
+        }
+    }
+}
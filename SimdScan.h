@@ -0,0 +1,249 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define SIMD_SCAN_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+// MSVC accepts AVX2 intrinsics in any function; GCC and Clang need the
+// function itself compiled for the target.
+#if defined(SIMD_SCAN_X86) && !defined(_MSC_VER)
+#define SIMD_SCAN_AVX2 __attribute__((target("avx2")))
+#else
+#define SIMD_SCAN_AVX2
+#endif
+
+// -------------------------
+// SIMD byte scanning
+// -------------------------
+// The few byte searches the JSON and NDJSON scanners spend their time in,
+// 32 bytes at a time with AVX2, 16 with SSE2, or one at a time elsewhere.
+// The widest level the CPU supports is picked on first use; SetLevel forces
+// a narrower one (benchmarks compare them).
+namespace SimdScan {
+
+enum class Level { Scalar, Sse2, Avx2 };
+
+inline Level DetectLevel() {
+#if defined(SIMD_SCAN_X86) && defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+        return Level::Sse2;
+    __cpuid(info, 1);
+    const bool osxsave = (info[2] & (1 << 27)) != 0;
+    const bool avx = (info[2] & (1 << 28)) != 0;
+    if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6)
+        return Level::Sse2;
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) ? Level::Avx2 : Level::Sse2;
+#elif defined(SIMD_SCAN_X86)
+    return __builtin_cpu_supports("avx2") ? Level::Avx2 : Level::Sse2;
+#else
+    return Level::Scalar;
+#endif
+}
+
+inline std::atomic<Level>& ActiveLevel() {
+    static std::atomic<Level> level{ DetectLevel() };
+    return level;
+}
+
+inline Level GetLevel() { return ActiveLevel().load(std::memory_order_relaxed); }
+
+// Requests a level; it is capped at what the CPU supports. Returns the level in effect.
+inline Level SetLevel(Level requested) {
+    const Level supported = DetectLevel();
+    const Level level = static_cast<int>(requested) < static_cast<int>(supported) ? requested : supported;
+    ActiveLevel().store(level, std::memory_order_relaxed);
+    return level;
+}
+
+inline const wchar_t* LevelName(Level level) {
+    return level == Level::Avx2 ? L"AVX2" : level == Level::Sse2 ? L"SSE2" : L"scalar";
+}
+
+namespace Detail {
+
+// A search is a predicate over single bytes plus its vector forms; each
+// returns a bitmask with one bit per matching byte.
+struct ByteIs {
+    char a;
+    bool Scalar(char c) const { return c == a; }
+#if defined(SIMD_SCAN_X86)
+    uint32_t Sse2(__m128i v) const {
+        return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8(a))));
+    }
+    SIMD_SCAN_AVX2 uint32_t Avx2(__m256i v) const {
+        return static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(a))));
+    }
+#endif
+};
+
+struct ByteIsEither {
+    char a;
+    char b;
+    bool Scalar(char c) const { return c == a || c == b; }
+#if defined(SIMD_SCAN_X86)
+    uint32_t Sse2(__m128i v) const {
+        return static_cast<uint32_t>(_mm_movemask_epi8(_mm_or_si128(
+            _mm_cmpeq_epi8(v, _mm_set1_epi8(a)), _mm_cmpeq_epi8(v, _mm_set1_epi8(b)))));
+    }
+    SIMD_SCAN_AVX2 uint32_t Avx2(__m256i v) const {
+        return static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_or_si256(
+            _mm256_cmpeq_epi8(v, _mm256_set1_epi8(a)), _mm256_cmpeq_epi8(v, _mm256_set1_epi8(b)))));
+    }
+#endif
+};
+
+// '"', '{', '}', '[' and ']'. Setting bit 5 folds the brackets onto the braces.
+struct ByteIsStructural {
+    bool Scalar(char c) const { return c == '"' || (c | 0x20) == '{' || (c | 0x20) == '}'; }
+#if defined(SIMD_SCAN_X86)
+    uint32_t Sse2(__m128i v) const {
+        const __m128i folded = _mm_or_si128(v, _mm_set1_epi8(0x20));
+        return static_cast<uint32_t>(_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('"')),
+            _mm_or_si128(_mm_cmpeq_epi8(folded, _mm_set1_epi8('{')), _mm_cmpeq_epi8(folded, _mm_set1_epi8('}'))))));
+    }
+    SIMD_SCAN_AVX2 uint32_t Avx2(__m256i v) const {
+        const __m256i folded = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+        return static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('"')),
+            _mm256_or_si256(_mm256_cmpeq_epi8(folded, _mm256_set1_epi8('{')),
+                _mm256_cmpeq_epi8(folded, _mm256_set1_epi8('}'))))));
+    }
+#endif
+};
+
+inline int LowestBit(uint32_t mask) {
+#if defined(_MSC_VER)
+    unsigned long bit;
+    _BitScanForward(&bit, mask);
+    return static_cast<int>(bit);
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+
+// SSE2-era CPUs may lack POPCNT, so MSVC gets the portable bit trick.
+inline int PopCount(uint32_t mask) {
+#if defined(_MSC_VER)
+    mask = mask - ((mask >> 1) & 0x55555555u);
+    mask = (mask & 0x33333333u) + ((mask >> 2) & 0x33333333u);
+    return static_cast<int>((((mask + (mask >> 4)) & 0x0F0F0F0Fu) * 0x01010101u) >> 24);
+#else
+    return __builtin_popcount(mask);
+#endif
+}
+
+template <typename Predicate>
+size_t FindScalar(const char* data, size_t pos, size_t size, const Predicate& match) {
+    for (; pos < size; ++pos) {
+        if (match.Scalar(data[pos]))
+            return pos;
+    }
+    return size;
+}
+
+#if defined(SIMD_SCAN_X86)
+template <typename Predicate>
+size_t FindSse2(const char* data, size_t pos, size_t size, const Predicate& match) {
+    for (; pos + 16 <= size; pos += 16) {
+        const uint32_t mask = match.Sse2(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos)));
+        if (mask)
+            return pos + LowestBit(mask);
+    }
+    return FindScalar(data, pos, size, match);
+}
+
+template <typename Predicate>
+SIMD_SCAN_AVX2 size_t FindAvx2(const char* data, size_t pos, size_t size, const Predicate& match) {
+    for (; pos + 32 <= size; pos += 32) {
+        const uint32_t mask = match.Avx2(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + pos)));
+        if (mask)
+            return pos + LowestBit(mask);
+    }
+    return FindSse2(data, pos, size, match);
+}
+
+template <typename Predicate>
+SIMD_SCAN_AVX2 size_t CountAvx2(const char* data, size_t size, const Predicate& match) {
+    size_t count = 0;
+    size_t pos = 0;
+    for (; pos + 32 <= size; pos += 32)
+        count += PopCount(match.Avx2(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + pos))));
+    for (; pos + 16 <= size; pos += 16)
+        count += PopCount(match.Sse2(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos))));
+    for (; pos < size; ++pos)
+        count += match.Scalar(data[pos]);
+    return count;
+}
+#endif
+
+template <typename Predicate>
+size_t Find(std::string_view text, size_t pos, const Predicate& match) {
+    if (pos >= text.size())
+        return text.size();
+    // Short spans are not worth a vector setup.
+    if (text.size() - pos < 16)
+        return FindScalar(text.data(), pos, text.size(), match);
+#if defined(SIMD_SCAN_X86)
+    // Most JSON spans end within a few vectors; AVX2 only pays off (after its
+    // call and state-transition cost) on longer ones.
+    const Level level = GetLevel();
+    if (level == Level::Avx2 && text.size() - pos >= 64)
+        return FindAvx2(text.data(), pos, text.size(), match);
+    if (level != Level::Scalar)
+        return FindSse2(text.data(), pos, text.size(), match);
+#endif
+    return FindScalar(text.data(), pos, text.size(), match);
+}
+
+template <typename Predicate>
+size_t Count(std::string_view text, const Predicate& match) {
+#if defined(SIMD_SCAN_X86)
+    if (GetLevel() == Level::Avx2)
+        return CountAvx2(text.data(), text.size(), match);
+    if (GetLevel() == Level::Sse2) {
+        size_t count = 0;
+        size_t pos = 0;
+        for (; pos + 16 <= text.size(); pos += 16)
+            count += PopCount(match.Sse2(_mm_loadu_si128(reinterpret_cast<const __m128i*>(text.data() + pos))));
+        for (; pos < text.size(); ++pos)
+            count += match.Scalar(text[pos]);
+        return count;
+    }
+#endif
+    size_t count = 0;
+    for (const char c : text)
+        count += match.Scalar(c);
+    return count;
+}
+
+} // namespace Detail
+
+// Each Find returns the index of the first match at or after `pos`, or text.size().
+inline size_t Find(std::string_view text, size_t pos, char a) {
+    return Detail::Find(text, pos, Detail::ByteIs{ a });
+}
+
+inline size_t FindEither(std::string_view text, size_t pos, char a, char b) {
+    return Detail::Find(text, pos, Detail::ByteIsEither{ a, b });
+}
+
+// Next quote, brace or bracket.
+inline size_t FindStructural(std::string_view text, size_t pos) {
+    return Detail::Find(text, pos, Detail::ByteIsStructural{});
+}
+
+inline size_t Count(std::string_view text, char a) {
+    return Detail::Count(text, Detail::ByteIs{ a });
+}
+
+} // namespace SimdScan
@@ -0,0 +1,108 @@
+/*
+ * Layout of the live status page: a small shared-memory region the tool
+ * rewrites whenever something it watches changes, so other programs can
+ * read its state with plain memory loads; no pipe, socket or file access
+ * per read. Plain C, so any language with a C FFI can use it.
+ *
+ * Opening it (once):
+ *
+ *     HANDLE mapping = OpenFileMappingW(FILE_MAP_READ, FALSE, OWUI_STATUS_NAME);
+ *     const owui_status* page = (const owui_status*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+ *
+ * then owui_status_read(page, &copy) as often as needed. The mapping exists
+ * while the tool runs (and while any reader keeps it open, holding the last
+ * state written: instance_state is OWUI_STATE_DOWN once the tool has exited).
+ *
+ * Consistency is a sequence lock. The writer makes `sequence` odd, rewrites
+ * everything after it, then makes it even again. A reader copies the page
+ * between two reads of an even, unchanged `sequence`; otherwise it copied a
+ * half-written page and tries again. Readers never block the writer, and
+ * the writer never waits for readers.
+ *
+ * Fields are little-endian with natural alignment, and the layout only
+ * grows: a reader built for version N reads any page with version >= N,
+ * using no more than its own sizeof(owui_status).
+ */
+#pragma once
+
+#include <windows.h>
+#include <stdint.h>
+#include <string.h>
+
+#define OWUI_STATUS_NAME L"Local\\open-webui-automation-status"
+#define OWUI_STATUS_MAGIC 0x5355574Fu /* "OWUS" in memory */
+#define OWUI_STATUS_VERSION 1
+
+/* Component slots in owui_status.components. */
+#define OWUI_COMPONENT_DOCKER 0    /* Docker Desktop.exe */
+#define OWUI_COMPONENT_OLLAMA 1    /* ollama.exe (or the tray app, if that is all that runs) */
+#define OWUI_COMPONENT_CONTAINER 2 /* the open-webui container's published port */
+#define OWUI_COMPONENT_PROXY 3     /* the Ollama proxy, in the tool's own process */
+#define OWUI_COMPONENT_WEB_FRONT 4 /* the WebUI front, in the tool's own process */
+#define OWUI_COMPONENT_COUNT 5
+
+#define OWUI_STATUS_MAX_MODELS 8
+#define OWUI_STATUS_MODEL_NAME 56
+
+/* Values of instance_state and owui_status_component.state. */
+#define OWUI_STATE_UNKNOWN 0  /* not looked at yet */
+#define OWUI_STATE_STARTING 1
+#define OWUI_STATE_UP 2
+#define OWUI_STATE_DOWN 3
+#define OWUI_STATE_STOPPING 4
+#define OWUI_STATE_DISABLED 5 /* turned off in config.json */
+
+typedef struct owui_status_component {
+    uint32_t state;      /* OWUI_STATE_* */
+    uint32_t pid;        /* 0 if none (the container has none of its own) */
+    int64_t probe_us;    /* round trip of the last probe, -1 if not probed */
+    int64_t changed_ms;  /* Unix time, in ms, of the last change of state */
+} owui_status_component; /* 24 bytes */
+
+typedef struct owui_status_model {
+    char name[OWUI_STATUS_MODEL_NAME]; /* UTF-8, NUL-terminated (cut if longer) */
+    uint64_t vram_bytes;               /* of the model's size, how much is in VRAM */
+} owui_status_model; /* 64 bytes */
+
+typedef struct owui_status {
+    /* Written once, before the first update. */
+    uint32_t magic;      /* OWUI_STATUS_MAGIC */
+    uint32_t version;    /* OWUI_STATUS_VERSION */
+    uint32_t size;       /* bytes the writer maps: sizeof(owui_status) of its version */
+    uint32_t writer_pid;
+    volatile int64_t sequence; /* odd while an update is in progress */
+
+    /* Everything from here on changes under `sequence`. */
+    int64_t updated_ms;  /* Unix time, in ms, of the last update */
+    int64_t started_ms;  /* Unix time, in ms, the tool started */
+    uint32_t instance_state;
+    uint32_t model_count; /* models loaded in Ollama, as of the last probe */
+    owui_status_component components[OWUI_COMPONENT_COUNT];
+    owui_status_model models[OWUI_STATUS_MAX_MODELS];
+} owui_status; /* 680 bytes */
+
+/*
+ * Copies a consistent snapshot of `page` into `out`. Returns 0 if the page
+ * is not a status page this header understands, or stayed mid-update for
+ * all attempts (the writer was preempted mid-update, or died in one): try
+ * again later.
+ */
+static __inline int owui_status_read(const owui_status* page, owui_status* out)
+{
+    int attempt;
+    if (page->magic != OWUI_STATUS_MAGIC || page->version < OWUI_STATUS_VERSION || page->size < sizeof(owui_status))
+        return 0;
+    for (attempt = 0; attempt < 10000; ++attempt) {
+        const int64_t before = page->sequence;
+        if (before & 1) {
+            YieldProcessor();
+            continue;
+        }
+        MemoryBarrier(); /* the copy is read after `before` */
+        memcpy(out, (const void*)page, sizeof(owui_status));
+        MemoryBarrier(); /* ... and before `sequence` is read again */
+        if (page->sequence == before)
+            return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,165 @@
+#pragma once
+
+#include <winsock2.h>
+#include <windows.h>
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "Common.h"
+#include "StatusLayout.h"
+
+// -------------------------
+// Status page configuration
+// -------------------------
+struct StatusPageConfig {
+    bool enabled = true;
+    std::wstring name = OWUI_STATUS_NAME; // the file mapping's name; readers open the same
+};
+
+// A model Ollama has in memory, as /api/ps reports it.
+struct LoadedModel {
+    std::string name;
+    uint64_t vramBytes = 0;
+};
+
+// -------------------------
+// Status page
+// -------------------------
+// Writes the live status page laid out in StatusLayout.h. Every setter
+// rewrites the whole page under the sequence lock (a few hundred bytes
+// between two interlocked increments), so readers always see the states,
+// PIDs and models from one moment. Setters are cheap no-ops on the page
+// until Open() succeeds; they still record the state, so a page opened late
+// starts out current.
+class StatusPage {
+public:
+    static StatusPage& Instance() {
+        static StatusPage page;
+        return page;
+    }
+
+    StatusPage(const StatusPage&) = delete;
+    StatusPage& operator=(const StatusPage&) = delete;
+
+    // Creates (or, if a reader still holds the last run's page, takes over)
+    // the mapping and publishes the current state.
+    bool Open(const StatusPageConfig& config) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (page_)
+            return true;
+        mapping_ = CreateFileMappingW(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, 0, sizeof(owui_status),
+            config.name.c_str());
+        if (!mapping_) {
+            Log(LogLevel::Warning, L"Status page could not be created: " + config.name +
+                L" (error " + std::to_wstring(GetLastError()) + L")");
+            return false;
+        }
+        page_ = static_cast<owui_status*>(MapViewOfFile(mapping_, FILE_MAP_WRITE, 0, 0, sizeof(owui_status)));
+        if (!page_) {
+            Log(LogLevel::Warning, L"Status page could not be mapped (error " + std::to_wstring(GetLastError()) + L")");
+            CloseHandle(mapping_);
+            mapping_ = nullptr;
+            return false;
+        }
+        // A writer that died mid-update left the sequence odd.
+        if (page_->sequence & 1)
+            InterlockedIncrement64(&page_->sequence);
+        page_->version = OWUI_STATUS_VERSION;
+        page_->size = sizeof(owui_status);
+        page_->writer_pid = GetCurrentProcessId();
+        Publish();
+        // Readers check the magic first, so it goes in last.
+        MemoryBarrier();
+        page_->magic = OWUI_STATUS_MAGIC;
+        Log(LogLevel::Info, L"Status page at " + config.name);
+        return true;
+    }
+
+    // Marks the instance down and unmaps the page. Readers that have it open
+    // keep that last state.
+    void Close() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        current_.instance_state = OWUI_STATE_DOWN;
+        Publish();
+        if (page_)
+            UnmapViewOfFile(page_);
+        if (mapping_)
+            CloseHandle(mapping_);
+        page_ = nullptr;
+        mapping_ = nullptr;
+    }
+
+    void SetInstanceState(uint32_t state) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        current_.instance_state = state;
+        Publish();
+    }
+
+    // `probeUs` < 0 keeps the last probe's round trip.
+    void SetComponent(int component, uint32_t state, uint32_t pid, int64_t probeUs = -1) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        owui_status_component& entry = current_.components[component];
+        if (entry.state != state)
+            entry.changed_ms = UnixMs();
+        entry.state = state;
+        entry.pid = pid;
+        if (probeUs >= 0)
+            entry.probe_us = probeUs;
+        Publish();
+    }
+
+    // Models past OWUI_STATUS_MAX_MODELS are left out; model_count says how
+    // many there are.
+    void SetModels(const std::vector<LoadedModel>& models) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        current_.model_count = static_cast<uint32_t>(models.size());
+        std::memset(current_.models, 0, sizeof(current_.models));
+        for (size_t i = 0; i < models.size() && i < OWUI_STATUS_MAX_MODELS; ++i) {
+            owui_status_model& entry = current_.models[i];
+            // Cut at a character boundary: UTF-8 continuation bytes are 10xxxxxx.
+            size_t length = (std::min)(models[i].name.size(), sizeof(entry.name) - 1);
+            while (length > 0 && length < models[i].name.size() && (models[i].name[length] & 0xC0) == 0x80)
+                --length;
+            std::memcpy(entry.name, models[i].name.data(), length);
+            entry.vram_bytes = models[i].vramBytes;
+        }
+        Publish();
+    }
+
+private:
+    StatusPage() {
+        current_.started_ms = UnixMs();
+        current_.instance_state = OWUI_STATE_STARTING;
+        for (owui_status_component& component : current_.components)
+            component.probe_us = -1;
+    }
+
+    static int64_t UnixMs() {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+    // Copies everything after the sequence into the page. Called under mutex_,
+    // so there is one writer; the interlocked increments are full barriers,
+    // which keep the copy between them.
+    void Publish() {
+        current_.updated_ms = UnixMs();
+        if (!page_)
+            return;
+        constexpr size_t from = offsetof(owui_status, updated_ms);
+        InterlockedIncrement64(&page_->sequence);
+        std::memcpy(reinterpret_cast<char*>(page_) + from, reinterpret_cast<const char*>(&current_) + from,
+            sizeof(owui_status) - from);
+        InterlockedIncrement64(&page_->sequence);
+    }
+
+    std::mutex mutex_;
+    owui_status current_{};
+    HANDLE mapping_ = nullptr;
+    owui_status* page_ = nullptr;
+};
@@ -0,0 +1,255 @@
+#pragma once
+
+#include <winsock2.h>
+#include <windows.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "Net.h"
+
+// -------------------------
+// TCP server
+// -------------------------
+// Thread-per-connection with sharded accept. The server is split into
+// reactors, one per core by default, each an accept thread plus its own pool
+// of connection threads, connection list and lock; connections never move
+// between reactors, so nothing on the request path is shared between them.
+// Windows has no SO_REUSEPORT: the reactors block in accept() on the same
+// listening socket and the kernel hands each connection to one of them.
+//
+// A connection thread serves one connection at a time, blocking, for as long
+// as it stays open; there is no event loop. A reactor runs at most
+// `threadsPerReactor` connection threads and stops accepting while all of
+// them are busy, so new connections go to another reactor (or wait in the
+// listen backlog) rather than queueing behind long-lived streams.
+class TcpServer {
+public:
+    // Called on a connection thread with the client socket and peer address.
+    using Handler = std::function<void(Socket& client, const std::string& peer)>;
+
+    TcpServer() = default;
+    ~TcpServer() { Stop(); }
+
+    TcpServer(const TcpServer&) = delete;
+    TcpServer& operator=(const TcpServer&) = delete;
+
+    static constexpr int kDefaultThreadsPerReactor = 256;
+
+    // `reactors` = 0 starts one per logical processor.
+    bool Start(const std::string& address, uint16_t port, Handler handler, int reactors = 0,
+        int threadsPerReactor = kDefaultThreadsPerReactor)
+    {
+        if (!Winsock::Init())
+            return false;
+        listener_ = ListenTcp(address, port);
+        if (!listener_.Valid())
+            return false;
+        handler_ = std::move(handler);
+        threadsPerReactor_ = (std::max)(1, threadsPerReactor);
+        running_ = true;
+        const int count = reactors > 0 ? reactors : (std::max)(1, static_cast<int>(std::thread::hardware_concurrency()));
+        for (int i = 0; i < count; ++i) {
+            reactors_.push_back(std::make_unique<Reactor>());
+            reactors_.back()->index = i;
+        }
+        for (auto& reactor : reactors_)
+            reactor->acceptor = std::thread(&TcpServer::AcceptLoop, this, reactor.get());
+        return true;
+    }
+
+    bool Running() const { return running_; }
+    size_t ReactorCount() const { return reactors_.size(); }
+
+    // The bound port (useful after listening on port 0).
+    uint16_t Port() const {
+        sockaddr_in address{};
+        int length = sizeof(address);
+        if (getsockname(listener_.Get(), reinterpret_cast<sockaddr*>(&address), &length) == SOCKET_ERROR)
+            return 0;
+        return ntohs(address.sin_port);
+    }
+
+    // Returns once every connection thread has finished. Open connections
+    // are shut down, which ends handlers blocked on their client; handlers
+    // waiting on an upstream must watch their client too (as the proxies do)
+    // or time out.
+    void Stop() {
+        if (!running_.exchange(false))
+            return;
+        listener_.Close();
+        for (auto& reactor : reactors_) {
+            std::lock_guard<std::mutex> lock(reactor->mutex);
+            reactor->room.notify_all();
+        }
+        for (auto& reactor : reactors_) {
+            if (reactor->acceptor.joinable())
+                reactor->acceptor.join();
+        }
+
+        for (auto& reactor : reactors_) {
+            std::list<Worker> workers;
+            {
+                std::lock_guard<std::mutex> lock(reactor->mutex);
+                for (auto& queued : reactor->queued)
+                    reactor->connections.erase(queued.first.Get());
+                reactor->queued.clear();
+                for (const SOCKET s : reactor->connections)
+                    shutdown(s, SD_BOTH);
+                reactor->wakeup.notify_all();
+                workers.swap(reactor->workers);
+            }
+            for (Worker& worker : workers)
+                worker.thread.join();
+        }
+    }
+
+private:
+    // Connection threads that find no work for this long exit.
+    static constexpr auto kIdleThreadTimeout = std::chrono::seconds(30);
+
+    struct Worker {
+        std::thread thread;
+        bool done = false; // set by the thread as it exits, under the reactor's mutex
+    };
+
+    struct Reactor {
+        int index = 0;
+        std::thread acceptor;
+        std::mutex mutex;
+        std::condition_variable wakeup; // a connection was queued
+        std::condition_variable room;   // a connection thread freed up
+        std::deque<std::pair<Socket, std::string>> queued;
+        std::set<SOCKET> connections;
+        std::list<Worker> workers;
+        int threads = 0;
+        int idleThreads = 0;
+    };
+
+    // Joins the connection threads that have exited. Called under the
+    // reactor's mutex; a done thread only has its return left to run.
+    static void Reap(Reactor* reactor) {
+        for (auto it = reactor->workers.begin(); it != reactor->workers.end();) {
+            if (!it->done) {
+                ++it;
+                continue;
+            }
+            it->thread.join();
+            it = reactor->workers.erase(it);
+        }
+    }
+
+    // Whether a connection accepted now would be served at once: an idle
+    // thread is left over after the queued connections, or one can start.
+    bool HasRoom(const Reactor* reactor) const {
+        return reactor->threads < threadsPerReactor_ ||
+            static_cast<size_t>(reactor->idleThreads) > reactor->queued.size();
+    }
+
+    // accept() failures that mean the process is out of sockets or buffers;
+    // they persist until connections close, so the reactor backs off.
+    static bool ResourceExhausted(int error) {
+        return error == WSAEMFILE || error == WSAENOBUFS;
+    }
+
+    void AcceptLoop(Reactor* reactor) {
+        SetThreadIdealProcessor(GetCurrentThread(), static_cast<DWORD>(reactor->index));
+        bool exhausted = false;
+        while (running_) {
+            // A saturated reactor leaves the listening socket to the others
+            // instead of queueing connections behind busy threads.
+            {
+                std::unique_lock<std::mutex> lock(reactor->mutex);
+                reactor->room.wait(lock, [&] { return !running_ || HasRoom(reactor); });
+                if (!running_)
+                    break;
+            }
+            sockaddr_in peer{};
+            int peerLength = sizeof(peer);
+            const SOCKET accepted = accept(listener_.Get(), reinterpret_cast<sockaddr*>(&peer), &peerLength);
+            if (accepted == INVALID_SOCKET) {
+                const int error = WSAGetLastError();
+                if (running_ && ResourceExhausted(error)) {
+                    if (!exhausted)
+                        Log(LogLevel::Warning, L"accept() failed (error " + std::to_wstring(error) +
+                            L"); retrying every 100 ms until connections close.");
+                    exhausted = true;
+                    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+                }
+                continue;
+            }
+            exhausted = false;
+            Socket client(accepted);
+            client.SetNoDelay();
+            {
+                std::lock_guard<std::mutex> lock(reactor->mutex);
+                if (!running_)
+                    break;
+                Reap(reactor);
+                reactor->connections.insert(accepted);
+                reactor->queued.emplace_back(std::move(client), PeerAddress(peer));
+                if (reactor->queued.size() > static_cast<size_t>(reactor->idleThreads) &&
+                    reactor->threads < threadsPerReactor_)
+                {
+                    ++reactor->threads;
+                    Worker& worker = reactor->workers.emplace_back();
+                    worker.thread = std::thread(&TcpServer::ConnectionLoop, this, reactor, &worker);
+                    continue;
+                }
+            }
+            reactor->wakeup.notify_one();
+        }
+    }
+
+    // Serves the reactor's connections one after another, then waits for the
+    // next until idle for too long.
+    void ConnectionLoop(Reactor* reactor, Worker* worker) {
+        SetThreadIdealProcessor(GetCurrentThread(), static_cast<DWORD>(reactor->index));
+        std::unique_lock<std::mutex> lock(reactor->mutex);
+        for (;;) {
+            ++reactor->idleThreads;
+            reactor->wakeup.wait_for(lock, kIdleThreadTimeout, [&] { return !reactor->queued.empty() || !running_; });
+            --reactor->idleThreads;
+            if (reactor->queued.empty())
+                break;
+            Socket client = std::move(reactor->queued.front().first);
+            const std::string peer = std::move(reactor->queued.front().second);
+            reactor->queued.pop_front();
+            lock.unlock();
+
+            const SOCKET s = client.Get();
+            // A handler that throws (out of memory on one request, say) loses
+            // its connection, not the process.
+            try {
+                handler_(client, peer);
+            }
+            catch (const std::exception& e) {
+                Log(LogLevel::Warning, L"Connection from " + UTF8ToWString(peer) + L" dropped: " + UTF8ToWString(e.what()));
+            }
+            client.Close();
+
+            lock.lock();
+            reactor->connections.erase(s);
+            reactor->room.notify_one();
+        }
+        --reactor->threads;
+        worker->done = true;
+        reactor->room.notify_one();
+    }
+
+    Socket listener_;
+    Handler handler_;
+    int threadsPerReactor_ = kDefaultThreadsPerReactor;
+    std::vector<std::unique_ptr<Reactor>> reactors_;
+    std::atomic<bool> running_{ false };
+};
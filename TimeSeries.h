@@ -0,0 +1,569 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <nlohmann/json.hpp>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#include "HdrHistogram.h"
+#include "Metrics.h"
+
+// -------------------------
+// History configuration
+// -------------------------
+struct HistoryConfig {
+    bool enabled = true;
+    int intervalSeconds = 1;              // how often the metrics are sampled
+    int fullResolutionHours = 24;         // older samples are downsampled
+    int downsampleSeconds = 60;           // step of the downsampled data
+    int retentionDays = 7;                // downsampled data older than this is dropped
+    size_t budgetBytes = 8 * 1024 * 1024; // compressed bytes across every series
+};
+
+// -------------------------
+// Gorilla-compressed block
+// -------------------------
+// Points (whole-second timestamps and doubles) packed as in Facebook's
+// Gorilla: the first point in full, then each timestamp as the change in its
+// delta from the previous one (one bit when sampling is regular) and each
+// value as its XOR with the previous value, reusing the previous window of
+// meaningful bits when it fits (one bit when the value repeats). Blocks are
+// append-only and decoded in full.
+class GorillaBlock {
+public:
+    static constexpr uint32_t kMaxPoints = 3600;
+
+    bool Full() const { return count_ >= kMaxPoints; }
+    uint32_t Count() const { return count_; }
+    int64_t FirstTime() const { return firstTime_; }
+    int64_t LastTime() const { return lastTime_; }
+    size_t Bytes() const { return sizeof(*this) + words_.capacity() * sizeof(uint64_t); }
+
+    void Append(int64_t time, double value) {
+        uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        if (count_ == 0) {
+            firstTime_ = time;
+            Write(static_cast<uint64_t>(time), 64);
+            Write(bits, 64);
+        }
+        else {
+            const int64_t delta = time - lastTime_;
+            const int64_t deltaOfDelta = delta - lastDelta_;
+            if (deltaOfDelta == 0) {
+                Write(0, 1);
+            }
+            else {
+                // Prefix 10, 110, 1110, 11110 or 11111, then the signed value.
+                static constexpr int widths[] = { 7, 9, 12, 32 };
+                int prefix = 0;
+                while (prefix < 4 && !Fits(deltaOfDelta, widths[prefix]))
+                    ++prefix;
+                Write(prefix < 4 ? ((uint64_t{ 1 } << (prefix + 2)) - 2) : 0x1F, prefix < 4 ? prefix + 2 : 5);
+                Write(static_cast<uint64_t>(deltaOfDelta), prefix < 4 ? widths[prefix] : 64);
+            }
+            lastDelta_ = delta;
+
+            const uint64_t difference = bits ^ lastBits_;
+            if (difference == 0) {
+                Write(0, 1);
+            }
+            else {
+                const int leading = (std::min)(31, LeadingZeros(difference));
+                const int trailing = TrailingZeros(difference);
+                if (leading_ >= 0 && leading >= leading_ && trailing >= trailing_) {
+                    Write(0b10, 2);
+                    Write(difference >> trailing_, 64 - leading_ - trailing_);
+                }
+                else {
+                    const int length = 64 - leading - trailing;
+                    Write(0b11, 2);
+                    Write(static_cast<uint64_t>(leading), 5);
+                    Write(static_cast<uint64_t>(length - 1), 6);
+                    Write(difference >> trailing, length);
+                    leading_ = leading;
+                    trailing_ = trailing;
+                }
+            }
+        }
+        lastTime_ = time;
+        lastBits_ = bits;
+        ++count_;
+    }
+
+    // Drops the spare capacity of a block that will take no more points.
+    void Seal() { words_.shrink_to_fit(); }
+
+    // Calls `visit(time, value)` for every point, oldest first.
+    template <typename Visit>
+    void ForEach(Visit&& visit) const {
+        size_t position = 0;
+        int64_t time = 0;
+        int64_t delta = 0;
+        uint64_t bits = 0;
+        int leading = 0;
+        int trailing = 0;
+        for (uint32_t i = 0; i < count_; ++i) {
+            if (i == 0) {
+                time = static_cast<int64_t>(Read(position, 64));
+                bits = Read(position, 64);
+            }
+            else {
+                if (Read(position, 1)) {
+                    static constexpr int widths[] = { 7, 9, 12, 32 };
+                    int prefix = 0;
+                    while (prefix < 4 && Read(position, 1))
+                        ++prefix;
+                    delta += prefix < 4 ? SignExtend(Read(position, widths[prefix]), widths[prefix]) :
+                        static_cast<int64_t>(Read(position, 64));
+                }
+                time += delta;
+                if (Read(position, 1)) {
+                    if (Read(position, 1)) {
+                        leading = static_cast<int>(Read(position, 5));
+                        trailing = 64 - leading - static_cast<int>(Read(position, 6)) - 1;
+                    }
+                    bits ^= Read(position, 64 - leading - trailing) << trailing;
+                }
+            }
+            double value;
+            std::memcpy(&value, &bits, sizeof(value));
+            visit(time, value);
+        }
+    }
+
+private:
+    static bool Fits(int64_t value, int width) {
+        const int64_t half = int64_t{ 1 } << (width - 1);
+        return value >= -half && value < half;
+    }
+
+    static int64_t SignExtend(uint64_t value, int width) {
+        const uint64_t sign = uint64_t{ 1 } << (width - 1);
+        return static_cast<int64_t>((value ^ sign) - sign);
+    }
+
+    static int LeadingZeros(uint64_t value) {
+#if defined(_MSC_VER) && defined(_M_X64)
+        unsigned long bit;
+        _BitScanReverse64(&bit, value);
+        return 63 - static_cast<int>(bit);
+#elif defined(_MSC_VER)
+        unsigned long bit;
+        if (_BitScanReverse(&bit, static_cast<unsigned long>(value >> 32)))
+            return 31 - static_cast<int>(bit);
+        _BitScanReverse(&bit, static_cast<unsigned long>(value));
+        return 63 - static_cast<int>(bit);
+#else
+        return __builtin_clzll(value);
+#endif
+    }
+
+    static int TrailingZeros(uint64_t value) {
+#if defined(_MSC_VER) && defined(_M_X64)
+        unsigned long bit;
+        _BitScanForward64(&bit, value);
+        return static_cast<int>(bit);
+#elif defined(_MSC_VER)
+        unsigned long bit;
+        if (_BitScanForward(&bit, static_cast<unsigned long>(value)))
+            return static_cast<int>(bit);
+        _BitScanForward(&bit, static_cast<unsigned long>(value >> 32));
+        return static_cast<int>(bit) + 32;
+#else
+        return __builtin_ctzll(value);
+#endif
+    }
+
+    // Appends the low `width` bits of `value` (1 to 64), most significant first.
+    void Write(uint64_t value, int width) {
+        if (width < 64)
+            value &= (uint64_t{ 1 } << width) - 1;
+        const int used = static_cast<int>(bitCount_ & 63);
+        if (used == 0)
+            words_.push_back(0);
+        const int room = 64 - used;
+        if (width <= room) {
+            words_.back() |= value << (room - width);
+        }
+        else {
+            words_.back() |= value >> (width - room);
+            words_.push_back(value << (64 - (width - room)));
+        }
+        bitCount_ += static_cast<size_t>(width);
+    }
+
+    uint64_t Read(size_t& position, int width) const {
+        const size_t word = position >> 6;
+        const int used = static_cast<int>(position & 63);
+        const int room = 64 - used;
+        position += static_cast<size_t>(width);
+        if (width <= room)
+            return (words_[word] << used) >> (64 - width);
+        const int rest = width - room;
+        return ((words_[word] & ((uint64_t{ 1 } << room) - 1)) << rest) | (words_[word + 1] >> (64 - rest));
+    }
+
+    std::vector<uint64_t> words_;
+    size_t bitCount_ = 0;
+    uint32_t count_ = 0;
+    int64_t firstTime_ = 0;
+    int64_t lastTime_ = 0;
+    int64_t lastDelta_ = 0;
+    uint64_t lastBits_ = 0;
+    int leading_ = -1; // current XOR window; -1 until the first one is written
+    int trailing_ = 0;
+};
+
+// -------------------------
+// Time-series store
+// -------------------------
+// Named series of Gorilla blocks within a fixed byte budget. A full-resolution
+// block covers kMaxPoints samples (an hour at one per second); once it is
+// older than fullResolutionHours, or the budget is exceeded, it is replaced
+// by its averages over downsampleSeconds. Over budget, even the block being
+// written is downsampled up to its current step. Downsampled blocks are
+// dropped after retentionDays, or oldest first when the budget is still
+// exceeded.
+// Not thread-safe; MetricsHistory serializes access.
+class TimeSeriesStore {
+public:
+    explicit TimeSeriesStore(HistoryConfig config = {}) : config_(std::move(config)) {}
+
+    void Configure(const HistoryConfig& config) { config_ = config; }
+
+    // Timestamps are Unix seconds and must not go backwards within a series.
+    void Append(const std::string& name, int64_t time, double value) {
+        std::deque<GorillaBlock>& blocks = series_[name].full;
+        if (blocks.empty() || blocks.back().Full()) {
+            if (!blocks.empty())
+                blocks.back().Seal();
+            blocks.emplace_back();
+        }
+        blocks.back().Append(time, value);
+    }
+
+    // Applies the age limits, then the byte budget.
+    void Enforce(int64_t now) {
+        const int64_t fullCutoff = now - static_cast<int64_t>(config_.fullResolutionHours) * 3600;
+        const int64_t retentionCutoff = now - static_cast<int64_t>(config_.retentionDays) * 86400;
+        for (auto it = series_.begin(); it != series_.end();) {
+            Series& series = it->second;
+            while (!series.full.empty() && series.full.front().LastTime() < fullCutoff)
+                Downsample(series);
+            while (!series.coarse.empty() && series.coarse.front().LastTime() < retentionCutoff)
+                series.coarse.pop_front();
+            it = series.full.empty() && series.coarse.empty() ? series_.erase(it) : std::next(it);
+        }
+        size_t bytes = Bytes();
+        while (bytes > config_.budgetBytes) {
+            // Downsample the oldest full-resolution block not being written;
+            // failing that, the closed steps of the oldest block being
+            // written; failing that, drop the oldest downsampled block.
+            Series* oldest = nullptr;
+            for (auto& [name, series] : series_) {
+                if (series.full.size() > 1 && (!oldest || series.full.front().FirstTime() < oldest->full.front().FirstTime()))
+                    oldest = &series;
+            }
+            bool writing = false;
+            if (!oldest) {
+                for (auto& [name, series] : series_) {
+                    if (series.full.size() == 1 && HasClosedStep(series.full.front()) &&
+                        (!oldest || series.full.front().FirstTime() < oldest->full.front().FirstTime()))
+                        oldest = &series;
+                }
+                writing = oldest != nullptr;
+            }
+            if (oldest) {
+                Downsample(*oldest, writing);
+            }
+            else {
+                for (auto& [name, series] : series_) {
+                    if (!series.coarse.empty() &&
+                        (!oldest || series.coarse.front().FirstTime() < oldest->coarse.front().FirstTime()))
+                        oldest = &series;
+                }
+                if (!oldest)
+                    break;
+                oldest->coarse.pop_front();
+            }
+            bytes = Bytes();
+        }
+    }
+
+    size_t Bytes() const {
+        size_t bytes = 0;
+        for (const auto& [name, series] : series_) {
+            bytes += name.capacity() + sizeof(Series);
+            for (const GorillaBlock& block : series.coarse)
+                bytes += block.Bytes();
+            for (const GorillaBlock& block : series.full)
+                bytes += block.Bytes();
+        }
+        return bytes;
+    }
+
+    // [{"series", "points", "bytes", "from", "to"}, ...]
+    nlohmann::json List() const {
+        nlohmann::json list = nlohmann::json::array();
+        for (const auto& [name, series] : series_) {
+            size_t points = 0;
+            size_t bytes = 0;
+            int64_t from = INT64_MAX;
+            int64_t to = 0;
+            for (const auto* blocks : { &series.coarse, &series.full }) {
+                for (const GorillaBlock& block : *blocks) {
+                    points += block.Count();
+                    bytes += block.Bytes();
+                    from = (std::min)(from, block.FirstTime());
+                    to = (std::max)(to, block.LastTime());
+                }
+            }
+            list.push_back({ { "series", name }, { "points", points }, { "bytes", bytes }, { "from", from }, { "to", to } });
+        }
+        return list;
+    }
+
+    // Points of `name` in [from, to], averaged into `step`-second buckets when
+    // step > 0, with min, max, mean and last over the range. Null if there is
+    // no such series.
+    nlohmann::json Query(const std::string& name, int64_t from, int64_t to, int64_t step) const {
+        const auto found = series_.find(name);
+        if (found == series_.end())
+            return nullptr;
+        nlohmann::json points = nlohmann::json::array();
+        double lowest = 0.0, highest = 0.0, sum = 0.0, last = 0.0;
+        size_t count = 0;
+        int64_t bucket = 0;
+        double bucketSum = 0.0;
+        size_t bucketCount = 0;
+        const auto flush = [&] {
+            if (bucketCount)
+                points.push_back({ bucket, bucketSum / static_cast<double>(bucketCount) });
+            bucketSum = 0.0;
+            bucketCount = 0;
+        };
+        const auto visit = [&](int64_t time, double value) {
+            if (time < from || time > to)
+                return;
+            lowest = count ? (std::min)(lowest, value) : value;
+            highest = count ? (std::max)(highest, value) : value;
+            sum += value;
+            last = value;
+            ++count;
+            if (step <= 0) {
+                points.push_back({ time, value });
+                return;
+            }
+            const int64_t start = time - ((time % step) + step) % step;
+            if (bucketCount && start != bucket)
+                flush();
+            bucket = start;
+            bucketSum += value;
+            ++bucketCount;
+        };
+        for (const auto* blocks : { &found->second.coarse, &found->second.full }) {
+            for (const GorillaBlock& block : *blocks) {
+                if (block.LastTime() >= from && block.FirstTime() <= to)
+                    block.ForEach(visit);
+            }
+        }
+        flush();
+        nlohmann::json result = { { "series", name }, { "from", from }, { "to", to }, { "step", step },
+            { "points", std::move(points) } };
+        if (count) {
+            result["min"] = lowest;
+            result["max"] = highest;
+            result["mean"] = sum / static_cast<double>(count);
+            result["last"] = last;
+        }
+        return result;
+    }
+
+private:
+    struct Series {
+        std::deque<GorillaBlock> coarse; // downsampled, oldest first
+        std::deque<GorillaBlock> full;   // full resolution; back() takes new points
+    };
+
+    int64_t StepStart(int64_t time) const {
+        const int64_t step = (std::max)(1, config_.downsampleSeconds);
+        return time - ((time % step) + step) % step;
+    }
+
+    // Whether the block has points before the step its last point is in.
+    bool HasClosedStep(const GorillaBlock& block) const {
+        return block.Count() > 0 && StepStart(block.FirstTime()) < StepStart(block.LastTime());
+    }
+
+    // Replaces the oldest full-resolution block with its step averages. With
+    // `keepOpenStep` (for the block still being written), the points of its
+    // last step stay at full resolution in a new block that takes further
+    // points, so that step is averaged once, when it is complete.
+    void Downsample(Series& series, bool keepOpenStep = false) {
+        const int64_t openStep = keepOpenStep ? StepStart(series.full.front().LastTime()) : INT64_MAX;
+        GorillaBlock open;
+        int64_t bucket = 0;
+        double sum = 0.0;
+        size_t count = 0;
+        const auto flush = [&] {
+            if (!count)
+                return;
+            if (series.coarse.empty() || series.coarse.back().Full()) {
+                if (!series.coarse.empty())
+                    series.coarse.back().Seal();
+                series.coarse.emplace_back();
+            }
+            series.coarse.back().Append(bucket, sum / static_cast<double>(count));
+            sum = 0.0;
+            count = 0;
+        };
+        series.full.front().ForEach([&](int64_t time, double value) {
+            const int64_t start = StepStart(time);
+            if (start >= openStep) {
+                open.Append(time, value);
+                return;
+            }
+            if (count && start != bucket)
+                flush();
+            bucket = start;
+            sum += value;
+            ++count;
+        });
+        flush();
+        series.full.pop_front();
+        if (open.Count() > 0)
+            series.full.push_back(std::move(open));
+    }
+
+    HistoryConfig config_;
+    std::map<std::string, Series> series_;
+};
+
+// -------------------------
+// Metrics history
+// -------------------------
+// Samples every counter and gauge in the registry (including whatever the
+// samplers publish there) into a TimeSeriesStore once per interval. Each
+// histogram contributes its p50, p95 and p99 over the interval, as series
+// with a quantile label added; intervals with no new values are skipped.
+class MetricsHistory {
+public:
+    static MetricsHistory& Instance() {
+        static MetricsHistory history;
+        return history;
+    }
+
+    MetricsHistory(const MetricsHistory&) = delete;
+    MetricsHistory& operator=(const MetricsHistory&) = delete;
+
+    void Start(const HistoryConfig& config) {
+        Stop();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            config_ = config;
+            store_.Configure(config);
+            stopping_ = false;
+        }
+        thread_ = std::thread([this] { Run(); });
+    }
+
+    void Stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        wake_.notify_all();
+        if (thread_.joinable())
+            thread_.join();
+    }
+
+    // Samples the registry now.
+    void Sample(int64_t now) {
+        MetricsRegistry& registry = MetricsRegistry::Instance();
+        const auto scalars = registry.Scalars();
+        const auto histograms = registry.Histograms();
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto& [series, value] : scalars)
+            store_.Append(series, now, value);
+        for (const auto& [series, histogram] : histograms) {
+            Window& window = windows_[series];
+            if (!window.previous) {
+                const uint64_t highest = histogram->Hdr().HighestTrackableValue();
+                window.previous = std::make_unique<HdrHistogram>(highest);
+                window.interval = std::make_unique<HdrHistogram>(highest);
+            }
+            // Counts only grow, so previous + (now - previous) is exactly now.
+            window.interval->Reset();
+            window.interval->Merge(histogram->Hdr());
+            window.interval->Subtract(*window.previous);
+            window.previous->Merge(*window.interval);
+            if (window.interval->TotalCount() == 0)
+                continue;
+            const std::string prefix = series.back() == '}' ? series.substr(0, series.size() - 1) + "," : series + "{";
+            for (const auto& [quantile, label] : { std::pair<double, const char*>{ 0.5, "0.5" }, { 0.95, "0.95" }, { 0.99, "0.99" } }) {
+                store_.Append(prefix + "quantile=\"" + label + "\"}", now,
+                    static_cast<double>(window.interval->ValueAtQuantile(quantile)) * histogram->Unit());
+            }
+        }
+        store_.Enforce(now);
+    }
+
+    nlohmann::json List() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return { { "bytes", store_.Bytes() }, { "budgetBytes", config_.budgetBytes }, { "series", store_.List() } };
+    }
+
+    nlohmann::json Query(const std::string& series, int64_t from, int64_t to, int64_t step) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return store_.Query(series, from, to, step);
+    }
+
+    static int64_t Now() {
+        return std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+private:
+    struct Window {
+        std::unique_ptr<HdrHistogram> previous; // the histogram as of the last sample
+        std::unique_ptr<HdrHistogram> interval; // what was recorded since
+    };
+
+    MetricsHistory() = default;
+    ~MetricsHistory() { Stop(); }
+
+    void Run() {
+        auto next = std::chrono::steady_clock::now();
+        for (;;) {
+            std::chrono::seconds interval;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                interval = std::chrono::seconds((std::max)(1, config_.intervalSeconds));
+                next += interval;
+                if (wake_.wait_until(lock, next, [this] { return stopping_; }))
+                    return;
+            }
+            Sample(Now());
+        }
+    }
+
+    mutable std::mutex mutex_;
+    std::condition_variable wake_;
+    bool stopping_ = false;
+    HistoryConfig config_;
+    TimeSeriesStore store_;
+    std::map<std::string, Window> windows_;
+    std::thread thread_;
+};
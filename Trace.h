@@ -0,0 +1,174 @@
+#pragma once
+
+#include <winsock2.h>
+#include <windows.h>
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+// -------------------------
+// Trace configuration
+// -------------------------
+struct TraceConfig {
+    bool enabled = true;
+    std::wstring file; // Chrome trace_event JSON written on exit; empty disables
+};
+
+// -------------------------
+// Trace recorder
+// -------------------------
+// Timed spans for Chrome's trace_event format, which Perfetto and
+// chrome://tracing open. A span stores a literal name, its start and its
+// duration into a buffer owned by the recording thread, so recording takes
+// no lock; buffers are registered once per thread and kept after the thread
+// exits. WriteFile() emits every span as a complete ("X") event, plus the
+// thread names.
+class Trace {
+public:
+    struct Event {
+        const char* name;     // string literals only: stored, not copied
+        const char* category;
+        int64_t startUs;
+        int64_t durationUs;
+        const char* argName;  // optional single numeric argument
+        int64_t argValue;
+    };
+
+    static Trace& Instance() {
+        static Trace trace;
+        return trace;
+    }
+
+    Trace(const Trace&) = delete;
+    Trace& operator=(const Trace&) = delete;
+
+    static bool Enabled() { return Instance().enabled_.load(std::memory_order_relaxed); }
+
+    void Configure(const TraceConfig& config) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        config_ = config;
+        enabled_.store(config.enabled && !config.file.empty(), std::memory_order_relaxed);
+    }
+
+    // Microseconds since the recorder was created.
+    int64_t NowUs() const {
+        LARGE_INTEGER now;
+        QueryPerformanceCounter(&now);
+        return static_cast<int64_t>(static_cast<double>(now.QuadPart - origin_) * 1e6 / static_cast<double>(frequency_));
+    }
+
+    void Add(const Event& event) { LocalBuffer().events.push_back(event); }
+
+    // Names the calling thread in the trace.
+    void NameThread(std::string name) { LocalBuffer().name = std::move(name); }
+
+    // Writes everything recorded so far. Call once recording threads are
+    // done (spans still open are not included).
+    bool WriteFile() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!enabled_.load(std::memory_order_relaxed))
+            return false;
+        nlohmann::json events = nlohmann::json::array();
+        const DWORD pid = GetCurrentProcessId();
+        for (const auto& buffer : buffers_) {
+            if (!buffer->name.empty()) {
+                events.push_back({ { "ph", "M" }, { "name", "thread_name" }, { "pid", pid }, { "tid", buffer->threadId },
+                    { "args", { { "name", buffer->name } } } });
+            }
+            for (const Event& event : buffer->events) {
+                nlohmann::json entry = { { "ph", "X" }, { "name", event.name }, { "cat", event.category },
+                    { "ts", event.startUs }, { "dur", event.durationUs }, { "pid", pid }, { "tid", buffer->threadId } };
+                if (event.argName)
+                    entry["args"] = { { event.argName, event.argValue } };
+                events.push_back(std::move(entry));
+            }
+        }
+        const std::filesystem::path path(config_.file);
+        std::error_code error;
+        if (path.has_parent_path())
+            std::filesystem::create_directories(path.parent_path(), error);
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file << nlohmann::json{ { "traceEvents", std::move(events) }, { "displayTimeUnit", "ms" } }.dump();
+        return static_cast<bool>(file);
+    }
+
+private:
+    struct ThreadBuffer {
+        DWORD threadId = GetCurrentThreadId();
+        std::string name;
+        std::vector<Event> events;
+    };
+
+    Trace() {
+        LARGE_INTEGER value;
+        QueryPerformanceFrequency(&value);
+        frequency_ = value.QuadPart;
+        QueryPerformanceCounter(&value);
+        origin_ = value.QuadPart;
+    }
+
+    ThreadBuffer& LocalBuffer() {
+        thread_local ThreadBuffer* buffer = nullptr;
+        if (!buffer) {
+            auto owned = std::make_unique<ThreadBuffer>();
+            owned->events.reserve(256);
+            buffer = owned.get();
+            std::lock_guard<std::mutex> lock(mutex_);
+            buffers_.push_back(std::move(owned));
+        }
+        return *buffer;
+    }
+
+    std::atomic<bool> enabled_{ true };
+    int64_t frequency_ = 1;
+    int64_t origin_ = 0;
+    std::mutex mutex_;
+    TraceConfig config_;
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers_;
+};
+
+// Records the enclosing scope as a span. Costs two QPC reads and a vector
+// append while tracing is on, and one relaxed load while it is off.
+class TraceSpan {
+public:
+    explicit TraceSpan(const char* name, const char* category = "startup")
+        : name_(name), category_(category), active_(Trace::Enabled())
+    {
+        if (active_)
+            start_ = Trace::Instance().NowUs();
+    }
+
+    ~TraceSpan() { End(); }
+
+    // Ends the span before the scope does.
+    void End() {
+        if (!active_)
+            return;
+        active_ = false;
+        Trace& trace = Trace::Instance();
+        trace.Add({ name_, category_, start_, trace.NowUs() - start_, argName_, argValue_ });
+    }
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+    // Attaches a number shown with the span (an attempt count, a status).
+    void Arg(const char* name, int64_t value) {
+        argName_ = name;
+        argValue_ = value;
+    }
+
+private:
+    const char* name_;
+    const char* category_;
+    bool active_;
+    int64_t start_ = 0;
+    const char* argName_ = nullptr;
+    int64_t argValue_ = 0;
+};
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <winsock2.h>
+#include <windows.h>
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <utility>
+#include "Metrics.h"
+#include "Net.h"
+
+// -------------------------
+// Upstream connection pool configuration
+// -------------------------
+struct PoolConfig {
+    bool enabled = true;
+    int maxIdle = 16;          // idle keep-alive connections kept per upstream
+    int idleTimeoutMs = 30000; // idle connections older than this are closed
+};
+
+// -------------------------
+// Upstream connection pool
+// -------------------------
+// Idle keep-alive connections to one upstream. A request checks out the most
+// recently used live connection, or connects when there is none; once the
+// response has been read to the end of its framing the connection goes back.
+// Checkout discards connections that have timed out or that the upstream has
+// closed (or sent unsolicited bytes on) since they were returned.
+class UpstreamPool {
+public:
+    UpstreamPool(const sockaddr_in& address, const std::string& label, const PoolConfig& config)
+        : address_(address), config_(config)
+    {
+        MetricsRegistry& metrics = MetricsRegistry::Instance();
+        const std::string labels = "upstream=\"" + label + "\"";
+        const char* checkoutHelp = "Upstream connection checkouts by whether an idle connection was reused.";
+        hits_ = &metrics.GetCounter("owui_proxy_upstream_pool_checkouts_total", checkoutHelp, labels + ",result=\"hit\"");
+        misses_ = &metrics.GetCounter("owui_proxy_upstream_pool_checkouts_total", checkoutHelp, labels + ",result=\"miss\"");
+        idleGauge_ = &metrics.GetGauge("owui_proxy_upstream_pool_idle_connections",
+            "Idle keep-alive connections held per upstream.", labels);
+        connectSeconds_ = &metrics.GetHistogram("owui_proxy_upstream_connect_seconds",
+            "Time to open a new connection to an upstream.", labels);
+    }
+
+    UpstreamPool(const UpstreamPool&) = delete;
+    UpstreamPool& operator=(const UpstreamPool&) = delete;
+
+    // Returns a connection to the upstream (invalid if it cannot be reached).
+    // `reused` tells whether it came from the pool, in which case the upstream
+    // may still have closed it in the moment since the liveness check.
+    Socket Acquire(bool& reused) {
+        reused = false;
+        if (config_.enabled) {
+            std::unique_lock<std::mutex> lock(mutex_);
+            while (!idle_.empty()) {
+                Idle entry = std::move(idle_.back());
+                idle_.pop_back();
+                if (Expired(entry) || !Alive(entry.socket))
+                    continue;
+                idleGauge_->Set(static_cast<double>(idle_.size()));
+                lock.unlock();
+                hits_->Add();
+                reused = true;
+                return std::move(entry.socket);
+            }
+            idleGauge_->Set(0.0);
+        }
+        misses_->Add();
+        return Connect();
+    }
+
+    // Opens a fresh connection, bypassing the pool (used to retry a request
+    // whose pooled connection turned out to be dead).
+    Socket Connect() {
+        const auto start = std::chrono::steady_clock::now();
+        Socket socket = ConnectTcp(address_);
+        if (socket.Valid())
+            connectSeconds_->Record(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        return socket;
+    }
+
+    // Hands back a connection whose last response was read completely. Call
+    // only when both sides agreed to keep the connection open.
+    void Release(Socket socket) {
+        if (!config_.enabled || !socket.Valid())
+            return;
+        Socket evicted;
+        std::lock_guard<std::mutex> lock(mutex_);
+        // Oldest first: the front of the queue is the longest idle.
+        while (!idle_.empty() && Expired(idle_.front()))
+            idle_.pop_front();
+        if (idle_.size() >= static_cast<size_t>((std::max)(0, config_.maxIdle))) {
+            if (idle_.empty())
+                return;
+            evicted = std::move(idle_.front().socket);
+            idle_.pop_front();
+        }
+        idle_.push_back({ std::move(socket), std::chrono::steady_clock::now() });
+        idleGauge_->Set(static_cast<double>(idle_.size()));
+    }
+
+    // Closes every idle connection.
+    void Clear() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        idle_.clear();
+        idleGauge_->Set(0.0);
+    }
+
+private:
+    struct Idle {
+        Socket socket;
+        std::chrono::steady_clock::time_point since;
+    };
+
+    bool Expired(const Idle& entry) const {
+        return std::chrono::steady_clock::now() - entry.since > std::chrono::milliseconds(config_.idleTimeoutMs);
+    }
+
+    // An idle connection has nothing to read; if it polls readable the
+    // upstream has closed it or is misbehaving, and it cannot be reused.
+    static bool Alive(Socket& socket) {
+        WSAPOLLFD fd{ socket.Get(), POLLRDNORM, 0 };
+        return WSAPoll(&fd, 1, 0) == 0;
+    }
+
+    sockaddr_in address_;
+    PoolConfig config_;
+    std::mutex mutex_;
+    std::deque<Idle> idle_;
+    Counter* hits_ = nullptr;
+    Counter* misses_ = nullptr;
+    Gauge* idleGauge_ = nullptr;
+    Histogram* connectSeconds_ = nullptr;
+};
@@ -0,0 +1,335 @@
+#pragma once
+
+#include <winsock2.h>
+#include <windows.h>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <string>
+#include "AssetCache.h"
+#include "Common.h"
+#include "Net.h"
+#include "Relay.h"
+#include "TcpServer.h"
+#include "UpstreamPool.h"
+
+// -------------------------
+// WebUI front configuration
+// -------------------------
+struct WebUIConfig {
+    bool enabled = false;
+    std::string listenAddress = "0.0.0.0";
+    uint16_t listenPort = 3000;
+    uint16_t containerPort = 3001; // published on 127.0.0.1 only when the front is enabled
+    int reactors = 0;              // accept loops; 0 = one per logical processor
+    uint64_t maxBodyBytes = 256ull * 1024 * 1024; // uploads included; larger requests get 413
+    PoolConfig pool;
+    AssetCacheConfig assets;
+};
+
+// -------------------------
+// WebUI front
+// -------------------------
+// Reverse proxy on the WebUI port in front of the Open WebUI container.
+// Pages and API responses are passed through untouched, hashed static assets
+// are served from an in-memory cache, and WebSocket upgrades (Open WebUI's
+// socket.io channel) become a raw tunnel.
+class WebUIProxy {
+public:
+    explicit WebUIProxy(WebUIConfig config) : config_(std::move(config)) {}
+    ~WebUIProxy() { Stop(); }
+
+    WebUIProxy(const WebUIProxy&) = delete;
+    WebUIProxy& operator=(const WebUIProxy&) = delete;
+
+    bool Start() {
+        if (!Winsock::Init())
+            return false;
+        if (!ResolveEndpoint("127.0.0.1:" + std::to_string(config_.containerPort), container_)) {
+            Log(LogLevel::Error, L"Cannot resolve the Open WebUI container port.");
+            return false;
+        }
+        pool_ = std::make_unique<UpstreamPool>(container_, "webui", config_.pool);
+        if (config_.assets.enabled)
+            assets_ = std::make_unique<AssetCache>(config_.assets);
+        running_ = true;
+        if (!server_.Start(config_.listenAddress, config_.listenPort,
+            [this](Socket& client, const std::string& peer) { ServeConnection(client, peer); }, config_.reactors))
+        {
+            running_ = false;
+            return false;
+        }
+        Log(LogLevel::Info, L"WebUI front listening on " + UTF8ToWString(config_.listenAddress) + L":" +
+            std::to_wstring(config_.listenPort) + L" for container port " + std::to_wstring(config_.containerPort) + L".");
+        return true;
+    }
+
+    void Stop() {
+        if (!running_.exchange(false))
+            return;
+        server_.Stop();
+        pool_->Clear();
+        Log(LogLevel::Info, L"WebUI front stopped.");
+    }
+
+private:
+    static constexpr DWORD kClientIdleTimeoutMs = 120000;
+    static constexpr DWORD kUpstreamTimeoutMs = 600000;
+    static constexpr int kTunnelIdleTimeoutMs = 3600000;
+
+    // Reads from the container, noting whether it closed or reset the
+    // connection (as opposed to a receive timeout). The error is taken right
+    // after the failing recv, before anything else can overwrite it.
+    class ClosureWatch {
+    public:
+        explicit ClosureWatch(Socket& server) : server_(server) {}
+
+        int Recv(char* buffer, int length) {
+            const int received = server_.Recv(buffer, length);
+            if (received == 0 || (received == SOCKET_ERROR && WSAGetLastError() != WSAETIMEDOUT))
+                closed_ = true;
+            return received;
+        }
+
+        bool ClosedSeen() const { return closed_; }
+
+    private:
+        Socket& server_;
+        bool closed_ = false;
+    };
+
+    // Methods RFC 9110 defines as idempotent: running them twice has the
+    // effect of running them once.
+    static bool IsIdempotentMethod(std::string_view method) {
+        return method == "GET" || method == "HEAD" || method == "OPTIONS" || method == "TRACE" ||
+            method == "PUT" || method == "DELETE";
+    }
+
+    void ServeConnection(Socket& client, const std::string& clientAddress) {
+        client.SetReceiveTimeout(kClientIdleTimeoutMs);
+        std::string buffer;
+        Arena arena;
+        bool keepAlive = true;
+        while (keepAlive && running_) {
+            arena.Reset();
+            HttpRequest request(arena);
+            if (!ReadHttpRequest(client, buffer, arena, request, config_.maxBodyBytes))
+                break;
+            const std::string_view* connection = FindHeader(request.headers, "Connection");
+            keepAlive = request.version == "HTTP/1.1" ?
+                !(connection && ContainsTokenIgnoreCase(*connection, "close")) :
+                (connection && ContainsTokenIgnoreCase(*connection, "keep-alive"));
+            keepAlive = Forward(client, buffer, request, arena, keepAlive, clientAddress);
+        }
+    }
+
+    // Forwards one request and relays the response. `pending` holds client
+    // bytes read past the request, which belong to the tunnel after an
+    // upgrade. Returns whether the client connection can be reused.
+    bool Forward(Socket& client, std::string& pending, const HttpRequest& request, Arena& arena, bool keepAlive,
+        const std::string& clientAddress)
+    {
+        const bool asset = assets_ && assets_->Eligible(request);
+        if (asset) {
+            if (const auto cached = assets_->Find(request.target))
+                return assets_->Serve(client, request, *cached, keepAlive) && keepAlive;
+        }
+
+        const std::string_view* upgrade = FindHeader(request.headers, "Upgrade");
+        const std::string_view* connection = FindHeader(request.headers, "Connection");
+        const bool upgrading = upgrade && connection && ContainsTokenIgnoreCase(*connection, "upgrade");
+
+        // A cache fill asks for the plain body, unconditionally.
+        const ArenaString head = BuildContainerHead(request, arena, clientAddress, upgrading ? upgrade : nullptr,
+            asset ? "identity" : std::string_view());
+        WSABUF pieces[2] = {
+            { static_cast<ULONG>(head.size()), const_cast<char*>(head.data()) },
+            { static_cast<ULONG>(request.body.size()), const_cast<char*>(request.body.data()) }
+        };
+        const DWORD pieceCount = request.body.empty() ? 1 : 2;
+        // Upgraded connections become tunnels and never return to the pool.
+        bool reused = false;
+        Socket server = upgrading ? pool_->Connect() : pool_->Acquire(reused);
+        bool requestSent = server.Valid() && server.SendAll(pieces, pieceCount);
+        ArenaString buffer{ ArenaAllocator<char>(arena) };
+        size_t headEnd = 0;
+        bool closedEarly = false;
+        if (requestSent) {
+            server.SetReceiveTimeout(kUpstreamTimeoutMs);
+            ClosureWatch watched(server);
+            headEnd = ReadHeaderBlock(watched, buffer);
+            closedEarly = watched.ClosedSeen();
+        }
+        // A pooled connection the container closed before sending a response
+        // byte most likely timed out idle as the request went out. The request
+        // is sent again on a new connection if it never fully went out, or if
+        // it is safe to run twice; a POST the container may have started on is not.
+        if (headEnd == 0 && buffer.empty() && reused &&
+            (!requestSent || (closedEarly && IsIdempotentMethod(request.method))))
+        {
+            server = pool_->Connect();
+            requestSent = server.Valid() && server.SendAll(pieces, pieceCount);
+            if (requestSent) {
+                server.SetReceiveTimeout(kUpstreamTimeoutMs);
+                headEnd = ReadHeaderBlock(server, buffer);
+            }
+        }
+        if (!requestSent)
+            return SendSimpleResponse(client, 502, "Bad Gateway", "text/plain", "Open WebUI unavailable\n") && keepAlive;
+        HttpResponseHead response(arena);
+        if (headEnd == 0 || !ParseResponseHead(std::string_view(buffer.data(), headEnd - 4), arena, response))
+            return SendSimpleResponse(client, 502, "Bad Gateway", "text/plain", "Open WebUI unavailable\n") && keepAlive;
+
+        if (upgrading && response.status == 101) {
+            if (!client.SendAll(std::string_view(buffer)) || (!pending.empty() && !server.SendAll(pending)))
+                return false;
+            pending.clear();
+            Tunnel(client, server, kTunnelIdleTimeoutMs);
+            return false;
+        }
+
+        const bool noBody = request.method == "HEAD" || response.status / 100 == 1 ||
+            response.status == 204 || response.status == 304;
+        const std::string_view* transferEncoding = FindHeader(response.headers, "Transfer-Encoding");
+        const std::string_view* contentLengthHeader = FindHeader(response.headers, "Content-Length");
+        uint64_t contentLength = 0;
+        const bool hasLength = contentLengthHeader && ParseUint(*contentLengthHeader, contentLength);
+        BodyFraming framing = noBody ? BodyFraming::None :
+            transferEncoding && ContainsTokenIgnoreCase(*transferEncoding, "chunked") ? BodyFraming::Chunked :
+            hasLength ? BodyFraming::Length : BodyFraming::UntilClose;
+
+        if (asset && framing == BodyFraming::Length && contentLength <= assets_->MaxAssetBytes() &&
+            AssetCache::Cacheable(response))
+        {
+            return FillCache(client, server, request, arena, response, std::string_view(buffer).substr(headEnd),
+                static_cast<size_t>(contentLength), keepAlive, clientAddress) && keepAlive;
+        }
+
+        // Without a length the end of the body is the end of the connection.
+        keepAlive = keepAlive && framing != BodyFraming::UntilClose;
+
+        ArenaString responseHead{ ArenaAllocator<char>(arena) };
+        responseHead.reserve(2048);
+        responseHead.append("HTTP/1.1 ").append(std::to_string(response.status)).append(" ").append(response.reason)
+            .append("\r\n");
+        for (const auto& header : response.headers) {
+            if (!IsHopByHopHeader(header.name))
+                AppendHeader(responseHead, header.name, header.value);
+        }
+        if (framing == BodyFraming::Chunked)
+            responseHead.append("Transfer-Encoding: chunked\r\n");
+        else if (hasLength)
+            AppendHeader(responseHead, "Content-Length", std::to_string(contentLength));
+        responseHead.append(keepAlive ? "Connection: keep-alive\r\n\r\n" : "Connection: close\r\n\r\n");
+        if (!client.SendAll(std::string_view(responseHead)))
+            return false;
+        if (RelayPassThrough(server, client, std::string_view(buffer).substr(headEnd), framing, contentLength) !=
+            RelayStatus::Complete)
+            return false;
+        if (framing != BodyFraming::UntilClose && ResponseKeepsConnection(response))
+            pool_->Release(std::move(server));
+        return keepAlive;
+    }
+
+    // `acceptEncoding`, when given, replaces the client's Accept-Encoding and
+    // drops its conditional headers, so the container returns a full body in
+    // that encoding.
+    ArenaString BuildContainerHead(const HttpRequest& request, Arena& arena, const std::string& clientAddress,
+        const std::string_view* upgrade, std::string_view acceptEncoding) const
+    {
+        ArenaString head{ ArenaAllocator<char>(arena) };
+        head.reserve(2048);
+        head.append(request.method).append(" ").append(request.target).append(" HTTP/1.1\r\n");
+        for (const auto& header : request.headers) {
+            if (IsHopByHopHeader(header.name) || EqualsIgnoreCase(header.name, "X-Forwarded-For"))
+                continue;
+            if (!acceptEncoding.empty() && (EqualsIgnoreCase(header.name, "Accept-Encoding") ||
+                EqualsIgnoreCase(header.name, "If-None-Match") || EqualsIgnoreCase(header.name, "If-Modified-Since")))
+                continue;
+            AppendHeader(head, header.name, header.value);
+        }
+        if (!acceptEncoding.empty())
+            AppendHeader(head, "Accept-Encoding", acceptEncoding);
+        head.append("X-Forwarded-For: ");
+        if (const std::string_view* forwardedFor = FindHeader(request.headers, "X-Forwarded-For"))
+            head.append(*forwardedFor).append(", ");
+        head.append(clientAddress).append("\r\n");
+        if (!request.body.empty() || request.method == "POST" || request.method == "PUT")
+            AppendHeader(head, "Content-Length", std::to_string(request.body.size()));
+        if (upgrade)
+            head.append("Upgrade: ").append(*upgrade).append("\r\nConnection: Upgrade\r\n\r\n");
+        else
+            head.append(config_.pool.enabled ? "Connection: keep-alive\r\n\r\n" : "Connection: close\r\n\r\n");
+        return head;
+    }
+
+    // Reads a cacheable asset to the end, adds its compressed variants to the
+    // cache and answers the client from the new entry.
+    bool FillCache(Socket& client, Socket& server, const HttpRequest& request, Arena& arena,
+        const HttpResponseHead& response, std::string_view pending, size_t contentLength, bool keepAlive,
+        const std::string& clientAddress)
+    {
+        std::string identity;
+        if (!ReadBody(server, pending, contentLength, identity))
+            return SendSimpleResponse(client, 502, "Bad Gateway", "text/plain", "Open WebUI unavailable\n");
+        if (ResponseKeepsConnection(response))
+            pool_->Release(std::move(server));
+
+        const std::string_view* contentType = FindHeader(response.headers, "Content-Type");
+        std::string brotli = FetchBrotli(request, arena, clientAddress, identity.size());
+        const auto asset = AssetCache::MakeAsset(contentType ? *contentType : "application/octet-stream",
+            std::move(identity), std::move(brotli));
+        assets_->Insert(std::string(request.target), asset);
+        return assets_->Serve(client, request, *asset, keepAlive);
+    }
+
+    // Asks the container for the brotli encoding of an asset. Open WebUI
+    // compresses responses itself when its compression middleware is on;
+    // otherwise (or if it is not smaller) the cache keeps identity and gzip.
+    std::string FetchBrotli(const HttpRequest& request, Arena& arena, const std::string& clientAddress, size_t identitySize) {
+        const ArenaString head = BuildContainerHead(request, arena, clientAddress, nullptr, "br");
+        bool reused = false;
+        Socket server = pool_->Acquire(reused);
+        if (!server.Valid() || !server.SendAll(std::string_view(head)))
+            return {};
+        server.SetReceiveTimeout(kUpstreamTimeoutMs);
+        ArenaString buffer{ ArenaAllocator<char>(arena) };
+        const size_t headEnd = ReadHeaderBlock(server, buffer);
+        HttpResponseHead response(arena);
+        if (headEnd == 0 || !ParseResponseHead(std::string_view(buffer.data(), headEnd - 4), arena, response))
+            return {};
+        const std::string_view* contentEncoding = FindHeader(response.headers, "Content-Encoding");
+        const std::string_view* contentLengthHeader = FindHeader(response.headers, "Content-Length");
+        uint64_t contentLength = 0;
+        if (response.status != 200 || !contentEncoding || !EqualsIgnoreCase(*contentEncoding, "br") ||
+            !contentLengthHeader || !ParseUint(*contentLengthHeader, contentLength) || contentLength >= identitySize)
+            return {};
+        std::string brotli;
+        if (!ReadBody(server, std::string_view(buffer).substr(headEnd), static_cast<size_t>(contentLength), brotli))
+            return {};
+        if (ResponseKeepsConnection(response))
+            pool_->Release(std::move(server));
+        return brotli;
+    }
+
+    // Reads exactly `length` body bytes, starting with those in `pending`.
+    static bool ReadBody(Socket& server, std::string_view pending, size_t length, std::string& body) {
+        body.assign(pending.substr(0, length));
+        size_t received = body.size();
+        body.resize(length);
+        while (received < length) {
+            const int count = server.Recv(&body[received], static_cast<int>((std::min)(length - received, size_t{ 1 } << 20)));
+            if (count <= 0)
+                return false;
+            received += static_cast<size_t>(count);
+        }
+        return true;
+    }
+
+    WebUIConfig config_;
+    sockaddr_in container_{};
+    std::unique_ptr<UpstreamPool> pool_;
+    std::unique_ptr<AssetCache> assets_;
+    TcpServer server_;
+    std::atomic<bool> running_{ false };
+};